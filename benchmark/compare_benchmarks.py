@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+# Compares two result directories written by run_benchmarks.sh and lists the
+# benchmarks which got slower by more than the threshold; exits with 1 if any did.
+#
+#   ../benchmark/compare_benchmarks.py results/v1 results/v2 --threshold 10
+
+import argparse
+import glob
+import os
+import sys
+import xml.etree.ElementTree as ET
+
+
+def load(directory):
+    results = {}
+    for path in glob.glob(os.path.join(directory, '*.xml')):
+        suite = os.path.splitext(os.path.basename(path))[0]
+        for function in ET.parse(path).getroot().iter('TestFunction'):
+            for result in function.iter('BenchmarkResult'):
+                key = '%s::%s(%s)' % (suite, function.get('name'), result.get('tag'))
+                value = float(result.get('value')) / max(int(result.get('iterations')), 1)
+                results[key] = (value, result.get('metric'))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('baseline')
+    parser.add_argument('current')
+    parser.add_argument('--threshold', type=float, default=5, help='percent')
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = 0
+    for key in sorted(set(baseline) & set(current)):
+        before, metric = baseline[key]
+        after = current[key][0]
+        change = (after - before) / before * 100 if before else 0
+        mark = ''
+        if change > args.threshold:
+            mark = '  <-- slower'
+            regressions += 1
+        print('%-70s %12.4g %12.4g %+7.1f%% %s%s' % (key, before, after, change, metric, mark))
+
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET = bench_formatter
+INCLUDEPATH += . ../../include
+
+QT += testlib
+QT -= gui
+CONFIG += console testcase
+
+HEADERS = ../../include/QHexFormatter.h
+
+SOURCES = tst_bench_formatter.cpp       \
+          ../../src/QHexFormatter.cpp
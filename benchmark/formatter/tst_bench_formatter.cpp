@@ -0,0 +1,126 @@
+#include <QtTest>
+#include <QByteArray>
+#include <QString>
+
+#include "QHexFormatter.h"
+
+// Compares QHexFormatter with the per-byte QString::number path that
+// QHexView::paintEvent and the Copy handler used before
+class BenchFormatter: public QObject
+{
+	Q_OBJECT
+	private:
+		QByteArray    m_data;
+
+	private slots:
+		void initTestCase();
+
+		void hexPerByte();
+		void hexScalar();
+		void hexFormatter();
+
+		void asciiPerByte();
+		void asciiScalar();
+		void asciiFormatter();
+
+		void sameOutput();
+};
+
+
+void BenchFormatter::initTestCase()
+{
+	// One full 4K viewport at 64 bytes per line is roughly 150 lines, 10K bytes
+	m_data.resize(64 * 1024);
+	quint32 seed = 1;
+	for(int i = 0; i < m_data.size(); i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		m_data[i] = seed >> 24;
+	}
+}
+
+void BenchFormatter::hexPerByte()
+{
+	QString res;
+	QBENCHMARK
+	{
+		res.clear();
+		for(int i = 0; i < m_data.size(); i++)
+		{
+			res += QString::number((m_data.at(i) & 0xF0) >> 4, 16);
+			res += QString::number((m_data.at(i) & 0xF), 16);
+		}
+	}
+}
+
+void BenchFormatter::hexScalar()
+{
+	QByteArray res(2 * m_data.size(), Qt::Uninitialized);
+	QBENCHMARK
+	{
+		QHexFormatter::toHexScalar(m_data.constData(), m_data.size(), res.data());
+	}
+}
+
+void BenchFormatter::hexFormatter()
+{
+	QByteArray res(2 * m_data.size(), Qt::Uninitialized);
+	QBENCHMARK
+	{
+		QHexFormatter::toHex(m_data.constData(), m_data.size(), res.data());
+	}
+}
+
+void BenchFormatter::asciiPerByte()
+{
+	QString res;
+	QBENCHMARK
+	{
+		res.clear();
+		for(int i = 0; i < m_data.size(); i++)
+		{
+			char ch = m_data[i];
+			if ((ch < 0x20) || (ch > 0x7e))
+				ch = '.';
+			res += QString(ch);
+		}
+	}
+}
+
+void BenchFormatter::asciiScalar()
+{
+	QByteArray res(m_data.size(), Qt::Uninitialized);
+	QBENCHMARK
+	{
+		QHexFormatter::toAsciiScalar(m_data.constData(), m_data.size(), res.data());
+	}
+}
+
+void BenchFormatter::asciiFormatter()
+{
+	QByteArray res(m_data.size(), Qt::Uninitialized);
+	QBENCHMARK
+	{
+		QHexFormatter::toAscii(m_data.constData(), m_data.size(), res.data());
+	}
+}
+
+void BenchFormatter::sameOutput()
+{
+	QByteArray hex(2 * m_data.size(), Qt::Uninitialized);
+	QByteArray hexScalar(2 * m_data.size(), Qt::Uninitialized);
+	QHexFormatter::toHex(m_data.constData(), m_data.size(), hex.data());
+	QHexFormatter::toHexScalar(m_data.constData(), m_data.size(), hexScalar.data());
+	QCOMPARE(hex, hexScalar);
+
+	QByteArray ascii(m_data.size(), Qt::Uninitialized);
+	QByteArray asciiScalar(m_data.size(), Qt::Uninitialized);
+	QHexFormatter::toAscii(m_data.constData(), m_data.size(), ascii.data());
+	QHexFormatter::toAsciiScalar(m_data.constData(), m_data.size(), asciiScalar.data());
+	QCOMPARE(ascii, asciiScalar);
+}
+
+
+QTEST_APPLESS_MAIN(BenchFormatter)
+
+#include "tst_bench_formatter.moc"
@@ -0,0 +1,42 @@
+TEMPLATE = app
+TARGET = bench_paint
+INCLUDEPATH += . ../../include
+
+QT += testlib widgets
+CONFIG += console testcase
+LIBS += -lz
+
+HEADERS = ../../include/QHexView.h        \
+          ../../include/QHexFormatter.h   \
+          ../../include/QHexHighlights.h  \
+          ../../include/QHexJob.h         \
+          ../../include/QHexExport.h      \
+          ../../include/QHexSearch.h      \
+          ../../include/QHexDiff.h        \
+          ../../include/QHexOverview.h    \
+          ../../include/QHexOverviewBar.h \
+          ../../include/QHexSidecar.h     \
+          ../../include/QHexStats.h       \
+          ../../include/QHexTemplate.h    \
+          ../../include/QHexStructure.h   \
+          ../../include/QHexAggregate.h   \
+          ../../include/QHexInspector.h   \
+          ../../include/QHexLayout.h
+
+SOURCES = tst_bench_paint.cpp             \
+          ../../src/QHexView.cpp          \
+          ../../src/QHexFormatter.cpp     \
+          ../../src/QHexHighlights.cpp    \
+          ../../src/QHexJob.cpp           \
+          ../../src/QHexExport.cpp        \
+          ../../src/QHexSearch.cpp        \
+          ../../src/QHexDiff.cpp          \
+          ../../src/QHexOverview.cpp      \
+          ../../src/QHexOverviewBar.cpp   \
+          ../../src/QHexSidecar.cpp       \
+          ../../src/QHexStats.cpp         \
+          ../../src/QHexTemplate.cpp      \
+          ../../src/QHexStructure.cpp     \
+          ../../src/QHexAggregate.cpp     \
+          ../../src/QHexInspector.cpp     \
+          ../../src/QHexLayout.cpp
@@ -0,0 +1,239 @@
+#include <QtTest>
+#include <QApplication>
+#include <QClipboard>
+#include <QScrollBar>
+#include <QByteArray>
+
+#include "QHexView.h"
+
+// Full repaints of QHexView through its viewport, run headless on the
+// offscreen platform unless QT_QPA_PLATFORM says otherwise. Bytes per line
+// follow the viewport width, so the sizes below cover 16 to 128 of them.
+class BenchPaint: public QObject
+{
+	Q_OBJECT
+	private:
+		QByteArray    m_data;
+
+		void prepare(QHexView &view, const QSize &size);
+
+	private slots:
+		void initTestCase();
+
+		void repaint_data();
+		void repaint();
+
+		void repaintSelected_data();
+		void repaintSelected();
+
+		void repaintHighlighted_data();
+		void repaintHighlighted();
+
+		void repaintRecords_data();
+		void repaintRecords();
+
+		void scroll_data();
+		void scroll();
+
+		void copy_data();
+		void copy();
+};
+
+
+void BenchPaint::prepare(QHexView &view, const QSize &size)
+{
+	view.setData(new QHexView::DataStorageArray(m_data));
+	view.resize(size);
+	view.show();
+	QVERIFY(QTest::qWaitForWindowExposed(&view));
+	QCoreApplication::processEvents();
+}
+
+static void addSizes()
+{
+	QTest::addColumn<QSize>("size");
+
+	QTest::newRow("640x480") << QSize(640, 480);
+	QTest::newRow("1280x1024") << QSize(1280, 1024);
+	QTest::newRow("1920x1080") << QSize(1920, 1080);
+	QTest::newRow("3840x2160") << QSize(3840, 2160);
+}
+
+void BenchPaint::initTestCase()
+{
+	m_data.resize(64 * 1024 * 1024);
+	quint32 seed = 1;
+	for(int i = 0; i < m_data.size(); i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		m_data[i] = seed >> 24;
+	}
+}
+
+void BenchPaint::repaint_data()
+{
+	addSizes();
+}
+
+void BenchPaint::repaint()
+{
+	QFETCH(QSize, size);
+
+	QHexView view;
+	prepare(view, size);
+	view.showFromOffset(m_data.size() / 2);
+
+	QBENCHMARK
+	{
+		view.viewport()->repaint();
+	}
+}
+
+void BenchPaint::repaintSelected_data()
+{
+	addSizes();
+}
+
+void BenchPaint::repaintSelected()
+{
+	QFETCH(QSize, size);
+
+	QHexView view;
+	prepare(view, size);
+
+	// A selection starting and ending off screen covers every visible line
+	view.setSelected(1024, m_data.size() - 2048);
+	view.showFromOffset(m_data.size() / 2);
+
+	QBENCHMARK
+	{
+		view.viewport()->repaint();
+	}
+}
+
+void BenchPaint::repaintHighlighted_data()
+{
+	QTest::addColumn<QSize>("size");
+	QTest::addColumn<int>("highlights");
+
+	QTest::newRow("1920x1080, 1K") << QSize(1920, 1080) << 1024;
+	QTest::newRow("1920x1080, 1M") << QSize(1920, 1080) << 1024 * 1024;
+	QTest::newRow("3840x2160, 1M") << QSize(3840, 2160) << 1024 * 1024;
+}
+
+void BenchPaint::repaintHighlighted()
+{
+	QFETCH(QSize, size);
+	QFETCH(int, highlights);
+
+	QHexView view;
+	prepare(view, size);
+
+	// Short ranges spread over the data in two layers, as search matches
+	// under diff differences would be
+	std::size_t step = m_data.size() / highlights;
+	for(int i = 0; i < highlights; i++)
+		view.addHighlight(i * step, 3, i & 1 ? Qt::yellow : Qt::cyan, i & 1);
+	view.setSelected(m_data.size() / 2, 4096);
+	view.showFromOffset(m_data.size() / 2);
+
+	QBENCHMARK
+	{
+		view.viewport()->repaint();
+	}
+}
+
+void BenchPaint::repaintRecords_data()
+{
+	QTest::addColumn<int>("bytesPerLine");
+	QTest::addColumn<int>("groupSize");
+	QTest::addColumn<bool>("littleEndian");
+
+	QTest::newRow("48, bytes") << 48 << 1 << false;
+	QTest::newRow("188, bytes") << 188 << 1 << false;
+	QTest::newRow("188, 4 LE") << 188 << 4 << true;
+	QTest::newRow("188, 8 LE") << 188 << 8 << true;
+}
+
+void BenchPaint::repaintRecords()
+{
+	QFETCH(int, bytesPerLine);
+	QFETCH(int, groupSize);
+	QFETCH(bool, littleEndian);
+
+	// Fixed records wider than the view, scrolled to their middle
+	QHexView view;
+	prepare(view, QSize(1280, 1024));
+	view.setBytesPerLine(bytesPerLine);
+	view.setGrouping(groupSize, littleEndian);
+	view.setBaseOffset(20);
+	view.setSelected(1024, m_data.size() - 2048);
+	view.showFromOffset(m_data.size() / 2);
+	view.horizontalScrollBar()->setValue(view.horizontalScrollBar()->maximum() / 2);
+
+	QBENCHMARK
+	{
+		view.viewport()->repaint();
+	}
+}
+
+void BenchPaint::scroll_data()
+{
+	addSizes();
+}
+
+void BenchPaint::scroll()
+{
+	QFETCH(QSize, size);
+
+	QHexView view;
+	prepare(view, size);
+
+	// One line at a time, the rest of the viewport is moved rather than painted
+	std::size_t line = 0;
+	QBENCHMARK
+	{
+		view.setFirstVisibleLine(++line);
+		view.viewport()->repaint();
+	}
+}
+
+void BenchPaint::copy_data()
+{
+	QTest::addColumn<int>("length");
+
+	QTest::newRow("64K") << 64 * 1024;
+	QTest::newRow("1M") << 1024 * 1024;
+	QTest::newRow("16M") << 16 * 1024 * 1024;
+}
+
+void BenchPaint::copy()
+{
+	QFETCH(int, length);
+
+	QHexView view;
+	prepare(view, QSize(1280, 1024));
+	view.setCopyLimit(length);
+	view.setSelected(0, length);
+
+	QBENCHMARK
+	{
+		QTest::keyClick(&view, Qt::Key_C, Qt::ControlModifier);
+	}
+
+	// Two hex digits and a separator per byte
+	QVERIFY(QApplication::clipboard()->text().size() >= 2 * length);
+}
+
+
+int main(int argc, char *argv[])
+{
+	if(!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+
+	QApplication app(argc, argv);
+	BenchPaint bench;
+	return QTest::qExec(&bench, argc, argv);
+}
+
+#include "tst_bench_paint.moc"
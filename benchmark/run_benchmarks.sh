@@ -0,0 +1,23 @@
+#!/bin/sh
+# Runs the benchmark suites of a build directory and keeps their results as
+# QtTest XML and CSV in an output directory named after the revision, e.g.
+#
+#   ../benchmark/run_benchmarks.sh . results
+#
+# Extra arguments go to every suite (-iterations, -minimumvalue, -tickcounter...).
+
+set -e
+
+BUILD=${1:-.}
+OUT=${2:-results}
+if [ $# -ge 2 ]; then shift 2; else shift $#; fi
+
+REVISION=$(git -C "$(dirname "$0")" describe --always --dirty 2>/dev/null || echo unknown)
+DIR="$OUT/$REVISION"
+mkdir -p "$DIR"
+
+for SUITE in formatter paint storage; do
+	"$BUILD/$SUITE/bench_$SUITE" "$@" -o "$DIR/$SUITE.xml,xml" -o "$DIR/$SUITE.csv,csv" -o -,txt
+done
+
+echo "Results in $DIR"
@@ -0,0 +1,151 @@
+#include <QtTest>
+#include <QByteArray>
+#include <QTemporaryFile>
+
+#include "QHexView.h"
+
+// Sequential and random reads through the storages, in chunks the size of a
+// viewport (4 KB) and of a copy or search chunk (1 MB), over a 256 MB file
+class BenchStorage: public QObject
+{
+	Q_OBJECT
+	private:
+		QTemporaryFile   m_file;
+		QByteArray       m_data;
+
+		QHexView::DataStorage *createStorage(const QString &kind);
+
+	private slots:
+		void initTestCase();
+
+		void sequential_data();
+		void sequential();
+
+		void random_data();
+		void random();
+
+		void view_data();
+		void view();
+};
+
+
+QHexView::DataStorage *BenchStorage::createStorage(const QString &kind)
+{
+	if(kind == "array")
+		return new QHexView::DataStorageArray(m_data);
+	if(kind == "file")
+		return new QHexView::DataStorageFile(m_file.fileName());
+	if(kind == "mapped")
+		return new QHexView::DataStorageMapped(m_file.fileName());
+	if(kind == "cached")
+		return new QHexView::DataStorageCached(new QHexView::DataStorageFile(m_file.fileName()));
+	return new QHexView::DataStorageEditable(new QHexView::DataStorageMapped(m_file.fileName()));
+}
+
+static void addStorages()
+{
+	QTest::addColumn<QString>("kind");
+	QTest::addColumn<int>("chunk");
+
+	const char *kinds[] = {"array", "file", "mapped", "cached", "editable"};
+	for(std::size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+	{
+		QTest::newRow(QByteArray(kinds[i]) + ", 4K") << kinds[i] << 4 * 1024;
+		QTest::newRow(QByteArray(kinds[i]) + ", 1M") << kinds[i] << 1024 * 1024;
+	}
+}
+
+void BenchStorage::initTestCase()
+{
+	m_data.resize(256 * 1024 * 1024);
+	quint32 seed = 1;
+	for(int i = 0; i < m_data.size(); i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		m_data[i] = seed >> 24;
+	}
+
+	QVERIFY(m_file.open());
+	QCOMPARE(m_file.write(m_data), (qint64)m_data.size());
+	QVERIFY(m_file.flush());
+}
+
+void BenchStorage::sequential_data()
+{
+	addStorages();
+}
+
+void BenchStorage::sequential()
+{
+	QFETCH(QString, kind);
+	QFETCH(int, chunk);
+
+	QScopedPointer<QHexView::DataStorage> pstorage(createStorage(kind));
+	QByteArray buffer(chunk, Qt::Uninitialized);
+	std::size_t size = pstorage->size();
+
+	// Every iteration reads the whole data once
+	QBENCHMARK
+	{
+		for(std::size_t position = 0; position < size; position += chunk)
+			pstorage->read(position, chunk, buffer.data());
+	}
+}
+
+void BenchStorage::random_data()
+{
+	addStorages();
+}
+
+void BenchStorage::random()
+{
+	QFETCH(QString, kind);
+	QFETCH(int, chunk);
+
+	QScopedPointer<QHexView::DataStorage> pstorage(createStorage(kind));
+	QByteArray buffer(chunk, Qt::Uninitialized);
+	std::size_t size = pstorage->size();
+
+	// The same offsets every run, 64 MB worth of reads
+	QBENCHMARK
+	{
+		quint32 seed = 7;
+		for(int i = 0; i < 64 * 1024 * 1024 / chunk; i++)
+		{
+			seed = seed * 1664525 + 1013904223;
+			std::size_t position = (quint64)seed * (size - chunk) / 0xFFFFFFFFu;
+			pstorage->read(position, chunk, buffer.data());
+		}
+	}
+}
+
+void BenchStorage::view_data()
+{
+	addStorages();
+}
+
+void BenchStorage::view()
+{
+	QFETCH(QString, kind);
+	QFETCH(int, chunk);
+
+	QScopedPointer<QHexView::DataStorage> pstorage(createStorage(kind));
+	std::size_t size = pstorage->size();
+
+	// Storages which hold the data in memory hand it out without copying
+	quint32 sum = 0;
+	QBENCHMARK
+	{
+		for(std::size_t position = 0; position < size; position += chunk)
+		{
+			QHexView::DataView data = pstorage->view(position, chunk);
+			sum += data.size() ? (uchar)data.data()[0] : 0;
+		}
+	}
+	QVERIFY(sum || !size);
+}
+
+
+QTEST_GUILESS_MAIN(BenchStorage)
+
+#include "tst_bench_storage.moc"
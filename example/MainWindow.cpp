@@ -11,14 +11,34 @@
 #include <QMenu>
 #include <QMenuBar>
 #include <QInputDialog>
+#include <QLineEdit>
+#include <QProgressDialog>
+#include <QStatusBar>
+#include <QSaveFile>
+#include <QApplication>
+#include <QClipboard>
+#include <QJsonDocument>
+#include <QDockWidget>
 
 #include <QDebug>
 
+#include <stdexcept>
+#include <limits>
+
 #include "QHexView.h"
+#include "QHexExport.h"
+#include "QHexSearch.h"
+#include "QHexDiffView.h"
+#include "QHexSidecar.h"
+#include "QHexStructure.h"
+#include "QHexTemplate.h"
+#include "QHexInspector.h"
 
 
 MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags):
-QMainWindow(parent, flags)
+QMainWindow(parent, flags),
+m_pexport(NULL),
+m_pprogress(NULL)
 {
 	QToolBar *ptb = addToolBar("File");
 
@@ -29,12 +49,54 @@ QMainWindow(parent, flags)
 	QMenu *pmenu = menuBar() -> addMenu("&File");
 	pmenu -> addAction(pactOpen);
 	addAction (pactOpen);
+#ifdef Q_OS_LINUX
+	pmenu -> addAction("Open process...", this, SLOT(slotOpenProcess()));
+#endif
+	pmenu -> addAction("Save", this, SLOT(slotSave()), QKeySequence::Save);
+	pmenu -> addAction("Save as...", this, SLOT(slotSaveAs()), QKeySequence::SaveAs);
 	pmenu -> addAction("Go to offset...", this, SLOT(slotToOffset())); 
+	pmenu -> addAction("Export selection...", this, SLOT(slotExport()));
+	pmenu -> addAction("Compare with...", this, SLOT(slotCompare()));
+	pmenu -> addAction("Apply template...", this, SLOT(slotTemplate()));
 	pmenu -> addAction("About...", this, SLOT(slotAbout()));
 	pmenu -> addAction("Exit", this, SLOT(close()));
 
 	QHexView *pwgt = new QHexView;
+
+	pmenu = menuBar() -> addMenu("&Edit");
+	pmenu -> addAction("Undo", pwgt, SLOT(undo()), QKeySequence::Undo);
+	pmenu -> addAction("Redo", pwgt, SLOT(redo()), QKeySequence::Redo);
+
+	pmenu = menuBar() -> addMenu("&Search");
+	pmenu -> addAction("Find...", this, SLOT(slotFind()), QKeySequence::Find);
+	pmenu -> addAction("Find next", this, SLOT(slotFindNext()), QKeySequence::FindNext);
+	pmenu -> addAction("Find previous", this, SLOT(slotFindPrevious()), QKeySequence::FindPrevious);
+
+	pmenu = menuBar() -> addMenu("&View");
+	QAction *pactFollow = pmenu -> addAction("Follow file");
+	pactFollow -> setCheckable(true);
+	connect(pactFollow, SIGNAL(toggled(bool)), SLOT(slotFollow(bool)));
+	QAction *pactOverview = pmenu -> addAction("Overview");
+	pactOverview -> setCheckable(true);
+	connect(pactOverview, SIGNAL(toggled(bool)), SLOT(slotOverview(bool)));
+	QAction *pactStats = pmenu -> addAction("Performance overlay");
+	pactStats -> setCheckable(true);
+	connect(pactStats, SIGNAL(toggled(bool)), SLOT(slotStatsOverlay(bool)));
+	pmenu -> addAction("Copy performance report", this, SLOT(slotCopyStats()));
+	pmenu -> addSeparator();
+	pmenu -> addAction("Bytes per line...", this, SLOT(slotBytesPerLine()));
+	pmenu -> addAction("Group bytes...", this, SLOT(slotGrouping()));
+	pmenu -> addAction("Base offset...", this, SLOT(slotBaseOffset()));
+
+	QDockWidget *pdock = new QDockWidget("Inspector", this);
+	pdock -> setWidget(new QHexInspector(pwgt, pdock));
+	addDockWidget(Qt::RightDockWidgetArea, pdock);
+	pdock -> hide();
+	pmenu -> addAction(pdock -> toggleViewAction());
+
 	setCentralWidget(pwgt);
+	connect(pwgt, SIGNAL(dataEdited()), SLOT(slotDataEdited()));
+	connect(pwgt, SIGNAL(copyLimitExceeded(qulonglong, qulonglong)), SLOT(slotCopyLimitExceeded(qulonglong, qulonglong)));
 
 	readCustomData();
 }
@@ -42,22 +104,24 @@ QMainWindow(parent, flags)
 
 void MainWindow::process(const QString &fileName)
 {
-	QFile file(fileName);
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
 
+	pcntwgt -> clear();
 
-	if(!file.open(QIODevice::ReadOnly))
+	try
+	{
+		// Compressed files are shown decompressed and read-only
+		if(fileName.endsWith(".gz", Qt::CaseInsensitive))
+			pcntwgt -> setData(new QHexView::DataStorageGzip(fileName));
+		else
+			pcntwgt -> setData(new QHexView::DataStorageEditable(new QHexView::DataStorageMapped(fileName)));
+		pcntwgt -> loadIndex(QHexSidecar::defaultPath(fileName));
+		m_fileName = fileName;
+	}
+	catch(const std::runtime_error &)
 	{
 		QMessageBox::critical(this, "File opening problem", "Problem with open file `" + fileName + "`for reading");
-		return;
 	}
-
-	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
-
-	pcntwgt -> clear();
-
-	QByteArray arr = file.readAll();
-	pcntwgt -> setData(new QHexView::DataStorageArray(arr));
-
 }
 
 
@@ -72,12 +136,155 @@ void MainWindow::slotOpen()
 	QString fileName = QFileDialog::getOpenFileName(this, "Select file", dir);
 	if(!fileName.isEmpty())
 	{
+		saveIndex();
 		process(fileName);
 		QFileInfo info(fileName);
 		settings.setValue("QHexView/PrevDir", info.absoluteDir().absolutePath());
 
-		setWindowTitle(info.fileName());
+		updateTitle();
+	}
+}
+
+
+void MainWindow::slotSave()
+{
+	if(m_fileName.isEmpty())
+		return;
+
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	if(!pcntwgt -> canSaveInPlace())
+	{
+		// Inserted or removed bytes move the rest of the file, it is rewritten
+		QSaveFile file(m_fileName);
+		if(!file.open(QIODevice::WriteOnly) || !pcntwgt -> saveTo(&file) || !file.commit())
+		{
+			QMessageBox::critical(this, "Save", "Problem with writing file `" + m_fileName + "`");
+			return;
+		}
+		process(m_fileName);
+		updateTitle();
+		return;
+	}
+
+	// Only overwritten bytes are written back
+	QFile file(m_fileName);
+	if(!file.open(QIODevice::ReadWrite) || !pcntwgt -> saveInPlace(&file))
+		QMessageBox::critical(this, "Save", "Problem with writing file `" + m_fileName + "`");
+	updateTitle();
+}
+
+
+void MainWindow::slotSaveAs()
+{
+	QString fileName = QFileDialog::getSaveFileName(this, "Save as");
+	if(fileName.isEmpty())
+		return;
+
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	QSaveFile file(fileName);
+	if(!file.open(QIODevice::WriteOnly) || !pcntwgt -> saveTo(&file) || !file.commit())
+	{
+		QMessageBox::critical(this, "Save", "Problem with writing file `" + fileName + "`");
+		return;
 	}
+
+	process(fileName);
+	updateTitle();
+}
+
+
+void MainWindow::slotDataEdited()
+{
+	updateTitle();
+}
+
+
+void MainWindow::slotFollow(bool follow)
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	pcntwgt -> setFollow(follow);
+}
+
+
+void MainWindow::slotOverview(bool show)
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	pcntwgt -> setOverviewVisible(show);
+}
+
+
+void MainWindow::slotBytesPerLine()
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+
+	bool ok;
+	int bytes = QInputDialog::getInt(this, "Bytes per line", "Bytes per line (0 fits the window):", 0, 0, 65536, 1, &ok);
+	if(ok)
+		pcntwgt -> setBytesPerLine(bytes);
+}
+
+
+void MainWindow::slotGrouping()
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+
+	QStringList items;
+	items << "1" << "2" << "4" << "8" << "2, little endian" << "4, little endian" << "8, little endian";
+
+	bool ok;
+	QString item = QInputDialog::getItem(this, "Group bytes", "Bytes per word:", items, 0, false, &ok);
+	if(ok)
+		pcntwgt -> setGrouping(item.section(',', 0, 0).toInt(), item.contains("little"));
+}
+
+
+void MainWindow::slotBaseOffset()
+{
+	bool ok;
+	QString text = QInputDialog::getText(0, "Base offset", "Lines start at (decimal or 0x hex):", QLineEdit::Normal, "0", &ok);
+
+	quint64 offset = 0;
+	if(ok)
+		offset = text.trimmed().toULongLong(&ok, 0);
+
+	if(ok)
+	{
+		QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+		pcntwgt -> setBaseOffset(offset);
+	}
+}
+
+
+void MainWindow::slotStatsOverlay(bool show)
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	pcntwgt -> setStatsOverlayVisible(show);
+}
+
+
+void MainWindow::slotCopyStats()
+{
+	// The numbers as JSON, to be pasted into a bug report
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	if(!pcntwgt -> statsEnabled())
+	{
+		pcntwgt -> setStatsEnabled(true);
+		statusBar() -> showMessage("Performance statistics are collected from now on, copy the report again later", 5000);
+		return;
+	}
+
+	QApplication::clipboard() -> setText(QJsonDocument(pcntwgt -> stats() -> toJson()).toJson());
+	statusBar() -> showMessage("Performance report copied to the clipboard", 3000);
+}
+
+
+void MainWindow::updateTitle()
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	QString title = QFileInfo(m_fileName).fileName();
+	if(pcntwgt -> isModified())
+		title += " *";
+	setWindowTitle(title);
 }
 
 
@@ -90,10 +297,41 @@ void MainWindow::slotAbout()
 }
 
 
+void MainWindow::slotOpenProcess()
+{
+#ifdef Q_OS_LINUX
+	bool ok;
+	int pid = QInputDialog::getInt(this, "Open process", "Process ID:", 1, 1, std::numeric_limits<int>::max(), 1, &ok);
+	if(!ok)
+		return;
+
+	saveIndex();
+
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	pcntwgt -> clear();
+	m_fileName.clear();
+
+	try
+	{
+		pcntwgt -> setData(new QHexView::DataStorageProcess(pid));
+		setWindowTitle(QString("Process %1").arg(pid));
+	}
+	catch(const std::runtime_error &)
+	{
+		QMessageBox::critical(this, "Process opening problem", QString("Cannot read memory of process %1").arg(pid));
+	}
+#endif
+}
+
+
 void MainWindow::slotToOffset()
 {
 	bool ok;
-	int offset = QInputDialog::getInt(0, "Offset", "Offset:", 0, 0, 2147483647, 1, &ok);
+	QString text = QInputDialog::getText(0, "Offset", "Offset (decimal or 0x hex):", QLineEdit::Normal, "0", &ok);
+
+	quint64 offset = 0;
+	if(ok)
+		offset = text.trimmed().toULongLong(&ok, 0);
 
 	if(ok)
 	{
@@ -103,13 +341,253 @@ void MainWindow::slotToOffset()
 }
 
 
+void MainWindow::slotExport()
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+
+	if(!pcntwgt -> selectionLength())
+	{
+		QMessageBox::information(this, "Export", "Nothing is selected");
+		return;
+	}
+
+	exportRange(pcntwgt -> selectionOffset(), pcntwgt -> selectionLength());
+}
+
+
+void MainWindow::slotCopyLimitExceeded(qulonglong offset, qulonglong length)
+{
+	QString message = QString("The selection (%1 bytes) is too large for the clipboard. Export it to a file?").arg(length);
+	if(QMessageBox::question(this, "Copy", message, QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
+		exportRange(offset, length);
+}
+
+
+void MainWindow::exportRange(quint64 offset, quint64 length)
+{
+	if(m_pexport)
+	{
+		QMessageBox::information(this, "Export", "Another export is in progress");
+		return;
+	}
+
+	QStringList formats;
+	formats << "Hex" << "Hex dump" << "Raw binary" << "C array" << "Base64";
+	QHexExport::Format values[] = {QHexExport::Hex, QHexExport::HexDump, QHexExport::Raw, QHexExport::CArray, QHexExport::Base64};
+
+	bool ok;
+	QString format = QInputDialog::getItem(this, "Export", "Format:", formats, 0, false, &ok);
+	if(!ok)
+		return;
+
+	QString fileName = QFileDialog::getSaveFileName(this, "Export to");
+	if(fileName.isEmpty())
+		return;
+
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	m_pexport = pcntwgt -> createExport();
+
+	QFile *pfile = new QFile(fileName, m_pexport);
+	if(!pfile -> open(QIODevice::WriteOnly))
+	{
+		QMessageBox::critical(this, "Export", "Problem with open file `" + fileName + "`for writing");
+		delete m_pexport;
+		m_pexport = NULL;
+		return;
+	}
+
+	m_pprogress = new QProgressDialog("Exporting...", "Cancel", 0, 1000, this);
+	m_pprogress -> setWindowModality(Qt::WindowModal);
+	m_pprogress -> setMinimumDuration(500);
+
+	connect(m_pprogress, SIGNAL(canceled()), m_pexport, SLOT(cancel()));
+	connect(m_pexport, SIGNAL(progress(qulonglong, qulonglong)), SLOT(slotExportProgress(qulonglong, qulonglong)));
+	connect(m_pexport, SIGNAL(finished(bool)), SLOT(slotExportFinished(bool)));
+
+	m_pexport -> start(pfile, offset, length, values[formats.indexOf(format)]);
+}
+
+
+void MainWindow::slotExportProgress(qulonglong done, qulonglong total)
+{
+	if(m_pprogress && total)
+		m_pprogress -> setValue(done * 1000 / total);
+}
+
+
+void MainWindow::slotExportFinished(bool ok)
+{
+	if(!ok && m_pprogress && !m_pprogress -> wasCanceled())
+		QMessageBox::critical(this, "Export", m_pexport -> errorString());
+
+	if(m_pprogress)
+		m_pprogress -> deleteLater();
+	m_pprogress = NULL;
+
+	// Deleting the job closes the output file, which is its child
+	if(m_pexport)
+		m_pexport -> deleteLater();
+	m_pexport = NULL;
+}
+
+
+void MainWindow::slotFind()
+{
+	QStringList modes;
+	modes << "Hex (?? for any byte)" << "ASCII" << "ASCII, ignore case" << "UTF-16" << "UTF-16, ignore case" << "Regular expression";
+	QHexSearch::Mode values[] = {QHexSearch::HexPattern, QHexSearch::Ascii, QHexSearch::Ascii, QHexSearch::Utf16, QHexSearch::Utf16, QHexSearch::RegularExpression};
+	Qt::CaseSensitivity cases[] = {Qt::CaseSensitive, Qt::CaseSensitive, Qt::CaseInsensitive, Qt::CaseSensitive, Qt::CaseInsensitive, Qt::CaseSensitive};
+
+	bool ok;
+	QString mode = QInputDialog::getItem(this, "Find", "Search for:", modes, 0, false, &ok);
+	if(!ok)
+		return;
+
+	QString pattern = QInputDialog::getText(this, "Find", mode + ":", QLineEdit::Normal, QString(), &ok);
+	if(!ok || pattern.isEmpty())
+		return;
+
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	if(m_psearch)
+		delete m_psearch;
+	m_psearch = pcntwgt -> createSearch();
+	connect(m_psearch, SIGNAL(finished(bool)), SLOT(slotSearchFinished(bool)));
+
+	int index = modes.indexOf(mode);
+	if(!m_psearch -> start(pattern, values[index], cases[index]))
+	{
+		QMessageBox::critical(this, "Find", m_psearch -> errorString());
+		return;
+	}
+
+	pcntwgt -> setSearch(m_psearch);
+	statusBar() -> showMessage("Searching...");
+}
+
+
+void MainWindow::slotFindNext()
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	if(!pcntwgt -> findNext())
+		statusBar() -> showMessage("No matches", 2000);
+}
+
+
+void MainWindow::slotFindPrevious()
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	if(!pcntwgt -> findPrevious())
+		statusBar() -> showMessage("No matches", 2000);
+}
+
+
+void MainWindow::slotSearchFinished(bool ok)
+{
+	if(!m_psearch)
+		return;
+
+	if(ok)
+		statusBar() -> showMessage(QString("%1 matches").arg(m_psearch -> count()));
+	else
+		statusBar() -> clearMessage();
+	slotFindNext();
+}
+
+
+void MainWindow::slotTemplate()
+{
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	QString fileName = QFileDialog::getOpenFileName(this, "Apply template", QString(), "Templates (*.json);;All files (*)");
+	if(fileName.isEmpty())
+		return;
+
+	QFile file(fileName);
+	QHexTemplate tmpl;
+	if(!file.open(QIODevice::ReadOnly) || !tmpl.load(file.readAll()))
+	{
+		QMessageBox::critical(this, "Template problem", "Problem with template `" + fileName + "`: " + tmpl.errorString());
+		return;
+	}
+
+	// Fields are decoded as they are scrolled to, hovering one shows its value
+	pcntwgt -> setStructure(pcntwgt -> createStructure(tmpl));
+	statusBar() -> showMessage("Template " + QFileInfo(fileName).fileName() + " applied", 3000);
+}
+
+void MainWindow::slotCompare()
+{
+	if(m_fileName.isEmpty())
+	{
+		QMessageBox::information(this, "Compare", "Open a file first");
+		return;
+	}
+
+	QString fileName = QFileDialog::getOpenFileName(this, "Compare with", QFileInfo(m_fileName).absolutePath());
+	if(fileName.isEmpty())
+		return;
+
+	QHexDiffView *pdiffView = new QHexDiffView(this);
+	pdiffView -> setWindowFlags(Qt::Window);
+	pdiffView -> setAttribute(Qt::WA_DeleteOnClose);
+	pdiffView -> setWindowTitle(QFileInfo(m_fileName).fileName() + " / " + QFileInfo(fileName).fileName());
+	pdiffView -> resize(1200, 600);
+
+	QAction *pactNext = new QAction("Next difference", pdiffView);
+	pactNext -> setShortcut(QKeySequence("F7"));
+	connect(pactNext, SIGNAL(triggered()), pdiffView, SLOT(nextDifference()));
+	pdiffView -> addAction(pactNext);
+
+	QAction *pactPrevious = new QAction("Previous difference", pdiffView);
+	pactPrevious -> setShortcut(QKeySequence("Shift+F7"));
+	connect(pactPrevious, SIGNAL(triggered()), pdiffView, SLOT(previousDifference()));
+	pdiffView -> addAction(pactPrevious);
+
+	try
+	{
+		pdiffView -> setData(new QHexView::DataStorageMapped(m_fileName), new QHexView::DataStorageMapped(fileName));
+	}
+	catch(const std::runtime_error &)
+	{
+		QMessageBox::critical(this, "File opening problem", "Problem with open file `" + fileName + "`for reading");
+		delete pdiffView;
+		return;
+	}
+
+	connect(pdiffView -> diff(), SIGNAL(finished(bool)), SLOT(slotCompareFinished(bool)));
+	pdiffView -> show();
+}
+
+
+void MainWindow::slotCompareFinished(bool ok)
+{
+	QHexDiff *pdiff = qobject_cast<QHexDiff *>(sender());
+	if(!ok || !pdiff)
+		return;
+
+	// The diff belongs to the first view of the diff window
+	QWidget *pwindow = qobject_cast<QWidget *>(pdiff -> parent()) -> window();
+	QHexDiff::Stats stats = pdiff -> stats();
+	pwindow -> setWindowTitle(pwindow -> windowTitle() + QString(" - %1 bytes differ in %2 regions (F7: next)").arg(stats.different).arg(stats.regions));
+}
+
+
 void MainWindow::closeEvent(QCloseEvent *pevent)
 {
+	saveIndex();
 	saveCustomData();
 	QWidget::closeEvent(pevent);
 }
 
 
+void MainWindow::saveIndex()
+{
+	// The overview and highlights of the file shown are there at once when it is opened again
+	QHexView *pcntwgt = dynamic_cast<QHexView *>(centralWidget());
+	if(!m_fileName.isEmpty())
+		pcntwgt -> saveIndex(QHexSidecar::defaultPath(m_fileName));
+}
+
+
 void MainWindow::saveCustomData()
 {
 	QSettings settings("QHexView", "QHexView");
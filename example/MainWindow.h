@@ -2,6 +2,11 @@
 #define MAIN_WINDOW_H_
 
 #include <QMainWindow>
+#include <QPointer>
+
+class QHexExport;
+class QHexSearch;
+class QProgressDialog;
 
 
 class MainWindow: public QMainWindow
@@ -15,13 +20,43 @@ class MainWindow: public QMainWindow
 
 	private:
 		void process(const QString &fileName);
+		void saveIndex();
 		void saveCustomData();
 		void readCustomData();
+		void exportRange(quint64 offset, quint64 length);
+		void updateTitle();
+
+		QHexExport        *m_pexport;
+		QProgressDialog   *m_pprogress;
+		QPointer<QHexSearch>   m_psearch;
+		QString           m_fileName;
 
 	private slots:
 		void slotOpen();
+		void slotOpenProcess();
+		void slotSave();
+		void slotSaveAs();
+		void slotDataEdited();
+		void slotFollow(bool follow);
+		void slotOverview(bool show);
+		void slotStatsOverlay(bool show);
+		void slotBytesPerLine();
+		void slotGrouping();
+		void slotBaseOffset();
+		void slotCopyStats();
 		void slotAbout();
 		void slotToOffset();
+		void slotExport();
+		void slotCopyLimitExceeded(qulonglong offset, qulonglong length);
+		void slotExportProgress(qulonglong done, qulonglong total);
+		void slotExportFinished(bool ok);
+		void slotFind();
+		void slotFindNext();
+		void slotFindPrevious();
+		void slotSearchFinished(bool ok);
+		void slotTemplate();
+		void slotCompare();
+		void slotCompareFinished(bool ok);
 };
 
 
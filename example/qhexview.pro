@@ -3,11 +3,44 @@ TARGET = qhexview
 INCLUDEPATH += . ../include
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+LIBS += -lz
 
 # Input
-HEADERS = MainWindow.h              \
-          ../include/QHexView.h
+HEADERS = MainWindow.h                 \
+          ../include/QHexView.h        \
+          ../include/QHexFormatter.h   \
+          ../include/QHexHighlights.h  \
+          ../include/QHexJob.h         \
+          ../include/QHexExport.h      \
+          ../include/QHexSearch.h      \
+          ../include/QHexDiff.h        \
+          ../include/QHexDiffView.h    \
+          ../include/QHexOverview.h    \
+          ../include/QHexOverviewBar.h \
+          ../include/QHexSidecar.h     \
+          ../include/QHexStats.h       \
+          ../include/QHexTemplate.h    \
+          ../include/QHexStructure.h   \
+          ../include/QHexAggregate.h   \
+          ../include/QHexInspector.h   \
+          ../include/QHexLayout.h
 
 SOURCES = MainWindow.cpp            \
           main.cpp                  \
-          ../src/QHexView.cpp 
+          ../src/QHexView.cpp       \
+          ../src/QHexFormatter.cpp  \
+          ../src/QHexHighlights.cpp \
+          ../src/QHexJob.cpp        \
+          ../src/QHexExport.cpp     \
+          ../src/QHexSearch.cpp     \
+          ../src/QHexDiff.cpp       \
+          ../src/QHexDiffView.cpp   \
+          ../src/QHexOverview.cpp   \
+          ../src/QHexOverviewBar.cpp \
+          ../src/QHexSidecar.cpp    \
+          ../src/QHexStats.cpp      \
+          ../src/QHexTemplate.cpp   \
+          ../src/QHexStructure.cpp  \
+          ../src/QHexAggregate.cpp  \
+          ../src/QHexInspector.cpp  \
+          ../src/QHexLayout.cpp
@@ -0,0 +1,67 @@
+#ifndef Q_HEX_AGGREGATE_H_
+#define Q_HEX_AGGREGATE_H_
+
+#include <QByteArray>
+#include <QVariant>
+
+#include "QHexJob.h"
+
+// Aggregates of a range of a DataStorage: min, max and sum of its bytes taken
+// as a typed array, CRC32, xxHash64, SHA-256 and a byte histogram. The range is
+// read once, chunk by chunk, on QThreadPool::globalInstance(); every chunk goes
+// through all of them while it is in cache. The typed values are converted in
+// blocks so that the loops over them vectorize.
+class QHexAggregate: public QHexJob
+{
+	Q_OBJECT
+	public:
+		enum ElementType
+		{
+			Int8, UInt8, Int16, UInt16, Int32, UInt32, Int64, UInt64, Float, Double
+		};
+
+		struct Result
+		{
+			quint64      length;            // bytes aggregated
+			quint64      elements;          // whole elements in them, a trailing part is left out
+			QVariant     min;               // qlonglong, qulonglong or double; invalid without elements
+			QVariant     max;
+			double       sum;
+			quint32      crc32;
+			quint64      xxh64;
+			QByteArray   sha256;
+			quint64      histogram[256];
+		};
+
+		QHexAggregate(const QHexView::DataStoragePtr &pData, QObject *parent = 0);
+		~QHexAggregate();
+
+		void setChunkSize(std::size_t size);
+		void setElementType(ElementType type, bool bigEndian = false);
+
+		// Cancels the range in progress, which still reports finished(false)
+		void start(std::size_t offset, std::size_t length);
+		// Complete once finished(true) was emitted
+		Result result() const;
+
+		static int elementSize(ElementType type);
+
+	signals:
+		void progress(qulonglong done, qulonglong total);
+		void finished(bool ok);
+
+	private:
+		class Task;
+
+		void run();
+
+		std::size_t    m_chunkSize;
+		ElementType    m_type;
+		bool           m_bigEndian;
+		std::size_t    m_offset;
+		std::size_t    m_length;
+		mutable QMutex m_resultMtx;
+		Result         m_result;
+};
+
+#endif
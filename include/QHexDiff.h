@@ -0,0 +1,79 @@
+#ifndef Q_HEX_DIFF_H_
+#define Q_HEX_DIFF_H_
+
+#include <QMap>
+#include <QVector>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+#include "QHexJob.h"
+
+// Compares two storages byte by byte at equal offsets, in parallel chunks on its
+// own thread pool. Chunks are compared in blocks with memcmp, only differing
+// blocks are scanned for the exact runs of differing bytes. Neither storage is
+// loaded as a whole. Bytes past the end of the shorter storage form one region.
+class QHexDiff: public QHexJob
+{
+	Q_OBJECT
+	public:
+		struct Region
+		{
+			quint64   offset;
+			quint64   length;
+		};
+
+		struct Stats
+		{
+			quint64   compared;      // bytes compared so far
+			quint64   different;     // differing bytes, including the size difference
+			quint64   regions;
+		};
+
+		QHexDiff(const QHexView::DataStoragePtr &pFirst, const QHexView::DataStoragePtr &pSecond, QObject *parent = 0);
+		~QHexDiff();
+
+		virtual void releaseData();
+
+		void setChunkSize(std::size_t size);
+		void setThreadCount(int threads);
+
+		void start();
+
+		Stats stats();
+		// First difference starting at or after offset / last one starting before it.
+		// Regions split by chunk boundaries are returned joined.
+		bool next(std::size_t offset, Region &region);
+		bool previous(std::size_t offset, Region &region);
+		// Regions overlapping [begin, end), in offset order
+		QVector<Region> regions(std::size_t begin, std::size_t end);
+
+	signals:
+		void regionsFound(qulonglong count);
+		void progress(qulonglong done, qulonglong total);
+		void finished(bool ok);
+
+	private:
+		class Task;
+
+		void run();
+		void compare(const char *pfirst, const char *psecond, std::size_t length, std::size_t offset, QVector<Region> &res);
+		Region join(QMap<std::size_t, QVector<Region> >::const_iterator it, int idx);
+
+		QHexView::DataStoragePtr             m_psecond;
+
+		std::size_t                          m_chunkSize;
+		int                                  m_threads;
+		QThreadPool                          m_pool;
+
+		std::size_t                          m_common;
+		std::size_t                          m_size;
+		std::size_t                          m_chunks;
+		QAtomicInt                           m_nextChunk;
+		QAtomicInt                           m_workers;
+
+		QMutex                               m_resultsMtx;
+		QMap<std::size_t, QVector<Region> >  m_results;
+		Stats                                m_stats;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef Q_HEX_DIFF_VIEW_H_
+#define Q_HEX_DIFF_VIEW_H_
+
+#include <QWidget>
+#include <QPointer>
+
+#include "QHexView.h"
+#include "QHexDiff.h"
+
+// Two QHexViews side by side with locked scrolling; bytes which differ between
+// them are highlighted in both
+class QHexDiffView: public QWidget
+{
+	Q_OBJECT
+	public:
+		QHexDiffView(QWidget *parent = 0);
+
+		QHexView *first();
+		QHexView *second();
+		QHexDiff *diff();
+
+		// Takes ownership of both storages and starts comparing them
+		void setData(QHexView::DataStorage *pFirst, QHexView::DataStorage *pSecond);
+
+	public slots:
+		bool nextDifference();
+		bool previousDifference();
+
+	private:
+		void showRegion(const QHexDiff::Region &region);
+
+		QHexView             *m_pfirst;
+		QHexView             *m_psecond;
+		QPointer<QHexDiff>    m_pdiff;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef Q_HEX_EXPORT_H_
+#define Q_HEX_EXPORT_H_
+
+#include <QIODevice>
+
+#include "QHexJob.h"
+
+// Streams a range of a DataStorage into a QIODevice in fixed-size chunks
+class QHexExport: public QHexJob
+{
+	Q_OBJECT
+	public:
+		enum Format
+		{
+			Hex,        // "xx xx xx" lines, as copied to the clipboard
+			HexDump,    // address, hex and ASCII columns
+			Raw,        // the bytes themselves
+			CArray,     // C source with an unsigned char array
+			Base64      // base64, 76 characters per line
+		};
+
+		QHexExport(const QHexView::DataStoragePtr &pData, QObject *parent = 0);
+		~QHexExport();
+
+		void setChunkSize(std::size_t size);
+		void setBytesPerLine(std::size_t bytesPerLine);
+
+		// Runs the export on QThreadPool::globalInstance()
+		void start(QIODevice *pdevice, std::size_t offset, std::size_t length, Format format);
+		// Runs the export in the calling thread
+		bool exportTo(QIODevice *pdevice, std::size_t offset, std::size_t length, Format format);
+
+		QString errorString() const;
+
+	signals:
+		void progress(qulonglong done, qulonglong total);
+		void finished(bool ok);
+
+	private:
+		class Task;
+
+		void run();
+		bool exportRange(QIODevice *pdevice, std::size_t offset, std::size_t length, Format format);
+		std::size_t unitSize(Format format) const;
+		void formatChunk(const char *pdata, std::size_t length, std::size_t done, std::size_t total, std::size_t address, Format format, QByteArray &out);
+
+		std::size_t                m_chunkSize;
+		std::size_t                m_bytesPerLine;
+		QString                    m_error;
+
+		QIODevice                 *m_pdevice;
+		std::size_t                m_offset;
+		std::size_t                m_length;
+		Format                     m_format;
+};
+
+#endif
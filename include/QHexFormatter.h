@@ -0,0 +1,26 @@
+#ifndef Q_HEX_FORMATTER_H_
+#define Q_HEX_FORMATTER_H_
+
+#include <cstddef>
+
+// Converts byte spans into hex and ASCII text. The widest available
+// implementation (AVX2, SSE2 or scalar) is chosen once at runtime.
+class QHexFormatter
+{
+	public:
+		// Writes 2 * length lowercase hex digits into dst
+		static void toHex(const char *src, std::size_t length, char *dst);
+		// Writes "xx " for each byte into dst, 3 * length chars
+		static void toHexSpaced(const char *src, std::size_t length, char *dst);
+		// Writes printable ASCII characters as is and '.' for the rest, length chars
+		static void toAscii(const char *src, std::size_t length, char *dst);
+
+		// Plain per-byte implementations, used as fallback and as reference
+		static void toHexScalar(const char *src, std::size_t length, char *dst);
+		static void toAsciiScalar(const char *src, std::size_t length, char *dst);
+
+		// Name of the implementation selected for this CPU
+		static const char *implementation();
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef Q_HEX_HIGHLIGHTS_H_
+#define Q_HEX_HIGHLIGHTS_H_
+
+#include <QByteArray>
+#include <QColor>
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+// Colored byte ranges grouped in layers. Each layer keeps its ranges sorted by
+// start in an implicit interval tree (a binary tree laid over the sorted array,
+// every node holding the largest end of its subtree), so a query costs
+// O(log n + k) for k ranges overlapping the queried window. Ranges are appended
+// in O(1), the tree is rebuilt on the first query after a change.
+class QHexHighlights
+{
+	public:
+		struct Range
+		{
+			quint64   begin;
+			quint64   end;      // exclusive
+			QRgb      color;
+		};
+
+		QHexHighlights();
+
+		void add(std::size_t begin, std::size_t end, const QColor &color, int layer);
+		// Removes the ranges of the layer which overlap [begin, end)
+		void remove(std::size_t begin, std::size_t end, int layer);
+		void clear(int layer);
+		void clear();
+
+		bool isEmpty() const;
+		std::size_t count() const;
+		QList<int> layers() const;
+
+		// Appends the ranges of the layer which overlap [begin, end) to res, ordered by start
+		void overlapping(int layer, std::size_t begin, std::size_t end, QVector<Range> &res);
+
+		// All ranges as flat records, for storing them in an index
+		QByteArray saveState() const;
+		// Replaces the layers of a saved state with its ranges, false if it is damaged
+		bool restoreState(const QByteArray &state);
+
+	private:
+		struct Layer
+		{
+			Layer(): depth(-1), sorted(true) {}
+
+			QVector<Range>     ranges;
+			QVector<quint64>   maxEnd;
+			int                depth;
+			bool               sorted;
+		};
+
+		static void build(Layer &layer);
+
+		QMap<int, Layer>   m_layers;
+		std::size_t        m_count;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef Q_HEX_INSPECTOR_H_
+#define Q_HEX_INSPECTOR_H_
+
+#include <QWidget>
+#include <QPointer>
+
+#include "QHexView.h"
+#include "QHexAggregate.h"
+
+class QTreeWidget;
+class QTreeWidgetItem;
+class QComboBox;
+class QCheckBox;
+class QTimer;
+
+// Panel following a QHexView: the bytes at the cursor decoded as integers,
+// floats, text, timestamps and a GUID in both byte orders, and aggregates of
+// the selection (see QHexAggregate). The cursor values take a few bytes and
+// are decoded right away; the aggregates are computed in the background once
+// the selection has stayed put for a moment, a new selection cancels them.
+// Nothing is decoded while the panel is hidden.
+class QHexInspector: public QWidget
+{
+	Q_OBJECT
+	public:
+		QHexInspector(QHexView *pview, QWidget *parent = 0);
+		~QHexInspector();
+
+	protected:
+		void showEvent(QShowEvent *event);
+
+	private slots:
+		void slotCursorMoved();
+		void slotSelectionChanged();
+		void slotAggregate();
+		void slotAggregateProgress(qulonglong done, qulonglong total);
+		void slotAggregateFinished(bool ok);
+
+	private:
+		void updateCursor();
+		void showAggregate(const QHexAggregate::Result &res);
+		void cancelAggregate();
+		void setRow(QTreeWidgetItem *pparent, int row, const QString &little, const QString &big = QString());
+
+		QPointer<QHexView>        m_pview;
+		QPointer<QHexAggregate>   m_paggregate;
+		QTreeWidget              *m_ptree;
+		QTreeWidgetItem          *m_pcursorItem;
+		QTreeWidgetItem          *m_pselectionItem;
+		QTreeWidgetItem          *m_phistogramItem;
+		QComboBox                *m_ptypeBox;
+		QCheckBox                *m_pbigEndianBox;
+		QTimer                   *m_pselectionTimer;
+};
+
+#endif
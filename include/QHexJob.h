@@ -0,0 +1,51 @@
+#ifndef Q_HEX_JOB_H_
+#define Q_HEX_JOB_H_
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+#include "QHexView.h"
+
+// Base of background jobs reading a DataStorage: tracks running tasks and
+// cancellation. The job shares the storage with the view and reads it
+// concurrently with painting, storages being safe for concurrent reads.
+class QHexJob: public QObject
+{
+	Q_OBJECT
+	public:
+		QHexJob(const QHexView::DataStoragePtr &pData, QObject *parent = 0);
+
+		bool isRunning();
+		bool isCanceled() const;
+		void wait();
+		// Lets go of the storage once no task runs; the job reads nothing afterwards
+		virtual void releaseData();
+
+	public slots:
+		void cancel();
+
+	protected:
+		std::size_t readData(std::size_t position, std::size_t length, char *dst);
+		std::size_t dataSize();
+		// The same for storages other than the job's own
+		static std::size_t readData(const QHexView::DataStoragePtr &pData, std::size_t position, std::size_t length, char *dst);
+		static std::size_t dataSize(const QHexView::DataStoragePtr &pData);
+
+		// Every task is announced before it is queued and reports its end;
+		// wait() returns once no task is left
+		void taskStarted();
+		void taskFinished();
+		void resetCanceled();
+
+	private:
+		QHexView::DataStoragePtr   m_pdata;
+		QAtomicInt                 m_canceled;
+
+		QMutex                     m_stateMtx;
+		QWaitCondition             m_stateCond;
+		int                        m_tasks;
+};
+
+#endif
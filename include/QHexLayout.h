@@ -0,0 +1,67 @@
+#ifndef Q_HEX_LAYOUT_H_
+#define Q_HEX_LAYOUT_H_
+
+#include <QtGlobal>
+
+#include <cstddef>
+
+// Where the bytes go on screen: how many make a line, how they are grouped into
+// words and from which offset lines are counted. Lines start at
+// baseOffset + k * bytesPerLine, so fixed-size records stay aligned however the
+// view is resized; the bytes before the first such line start fill the end of
+// line 0. Cursor positions are nibbles, 2 * offset plus 1 for the low nibble.
+// X coordinates are in pixels of the unscrolled content.
+class QHexLayout
+{
+	public:
+		QHexLayout();
+
+		void setBytesPerLine(std::size_t bytes);
+		std::size_t bytesPerLine() const;
+		// Words of groupSize bytes (1, 2, 4 or 8) separated by a space. littleEndian
+		// shows the bytes of every word in reverse, so that it reads as its value.
+		void setGrouping(int groupSize, bool littleEndian);
+		int groupSize() const;
+		bool littleEndian() const;
+		void setBaseOffset(std::size_t offset);
+		std::size_t baseOffset() const;
+		// Width of a character, where the hex column starts and the gap after it
+		void setGeometry(int charWidth, int hexLeft, int asciiGap);
+
+		std::size_t line(std::size_t offset) const;
+		std::size_t column(std::size_t offset) const;
+		// First byte of the line; line 0 may start at a later column
+		std::size_t lineStart(std::size_t line) const;
+		std::size_t lineCount(std::size_t size) const;
+		// Byte in the column of the line, the first one of line 0 for columns before it
+		std::size_t offsetAt(std::size_t line, std::size_t column) const;
+		// Moves the nibble position by lines, keeping its column; stops at 0
+		std::size_t moveLines(std::size_t nibble, qint64 lines) const;
+
+		// Left of the high nibble of the byte in the column
+		int hexX(std::size_t column) const;
+		int hexLeft() const;
+		int hexRight() const;
+		int asciiX(std::size_t column) const;
+		int asciiLeft() const;
+		int asciiRight() const;
+		// Byte column and nibble under x, false beside the columns
+		bool hexColumnAt(int x, std::size_t &column, bool &low) const;
+		bool asciiColumnAt(int x, std::size_t &column) const;
+
+	private:
+		void update();
+
+		std::size_t   m_bytesPerLine;
+		int           m_groupSize;
+		bool          m_littleEndian;
+		std::size_t   m_baseOffset;
+		// Columns of line 0 before its first byte
+		std::size_t   m_lead;
+		int           m_charWidth;
+		int           m_hexLeft;
+		int           m_asciiGap;
+		int           m_asciiLeft;
+};
+
+#endif
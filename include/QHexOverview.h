@@ -0,0 +1,82 @@
+#ifndef Q_HEX_OVERVIEW_H_
+#define Q_HEX_OVERVIEW_H_
+
+#include <QVector>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+#include "QHexJob.h"
+
+// Statistics of the whole storage for the overview strip: byte entropy and the
+// shares of 0x00, 0xFF and printable ASCII bytes per block. Blocks are computed
+// in parallel chunks read through the storage, nothing but the chunk being
+// scanned is held in memory. Blocks are merged pairwise into a pyramid of
+// coarser levels, so any range is summed up from O(log n) cells and resizing
+// the strip does not compute anything again.
+class QHexOverview: public QHexJob
+{
+	Q_OBJECT
+	public:
+		// Averages over the computed blocks of a range, all in [0, 1]
+		struct Cell
+		{
+			float     entropy;
+			float     zeros;
+			float     ones;         // 0xFF bytes
+			float     printable;
+			quint32   blocks;       // computed blocks covered, 0 while none is known
+		};
+
+		QHexOverview(const QHexView::DataStoragePtr &pData, QObject *parent = 0);
+		~QHexOverview();
+
+		void setThreadCount(int threads);
+
+		// Computes the blocks from position on; the ones before are kept
+		// unless the storage grew enough to need larger blocks
+		void start(std::size_t position = 0);
+
+		std::size_t size();
+		std::size_t blockSize();
+
+		// The storage split into count equal ranges, one cell each
+		QVector<Cell> cells(int count);
+
+		// The blocks of a complete computation, empty while it runs
+		QByteArray saveState();
+		// Takes saved blocks instead of computing them, if they were made for
+		// a storage of the current size
+		bool restoreState(const QByteArray &state);
+
+	signals:
+		void updated();
+		void progress(qulonglong done, qulonglong total);
+		void finished(bool ok);
+
+	private:
+		class Task;
+
+		void run();
+		// Lays the levels out for size, returns the first block to compute for a change at position
+		std::size_t resize(std::size_t size, std::size_t position);
+		void merge(std::size_t first, std::size_t last);
+		Cell range(std::size_t firstBlock, std::size_t lastBlock) const;
+
+		int                                  m_threads;
+		QThreadPool                          m_pool;
+
+		std::size_t                          m_blockSize;
+		std::size_t                          m_blocks;
+		std::size_t                          m_size;
+		std::size_t                          m_total;
+		bool                                 m_complete;
+		QAtomicInt                           m_nextBlock;
+		QAtomicInt                           m_workers;
+
+		QMutex                               m_cellsMtx;
+		// Level 0 holds the blocks, every next level half as many cells
+		QVector<QVector<Cell> >              m_levels;
+		quint64                              m_done;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef Q_HEX_OVERVIEW_BAR_H_
+#define Q_HEX_OVERVIEW_BAR_H_
+
+#include <QWidget>
+#include <QPointer>
+
+#include "QHexOverview.h"
+
+// Strip showing a QHexOverview of the whole data from top to bottom, with the
+// range the view shows outlined. Clicking or dragging reports the offset under
+// the mouse.
+class QHexOverviewBar: public QWidget
+{
+	Q_OBJECT
+	public:
+		enum Mode
+		{
+			Entropy,       // blue for uniform data to red for random or compressed data
+			Density,       // black for 0x00 to white for 0xFF
+			ByteClass      // mix of 0x00, 0xFF, printable ASCII and other bytes
+		};
+
+		QHexOverviewBar(QWidget *parent = 0);
+
+		void setOverview(QHexOverview *poverview);
+		void setMode(Mode mode);
+		Mode mode() const;
+		void setVisibleRange(std::size_t offset, std::size_t length);
+
+		virtual QSize sizeHint() const;
+
+	signals:
+		void offsetClicked(qulonglong offset);
+
+	protected:
+		void paintEvent(QPaintEvent *event);
+		void mousePressEvent(QMouseEvent *event);
+		void mouseMoveEvent(QMouseEvent *event);
+
+	private:
+		QColor cellColor(const QHexOverview::Cell &cell) const;
+		void reportOffset(int y);
+
+		QPointer<QHexOverview>   m_poverview;
+		Mode                     m_mode;
+		std::size_t              m_visibleOffset;
+		std::size_t              m_visibleLength;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef Q_HEX_SEARCH_H_
+#define Q_HEX_SEARCH_H_
+
+#include <QByteArray>
+#include <QMap>
+#include <QVector>
+#include <QString>
+#include <QRegularExpression>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+#include "QHexJob.h"
+
+// Searches a DataStorage in parallel, chunk by chunk, on its own thread pool.
+// Chunks overlap by the longest possible match, so matches crossing chunk
+// boundaries are found once (by the chunk they start in). Results are kept
+// per chunk in offset order and can be queried while the search runs.
+class QHexSearch: public QHexJob
+{
+	Q_OBJECT
+	public:
+		enum Mode
+		{
+			HexPattern,          // "de ad ?? ef", ?? matches any byte
+			Ascii,               // Latin-1 bytes, other characters are rejected
+			Utf16,               // little endian
+			RegularExpression    // matched against bytes as Latin-1 characters
+		};
+
+		struct Match
+		{
+			quint64   offset;
+			quint64   length;
+		};
+
+		QHexSearch(const QHexView::DataStoragePtr &pData, QObject *parent = 0);
+		~QHexSearch();
+
+		void setChunkSize(std::size_t size);
+		void setThreadCount(int threads);
+		// Longest match a regular expression is expected to produce
+		void setMaxMatchLength(std::size_t length);
+
+		// Returns false if the pattern can not be compiled, see errorString()
+		bool start(const QString &pattern, Mode mode, Qt::CaseSensitivity cs = Qt::CaseSensitive);
+		QString errorString() const;
+
+		std::size_t count();
+		// First match starting at or after offset / last one starting before it
+		bool next(std::size_t offset, Match &match);
+		bool previous(std::size_t offset, Match &match);
+		// Matches overlapping [begin, end), in offset order
+		QVector<Match> matches(std::size_t begin, std::size_t end);
+
+	signals:
+		void matchesFound(qulonglong count);
+		void progress(qulonglong done, qulonglong total);
+		void finished(bool ok);
+
+	private:
+		class Task;
+
+		bool compile(const QString &pattern, Mode mode, Qt::CaseSensitivity cs);
+		void run();
+		void searchBytes(const char *pdata, std::size_t length, std::size_t limit, std::size_t offset, QVector<Match> &res);
+		void searchRegex(const char *pdata, std::size_t length, std::size_t limit, std::size_t offset, QVector<Match> &res);
+
+		std::size_t                          m_chunkSize;
+		int                                  m_threads;
+		std::size_t                          m_maxMatchLength;
+		QThreadPool                          m_pool;
+		QString                              m_error;
+
+		// Compiled pattern: bytes with a mask (0 for wildcards) or a regular expression
+		QByteArray                           m_bytes;
+		QByteArray                           m_mask;
+		int                                  m_anchor;
+		bool                                 m_useRegex;
+		QRegularExpression                   m_regex;
+		// Bytes shared with the next chunk, so boundary-spanning matches are seen whole
+		std::size_t                          m_overlap;
+
+		std::size_t                          m_size;
+		std::size_t                          m_chunks;
+		QAtomicInt                           m_nextChunk;
+		QAtomicInt                           m_chunksDone;
+		QAtomicInt                           m_workers;
+
+		QMutex                               m_resultsMtx;
+		QMap<std::size_t, QVector<Match> >   m_results;
+		std::size_t                          m_count;
+};
+
+#endif
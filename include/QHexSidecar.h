@@ -0,0 +1,60 @@
+#ifndef Q_HEX_SIDECAR_H_
+#define Q_HEX_SIDECAR_H_
+
+#include <QByteArray>
+#include <QFile>
+#include <QMap>
+#include <QPair>
+#include <QString>
+
+// Index file holding data derived from a file (overview, highlights, ...) so it
+// does not have to be computed again when the file is reopened. The index
+// records the identity of the file it was made for: size, modification time and
+// a hash of samples spread over the file, so a changed file is detected without
+// reading it whole. The file stays the source of truth, a stale index is simply
+// not used. Indices are mapped into memory and sections handed out without copying.
+class QHexSidecar
+{
+	public:
+		enum Section
+		{
+			Overview = 1,
+			Highlights = 2,
+			GzipIndex = 3
+		};
+
+		struct Identity
+		{
+			quint64      size;
+			qint64       modified;     // msecs since epoch
+			QByteArray   hash;         // empty if the file cannot be read
+		};
+
+		QHexSidecar(const QString &indexPath);
+		~QHexSidecar();
+
+		// Index location in the user's cache directory, derived from the absolute file
+		// path; kind keeps indices written by different parts apart
+		static QString defaultPath(const QString &fileName, const QString &kind = QString());
+		static Identity identity(const QString &fileName);
+
+		// Maps the index; fails if it is missing, damaged or made for another state of the file
+		bool open(const QString &fileName);
+		void close();
+
+		// Bytes of the section, empty if there is none. They point into the
+		// mapping and stay valid until the sidecar is closed.
+		QByteArray section(quint32 tag) const;
+
+		// Replaces the index atomically with one for the current state of the file
+		static bool write(const QString &indexPath, const QString &fileName, const QMap<quint32, QByteArray> &sections);
+
+	private:
+		Q_DISABLE_COPY(QHexSidecar)
+
+		QFile                                         m_file;
+		uchar                                        *m_pmap;
+		QMap<quint32, QPair<quint64, quint64> >       m_sections;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef Q_HEX_STATS_H_
+#define Q_HEX_STATS_H_
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+
+// Timings and counters of the hot paths of QHexView and its storages. Samples
+// go into histograms with power-of-two buckets, so a sample costs the same
+// however many were taken and percentiles are known within a factor of two.
+// Recording is thread-safe, storages record from worker threads too.
+//
+// Names in use: paint.frame, paint.fetch, paint.bytes, layout (all but
+// paint.bytes in nanoseconds), read.<storage> for reads of the backends and
+// lookups of the cached, async, gzip and mapped caches.
+class QHexStats
+{
+	public:
+		class Histogram
+		{
+			public:
+				Histogram();
+				void add(qint64 value);
+
+				quint64 count() const;
+				double mean() const;
+				qint64 max() const;
+				// Upper bound of the bucket the fraction p of the samples falls into
+				qint64 percentile(double p) const;
+				QJsonObject toJson() const;
+			private:
+				enum {BUCKETS = 64};
+
+				quint64   m_buckets[BUCKETS];     // bucket i holds values below 2^i
+				quint64   m_count;
+				double    m_total;
+				qint64    m_max;
+		};
+
+		struct Lookups
+		{
+			quint64   hits;
+			quint64   misses;
+		};
+
+		// Adds the time until it goes out of scope to the histogram; does nothing without pstats
+		class Timer
+		{
+			public:
+				Timer(QHexStats *pstats, const char *name);
+				~Timer();
+			private:
+				QHexStats       *m_pstats;
+				const char      *m_name;
+				QElapsedTimer    m_timer;
+		};
+
+		QHexStats();
+
+		void add(const char *name, qint64 value);
+		void addLookup(const char *cache, bool hit);
+		void reset();
+
+		QMap<QByteArray, Histogram> histograms();
+		QMap<QByteArray, Lookups> lookups();
+
+		// Everything collected, to be attached to bug reports
+		QJsonObject toJson();
+		// Short summary lines, as the view's overlay shows them
+		QStringList summary();
+	private:
+		QMutex                          m_mtx;
+		QElapsedTimer                   m_since;
+		QMap<QByteArray, Histogram>     m_histograms;
+		QMap<QByteArray, Lookups>       m_lookups;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef Q_HEX_STRUCTURE_H_
+#define Q_HEX_STRUCTURE_H_
+
+#include <QCache>
+#include <QString>
+#include <QVector>
+
+#include "QHexJob.h"
+#include "QHexHighlights.h"
+#include "QHexTemplate.h"
+
+// Lays a QHexTemplate over the data, decoding on demand on the calling thread.
+// Nothing is read up front: a query decodes only the records overlapping the
+// queried range (or the node asked for), and keeps what it decoded. Elements
+// of arrays are located by arithmetic when their size is fixed; for variable
+// sized ones the ends found so far are kept, so every record is sized at most
+// once. Decoded elements sit in a bounded cache per array, which is what keeps
+// a file of millions of records cheap to browse.
+class QHexStructure: public QHexJob
+{
+	Q_OBJECT
+	public:
+		struct Field
+		{
+			quint64   offset;
+			quint64   length;
+			QString   path;        // "records[12].kind"
+			QString   type;        // "u16", "Record", "u8[16]"
+			QString   value;       // empty for structs and arrays
+			QRgb      color;
+			qint64    children;    // of structs and arrays, -1 while not all are known
+		};
+
+		QHexStructure(const QHexView::DataStoragePtr &pData, const QHexTemplate &tmpl, QObject *parent = 0);
+		~QHexStructure();
+
+		// Leaf fields overlapping [begin, end), in offset order. Fields placed
+		// with "at" are found if the struct holding them is decoded.
+		QVector<Field> fields(std::size_t begin, std::size_t end);
+		// The same as colored ranges, appended to res; what painting needs and no more
+		void ranges(std::size_t begin, std::size_t end, QVector<QHexHighlights::Range> &res);
+		// Innermost leaf field holding the byte at offset
+		bool fieldAt(std::size_t offset, Field &field);
+
+		// For tree views: the root, and the fields or elements of the node at path,
+		// up to count of them from first on
+		Field root();
+		QVector<Field> children(const QString &path, quint64 first = 0, quint64 count = 1000);
+
+		// Drops everything decoded, the data has changed
+		void reset();
+		// Nodes decoded since the last reset, evicted ones included
+		quint64 decoded() const;
+
+	private:
+		struct Node;
+
+		Node *rootNode();
+		Node *element(Node *parray, quint64 idx);
+		Node *find(const QString &path);
+		void layout(Node *pnode);
+		quint64 sizeOf(Node *pnode);
+		qint64 count(Node *pnode);
+		bool extendTo(Node *parray, quint64 idx);
+		quint64 firstItem(Node *parray, quint64 offset);
+		quint64 value(const QHexTemplate::Value &value, Node *pstruct);
+		quint64 readInteger(Node *pnode);
+		void collect(Node *pnode, quint64 begin, quint64 end, QVector<Field> *pfields, QVector<QHexHighlights::Range> *pranges);
+		Field describe(Node *pnode);
+		QString path(const Node *pnode) const;
+		QRgb colorOf(const Node *pnode) const;
+		QString format(Node *pnode);
+
+		bool isArray(const Node *pnode) const;
+		bool isStruct(const Node *pnode) const;
+		bool isLeaf(const Node *pnode) const;
+
+		QHexTemplate   m_template;
+		Node          *m_proot;
+		quint64        m_dataSize;
+		quint64        m_decoded;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef Q_HEX_TEMPLATE_H_
+#define Q_HEX_TEMPLATE_H_
+
+#include <QByteArray>
+#include <QColor>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+// Declarative description of the structures in a file, read from JSON:
+//
+//	{
+//		"endian": "little",
+//		"enums": {"Kind": {"1": "Start", "2": "Stop"}},
+//		"structs": {
+//			"Record": [
+//				{"name": "kind", "type": "u16", "enum": "Kind"},
+//				{"name": "length", "type": "u16"},
+//				{"name": "payload", "type": "u8", "count": "length"}
+//			]
+//		},
+//		"root": {"name": "records", "type": "Record", "count": "*"}
+//	}
+//
+// Types are u8..u64, i8..i64, f32, f64, char, byte or a struct. "count" makes
+// an array: a number, an earlier integer field of the same struct, or "*" for
+// as many as fit until the end of the data. "at" places a field at an absolute
+// offset (a number or an earlier integer field) instead of after the previous
+// one; it takes no room in its struct, and arrays of structs taking no room
+// are rejected. "endian" and "color" ("#rrggbb") may be given per field too.
+// Decoding is left to QHexStructure.
+class QHexTemplate
+{
+	public:
+		enum Primitive
+		{
+			Struct = -1,
+			U8, U16, U32, U64,
+			I8, I16, I32, I64,
+			F32, F64,
+			Char,          // arrays of it are shown as text
+			Byte           // arrays of it are shown as hex
+		};
+
+		// A count or an offset: a constant, the value of an earlier field, or the rest of the data
+		struct Value
+		{
+			enum Kind {None, Constant, FieldValue, ToEnd};
+
+			Kind      kind;
+			quint64   constant;
+			int       field;
+		};
+
+		struct Field
+		{
+			QString   name;
+			int       primitive;
+			int       structIdx;     // for Struct
+			int       enumIdx;       // -1 without
+			bool      bigEndian;
+			bool      array;
+			Value     count;
+			Value     at;
+			QRgb      color;
+		};
+
+		struct Struct
+		{
+			QString          name;
+			QVector<Field>   fields;
+			qint64           fixedSize;    // -1 when it depends on the data
+			bool             follows;      // has fields placed with "at", somewhere else
+		};
+
+		QHexTemplate();
+
+		// False on mistakes in the description, see errorString()
+		bool load(const QByteArray &json);
+		bool isValid() const;
+		QString errorString() const;
+
+		const Field &root() const;
+		const Struct &structAt(int idx) const;
+
+		// Size of a single item of the field's type, -1 when it depends on the data
+		qint64 itemSize(const Field &field) const;
+		QString typeName(const Field &field) const;
+		// Name of the value in the enum, empty if it has none
+		QString enumName(int enumIdx, qint64 value) const;
+
+		static int primitiveSize(int primitive);
+		static bool isInteger(int primitive);
+
+	private:
+		bool fail(const QString &error);
+		bool parseField(const QJsonObject &object, const Struct *pstruct, int colorIdx, Field &field);
+		bool parseValue(const QJsonValue &value, const Struct *pstruct, bool toEnd, Value &res);
+		bool computeSize(int idx, QVector<int> &state);
+
+		QVector<Struct>                  m_structs;
+		QMap<QString, int>               m_structIdx;
+		QVector<QMap<qint64, QString> >  m_enums;
+		QMap<QString, int>               m_enumIdx;
+		Field                            m_root;
+		bool                             m_bigEndian;
+		bool                             m_valid;
+		QString                          m_error;
+};
+
+#endif
@@ -2,23 +2,124 @@
 #define Q_HEX_VIEWER_H_
 
 #include <QAbstractScrollArea>
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include <QByteArray>
+#include <QCache>
+#include <QDateTime>
 #include <QFile>
 #include <QMutex>
+#include <QPainter>
+#include <QPixmap>
+#include <QSet>
+#include <QThreadPool>
+#include <QList>
+#include <QPair>
+#include <QVector>
+#include <QIODevice>
+#include <QPointer>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+
+#include "QHexHighlights.h"
+#include "QHexLayout.h"
+#include "QHexStats.h"
+
+class QTimer;
+class QFileSystemWatcher;
+class QHexJob;
+class QHexExport;
+class QHexAggregate;
+class QHexSearch;
+class QHexDiff;
+class QHexStructure;
+class QHexTemplate;
+class QHexOverview;
+class QHexOverviewBar;
+class QHexSidecar;
 
 class QHexView: public QAbstractScrollArea
 
 {
 	Q_OBJECT
 	public:
+		// Borrowed read-only span of storage bytes. m_holder keeps the bytes alive
+		// when the storage had to produce them; views into storage-owned memory
+		// (mappings) stay valid while the storage itself is alive.
+		class DataView
+		{
+			public:
+				DataView(): m_pdata(NULL), m_size(0) {}
+				DataView(const QByteArray &holder): m_holder(holder), m_pdata(holder.constData()), m_size(holder.size()) {}
+				DataView(const QByteArray &holder, const char *pdata, std::size_t size): m_holder(holder), m_pdata(pdata), m_size(size) {}
+
+				const char *data() const {return m_pdata;}
+				std::size_t size() const {return m_size;}
+				char at(std::size_t idx) const {return m_pdata[idx];}
+			private:
+				QByteArray    m_holder;
+				const char   *m_pdata;
+				std::size_t   m_size;
+		};
+
 		class DataStorage
 		{
 			public:
+				// Receives notifications from storages, possibly on a worker thread
+				class Listener
+				{
+					public:
+						virtual ~Listener() {};
+						virtual void dataReady(std::size_t position, std::size_t length) = 0;
+						// The bytes [position, position + length) changed or were appended, the
+						// size may have changed too. Length 0 stands for everything from position on.
+						virtual void dataChanged(std::size_t, std::size_t) {};
+				};
+
+				DataStorage(): m_plistener(NULL), m_pstats(NULL) {};
 				virtual ~DataStorage() {};
+
+				// Reads (getData, read, view, size, isReady, address, regionEnd) may come
+				// from several threads at once: background jobs read while the view
+				// paints. refresh() and edits come from the thread of the view.
 				virtual QByteArray getData(std::size_t position, std::size_t length) = 0;
 				virtual std::size_t size() = 0;
+
+				// Copies up to length bytes into dst, returns the number of bytes copied
+				virtual std::size_t read(std::size_t position, std::size_t length, char *dst);
+				// Returns the bytes without copying where the backend allows it
+				virtual DataView view(std::size_t position, std::size_t length);
+				// Non-blocking storages return false while the range is still being fetched
+				// and call Listener::dataReady once it has arrived
+				virtual bool isReady(std::size_t position, std::size_t length);
+				// Looks for changes of the underlying data, reports them with
+				// Listener::dataChanged and returns true if there were any. Backends
+				// which learn about changes by themselves call notifyChanged instead.
+				virtual bool refresh();
+				// The file holding the data, watched in follow mode; empty if there is none
+				virtual QString fileName();
+				// Storages of sparse data lay its contiguous regions end to end. address()
+				// gives the address shown for a position, regionEnd() the end of the
+				// region holding it; the view marks where regions meet.
+				virtual quint64 address(std::size_t position);
+				virtual std::size_t regionEnd(std::size_t position);
+
+				void setListener(Listener *pListener);
+				// Read latencies and cache lookups are recorded into pstats, NULL stops
+				// it. Storages over another one pass it on to their source.
+				virtual void setStats(QHexStats *pstats);
+			protected:
+				void notifyReady(std::size_t position, std::size_t length);
+				void notifyChanged(std::size_t position, std::size_t length);
+				QHexStats *stats();
+			private:
+				QAtomicPointer<Listener>    m_plistener;
+				QAtomicPointer<QHexStats>   m_pstats;
 		};
 
+		// The view and the jobs reading a storage share it, the last one to let go deletes it
+		typedef QSharedPointer<DataStorage> DataStoragePtr;
+
 
 		class DataStorageArray: public DataStorage
 		{
@@ -26,6 +127,8 @@ class QHexView: public QAbstractScrollArea
 				DataStorageArray(const QByteArray &arr);
 				virtual QByteArray getData(std::size_t position, std::size_t length);
 				virtual std::size_t size();
+				virtual std::size_t read(std::size_t position, std::size_t length, char *dst);
+				virtual DataView view(std::size_t position, std::size_t length);
 			private:
 				QByteArray    m_data;
 		};
@@ -36,32 +139,460 @@ class QHexView: public QAbstractScrollArea
 				DataStorageFile(const QString &fileName);
 				virtual QByteArray getData(std::size_t position, std::size_t length);
 				virtual std::size_t size();
+				virtual std::size_t read(std::size_t position, std::size_t length, char *dst);
+				virtual DataView view(std::size_t position, std::size_t length);
+				virtual bool refresh();
+				virtual QString fileName();
+			private:
+				QFile        m_file;
+				// Guards the size, and the file position where there is no pread
+				QMutex       m_mtx;
+				std::size_t  m_size;
+				QDateTime    m_modified;
+		};
+
+		// Maps the file into memory instead of reading it. Files that fit into the
+		// address space are mapped once and getData returns views into the mapping
+		// without copying (valid while the storage lives); bigger files are served
+		// through a sliding window.
+		class DataStorageMapped: public DataStorage
+		{
+			public:
+				DataStorageMapped(const QString &fileName, std::size_t windowSize = 64 * 1024 * 1024);
+				~DataStorageMapped();
+				virtual QByteArray getData(std::size_t position, std::size_t length);
+				virtual std::size_t size();
+				virtual std::size_t read(std::size_t position, std::size_t length, char *dst);
+				virtual DataView view(std::size_t position, std::size_t length);
+				// Growth or a replaced file (log rotation) remaps it, views returned before are no longer valid
+				virtual bool refresh();
+				virtual QString fileName();
+			private:
+				const uchar *mapWindow(std::size_t position, std::size_t length);
+				void map();
+				void unmap();
+
+				QFile            m_file;
+				// Readers share the mapping, refresh() replaces it exclusively
+				QReadWriteLock   m_mapLock;
+				// The window and the file position serve one reader at a time
+				QMutex           m_windowMtx;
+				QDateTime        m_modified;
+				std::size_t      m_size;
+				uchar           *m_pwhole;
+				uchar           *m_pwindow;
+				std::size_t      m_windowPos;
+				std::size_t      m_windowLength;
+				std::size_t      m_windowSize;
+		};
+
+
+		// Keeps recently used fixed-size pages of another storage in memory (LRU,
+		// limited by budget bytes) and reads several pages ahead in one request when
+		// pages are accessed sequentially in either direction. Takes ownership of pSource.
+		class DataStorageCached: public DataStorage, private DataStorage::Listener
+		{
+			public:
+				DataStorageCached(DataStorage *pSource, std::size_t budget = 32 * 1024 * 1024, std::size_t pageSize = 64 * 1024, std::size_t readAhead = 4);
+				~DataStorageCached();
+				virtual QByteArray getData(std::size_t position, std::size_t length);
+				virtual std::size_t size();
+				virtual std::size_t read(std::size_t position, std::size_t length, char *dst);
+				virtual DataView view(std::size_t position, std::size_t length);
+
+				virtual bool refresh();
+				virtual QString fileName();
+				virtual quint64 address(std::size_t position);
+				virtual std::size_t regionEnd(std::size_t position);
+				virtual void setStats(QHexStats *pstats);
+
+				quint64 hits() const;
+				quint64 misses() const;
+				void resetStats();
+			private:
+				virtual void dataReady(std::size_t position, std::size_t length);
+				virtual void dataChanged(std::size_t position, std::size_t length);
+				QByteArray page(std::size_t idx);
+
+				DataStorage                        *m_psource;
+				// Held for lookups only, pages are read from the source without it
+				mutable QMutex                      m_cacheMtx;
+				QCache<std::size_t, QByteArray>     m_pages;
+				std::size_t                         m_pageSize;
+				std::size_t                         m_readAhead;
+				std::size_t                         m_lastPage;
+				quint64                             m_generation;     // bumped by every change of the source
+				quint64                             m_hits;
+				quint64                             m_misses;
+		};
+
+
+		// Fetches pages of a slow storage on a pool of worker threads. isReady never
+		// blocks: missing pages are queued and the listener is notified when they
+		// land. getData still blocks for callers which need the bytes right away.
+		// Takes ownership of pSource.
+		class DataStorageAsync: public DataStorage, private DataStorage::Listener
+		{
+			public:
+				DataStorageAsync(DataStorage *pSource, std::size_t pageSize = 64 * 1024, int threads = 4, std::size_t maxPages = 1024);
+				~DataStorageAsync();
+				virtual QByteArray getData(std::size_t position, std::size_t length);
+				virtual std::size_t size();
+				virtual bool isReady(std::size_t position, std::size_t length);
+				virtual bool refresh();
+				virtual QString fileName();
+				virtual quint64 address(std::size_t position);
+				virtual std::size_t regionEnd(std::size_t position);
+				virtual void setStats(QHexStats *pstats);
+			private:
+				class FetchTask;
+
+				virtual void dataReady(std::size_t position, std::size_t length);
+				virtual void dataChanged(std::size_t position, std::size_t length);
+				QByteArray loadPage(std::size_t idx);
+				void fetchPage(std::size_t idx);
+
+				DataStorage                        *m_psource;
+				// Reads of the source share it, refresh takes it alone
+				QReadWriteLock                      m_sourceLock;
+				QMutex                              m_pagesMtx;
+				QCache<std::size_t, QByteArray>     m_pages;
+				QSet<std::size_t>                   m_pending;
+				QThreadPool                         m_pool;
+				std::size_t                         m_pageSize;
+				// m_size and below are guarded by m_pagesMtx
+				std::size_t                         m_size;
+				// Bumped when the source changes, pages fetched before are dropped
+				int                                 m_generation;
+				// Changes the source reports from within refresh, forwarded once it returns
+				QThread                            *m_prefreshThread;
+				QList<QPair<std::size_t, std::size_t> > m_changes;
+		};
+
+
+#ifdef Q_OS_LINUX
+		// Memory of a running process, read through /proc/<pid>/mem. The readable
+		// mappings listed in /proc/<pid>/maps are laid end to end: the gaps between
+		// them take no positions, so they are never read nor scrolled over. Ranges
+		// spanning several mappings are read with one process_vm_readv call. Pages
+		// which cannot be read show as zeros; refresh() reloads the mappings.
+		class DataStorageProcess: public DataStorage
+		{
+			public:
+				DataStorageProcess(qint64 pid);
+				~DataStorageProcess();
+				virtual QByteArray getData(std::size_t position, std::size_t length);
+				virtual std::size_t size();
+				virtual std::size_t read(std::size_t position, std::size_t length, char *dst);
+				virtual bool refresh();
+				virtual quint64 address(std::size_t position);
+				virtual std::size_t regionEnd(std::size_t position);
+
+				// Position of the byte at address, false if it is not mapped
+				bool position(quint64 address, std::size_t &position) const;
+			private:
+				struct Region
+				{
+					quint64   address;
+					quint64   position;
+					quint64   length;
+				};
+
+				bool loadMaps(QVector<Region> &regions) const;
+				int regionAt(std::size_t position) const;
+				std::size_t readPages(quint64 address, std::size_t length, char *dst);
+
+				qint64                   m_pid;
+				int                      m_fd;
+				// Readers share the regions, refresh() reloads them exclusively
+				mutable QReadWriteLock   m_regionsLock;
+				QVector<Region>          m_regions;
+				std::size_t              m_size;
+		};
+#endif
+
+
+		// Decompressed contents of a gzip file with random access. A background pass
+		// records a seek point every span bytes of output: the bit position and the
+		// last 32 KB of output needed to resume inflating there, as zlib's zran does.
+		// Reads inflate from the nearest point before them, or go on from where the
+		// last read stopped. Until the pass is done the size grows as data gets
+		// indexed, which listeners learn from dataChanged. The index is kept with
+		// QHexSidecar and reused while the file is unchanged.
+		class DataStorageGzip: public DataStorage
+		{
+			public:
+				DataStorageGzip(const QString &fileName, std::size_t span = 4 * 1024 * 1024);
+				~DataStorageGzip();
+				virtual QByteArray getData(std::size_t position, std::size_t length);
+				virtual std::size_t size();
+				virtual std::size_t read(std::size_t position, std::size_t length, char *dst);
+				virtual QString fileName();
+
+				// True once the whole file has been indexed
+				bool isIndexed();
 			private:
-				QFile      m_file;
+				class IndexTask;
+				struct Reader;
+
+				struct Point
+				{
+					quint64      out;          // offset in the decompressed data
+					quint64      in;           // offset in the file
+					int          bits;         // bits of the byte before in still to be read
+					bool         header;       // start of a gzip member, nothing to restore
+					QByteArray   window;       // deflated last 32 KB of output
+				};
+
+				void buildIndex();
+				bool loadIndex();
+				void saveIndex();
+				Point pointBefore(std::size_t position);
+				bool startAt(const Point &point);
+				std::size_t inflateTo(char *dst, std::size_t length);
+				QByteArray page(std::size_t idx);
+
+				QFile                         m_file;
+				std::size_t                   m_span;
+				// The reader, its file position and the pages serve one reader at a time
+				QMutex                        m_readerMtx;
+				Reader                       *m_preader;
+				QCache<std::size_t, QByteArray>   m_pages;
+
+				QMutex                        m_indexMtx;
+				QVector<Point>                m_points;
+				std::size_t                   m_size;
+				bool                          m_indexed;
+				QAtomicInt                    m_canceled;
+				QThreadPool                   m_pool;
 		};
 
 
+		// Edits on top of another storage kept in a piece table: the data is a sequence
+		// of pieces, each a span of the source or of an append-only buffer of typed
+		// bytes, so edits never copy the source. Every edit records the pieces it
+		// replaced for undo/redo; edits made with merge set join the previous undo step.
+		// Takes ownership of pSource.
+		class DataStorageEditable: public DataStorage, private DataStorage::Listener
+		{
+			public:
+				DataStorageEditable(DataStorage *pSource);
+				~DataStorageEditable();
+				virtual QByteArray getData(std::size_t position, std::size_t length);
+				virtual std::size_t size();
+				virtual std::size_t read(std::size_t position, std::size_t length, char *dst);
+				virtual DataView view(std::size_t position, std::size_t length);
+				virtual bool isReady(std::size_t position, std::size_t length);
+				virtual bool refresh();
+				virtual QString fileName();
+				// Added bytes take the addresses following the source byte before them
+				virtual quint64 address(std::size_t position);
+				virtual std::size_t regionEnd(std::size_t position);
+				virtual void setStats(QHexStats *pstats);
+
+				// Overwriting past the end appends
+				void overwrite(std::size_t position, const QByteArray &data, bool merge = false);
+				void insert(std::size_t position, const QByteArray &data, bool merge = false);
+				void remove(std::size_t position, std::size_t length, bool merge = false);
+
+				bool canUndo() const;
+				bool canRedo() const;
+				// Return the position of the reverted change through pposition
+				bool undo(std::size_t *pposition = NULL);
+				bool redo(std::size_t *pposition = NULL);
+				bool isModified() const;
+
+				// True if the edits only overwrote bytes, so the source file can be patched
+				bool canSaveInPlace() const;
+				// Writes only the changed pieces into pdevice, which holds the source data.
+				// The edits become the new source content and the history is cleared.
+				bool saveInPlace(QIODevice *pdevice);
+				// Streams the whole edited data into pdevice
+				bool saveTo(QIODevice *pdevice);
+			private:
+				struct Piece
+				{
+					quint64   position;   // in the edited data
+					quint64   offset;     // in the source or m_added
+					quint64   length;
+					bool      added;
+				};
+
+				struct Change
+				{
+					int               group;
+					quint64           position;
+					int               first;
+					// m_added held this much before, the bytes after are the change's own
+					quint64           addedSize;
+					QVector<Piece>    removed;
+					QVector<Piece>    inserted;
+				};
+
+				virtual void dataReady(std::size_t position, std::size_t length);
+				virtual void dataChanged(std::size_t position, std::size_t length);
+
+				void replace(std::size_t position, std::size_t length, const QByteArray &data, bool merge);
+				// canSaveInPlace without taking m_lock, the caller holds it
+				bool onlyOverwritten() const;
+				void apply(int first, int count, const QVector<Piece> &pieces);
+				int pieceAt(std::size_t position) const;
+
+				DataStorage            *m_psource;
+				// Readers share the pieces, edits change them exclusively
+				mutable QReadWriteLock  m_lock;
+				std::size_t             m_sourceSize;
+				QByteArray              m_added;
+				QVector<Piece>          m_pieces;
+				std::size_t             m_size;
+
+				QVector<Change>         m_undo;
+				QVector<Change>         m_redo;
+				int                     m_group;
+				int                     m_savedGroup;
+		};
+
 
 		QHexView(QWidget *parent = 0);
 		~QHexView();
 
+		// Jobs reading the current data; they are canceled when the data changes
+		QHexExport *createExport();
+		QHexSearch *createSearch();
+		QHexAggregate *createAggregate();
+
+		// Matches of the search are highlighted, findNext()/findPrevious() step through them
+		void setSearch(QHexSearch *psearch);
+		// Compares the data with that of pother, the job is canceled when either view's data changes
+		QHexDiff *createDiff(QHexView *pother);
+		// Differences found by the diff are highlighted
+		void setDiff(QHexDiff *pdiff);
+		// Decodes the data as the template describes, only where it is looked at
+		QHexStructure *createStructure(const QHexTemplate &tmpl);
+		// Fields of the structure are colored, hovering one shows its value
+		void setStructure(QHexStructure *pstructure);
+		std::size_t firstVisibleLine() const;
+
+		// Follow mode watches the data for changes (file notifications where the
+		// storage has a file, polling otherwise) and keeps showing the tail
+		// when scrollToTail is set and the view was at the end
+		void setFollow(bool follow, bool scrollToTail = true);
+		bool follow() const;
+		void setPollInterval(int msec);
+
+		// Strip between the data and the scrollbar giving an overview of the
+		// whole data, computed in the background; clicking it jumps there
+		QHexOverview *createOverview();
+		void setOverviewVisible(bool visible);
+		bool overviewVisible() const;
+		QHexOverviewBar *overviewBar();
+
+		// Restores the overview and highlights kept in an index of the file shown
+		// (see QHexSidecar). A missing or stale index is ignored and false returned,
+		// the overview is then computed as usual.
+		bool loadIndex(const QString &indexPath);
+		// Stores them for the next time the file is opened; the overview only once it is complete
+		bool saveIndex(const QString &indexPath);
+
+		// Copy to the clipboard is refused above this many bytes, copyLimitExceeded is emitted instead
+		void setCopyLimit(std::size_t bytes);
+		std::size_t copyLimit() const;
+
+		// Timings of painting, layout and storage reads, and cache hit rates
+		// (see QHexStats); nothing is measured while disabled
+		void setStatsEnabled(bool enabled);
+		bool statsEnabled() const;
+		QHexStats *stats();
+		// Overlay in the top right corner of the viewport with the numbers; showing it enables the stats
+		void setStatsOverlayVisible(bool visible);
+		bool statsOverlayVisible() const;
+
+		// Colored ranges drawn below the selection, higher layers over lower ones
+		void addHighlight(std::size_t offset, std::size_t length, const QColor &color, int layer = 0);
+		// Removes the highlights of the layer overlapping the range
+		void removeHighlight(std::size_t offset, std::size_t length, int layer = 0);
+		void clearHighlights(int layer);
+		void clearHighlights();
+
+		// Lines of a fixed number of bytes, for records of that size; 0 fits the
+		// lines to the width again. Lines wider than the view scroll horizontally.
+		void setBytesPerLine(std::size_t bytes);
+		std::size_t bytesPerLine() const;
+		// Bytes shown as words of 1, 2, 4 or 8 bytes; littleEndian reverses the
+		// bytes of each word, so that it reads as its value
+		void setGrouping(int groupSize, bool littleEndian = false);
+		// Lines start at offset + k * bytesPerLine, the bytes before fill the end of the first line
+		void setBaseOffset(std::size_t offset);
+		const QHexLayout &hexLayout() const;
+
+		std::size_t selectionOffset() const;
+		std::size_t selectionLength() const;
+		std::size_t cursorOffset() const;
+		// Up to length bytes of the current data from offset on, for small reads on the thread of the view
+		QByteArray readData(std::size_t offset, std::size_t length);
+
+		// Typing edits the data if it is a DataStorageEditable. In insert mode
+		// (toggled with the Insert key) typed bytes are inserted instead of overwritten.
+		bool isEditable() const;
+		void setInsertMode(bool insert);
+		bool insertMode() const;
+		bool isModified();
+		bool canSaveInPlace();
+		// Writes only the changed bytes into pdevice, the opened source file
+		bool saveInPlace(QIODevice *pdevice);
+		// Writes the whole edited data into pdevice
+		bool saveTo(QIODevice *pdevice);
+
+	signals:
+		void copyLimitExceeded(qulonglong offset, qulonglong length);
+		void dataEdited();
+		// Receivers may call back into the view directly
+		void firstLineChanged(qulonglong line);
+		// Emitted about twice a second while frames are painted with stats enabled
+		void statsUpdated();
+		// The byte under the cursor, and the selected bytes, changed
+		void cursorMoved(qulonglong offset);
+		void selectionChanged(qulonglong offset, qulonglong length);
+
 	public slots:
 		void setData(DataStorage *pData);
 		void clear();
 		void showFromOffset(std::size_t offset);
 		void setSelected(std::size_t offset, std::size_t length);
+		bool findNext();
+		bool findPrevious();
+		void undo();
+		void redo();
+		void setFirstVisibleLine(qulonglong line);
 
 	protected:
 		void paintEvent(QPaintEvent *event);
 		void keyPressEvent(QKeyEvent *event);
 		void mouseMoveEvent(QMouseEvent *event);
 		void mousePressEvent(QMouseEvent *event);
+		void resizeEvent(QResizeEvent *event);
+		void changeEvent(QEvent *event);
+		bool viewportEvent(QEvent *event);
+		void scrollContentsBy(int dx, int dy);
+		void wheelEvent(QWheelEvent *event);
+	private slots:
+		void slotDataReady(qulonglong position, qulonglong length);
+		void slotDataChanged(qulonglong position, qulonglong length);
+		void slotPoll();
+		void slotOverviewClicked(qulonglong offset);
+		void slotScrollAction(int action);
+		void slotStatsTimer();
 	private:
-		QMutex                m_dataMtx;
-		DataStorage          *m_pdata;
+		class StorageListener;
+		struct StorageDeleter;
+
+		// View state is only touched on the GUI thread, the storage is shared with
+		// the jobs reading it. Every storage gets its own listener, so a storage
+		// still held by a job cannot reach the view any more once it was replaced.
+		DataStoragePtr                     m_pdata;
+		QSharedPointer<StorageListener>    m_plistener;
+		DataStorageEditable  *m_pedit;
 		std::size_t           m_posAddr; 
-		std::size_t           m_posHex;
-		std::size_t           m_posAscii;
 		std::size_t           m_charWidth;
 		std::size_t           m_charHeight;
 
@@ -70,10 +601,84 @@ class QHexView: public QAbstractScrollArea
 		std::size_t           m_selectEnd;
 		std::size_t           m_selectInit;
 		std::size_t           m_cursorPos;
-		std::size_t           m_bytesPerLine;
+		QHexLayout            m_layout;
+		// Bytes per line asked for with setBytesPerLine, 0 while the width decides
+		std::size_t           m_lineBytes;
+		// Pixels the hex and text columns are scrolled to the left
+		int                   m_scrollX;
+		// Hex digits of the address column, more than ADR_LENGTH for large addresses
+		int                   m_addressLength;
+		std::size_t           m_copyLimit;
+		bool                  m_insertMode;
+		// Cursor position after the last typed nibble, typing on from there joins its undo step
+		std::size_t           m_typingPos;
+
+		QList<QPointer<QHexJob> >      m_jobs;
+		QPointer<QHexSearch>           m_psearch;
+		QPointer<QHexDiff>             m_pdiff;
+		QPointer<QHexStructure>        m_pstructure;
+		QHexHighlights                 m_highlights;
+
+		bool                           m_follow;
+		bool                           m_followTail;
+		QTimer                        *m_ppollTimer;
+		QFileSystemWatcher            *m_pwatcher;
+
+		QHexOverviewBar               *m_poverviewBar;
+		QPointer<QHexOverview>         m_poverview;
+		// Index of the file shown, kept mapped while its sections are in use
+		QHexSidecar                   *m_psidecar;
+		// Overview blocks in the mapped index, used instead of computing them
+		QByteArray                     m_overviewState;
+
+		QHexStats                      m_stats;
+		bool                           m_statsEnabled;
+		bool                           m_statsOverlay;
+		QTimer                        *m_pstatsTimer;
+		// Frames painted when statsUpdated was last emitted
+		quint64                        m_statsFrames;
+
+		// Exact first visible line, the scrollbar only approximates it for huge data
+		std::size_t           m_firstLine;
+		bool                  m_scrollSync;
+		std::size_t           m_actionLine;
+		bool                  m_hasActionLine;
+
+		QPixmap               m_glyphAtlas;
+		QFont                 m_atlasFont;
+		qreal                 m_atlasRatio;
 
-		QSize fullSize() const;
+		std::size_t lineCount() const;
+		std::size_t visibleLines() const;
+		std::size_t maxFirstLine() const;
+		int lineToScrollValue(std::size_t line) const;
+		std::size_t scrollValueToLine(int value) const;
+		void setFirstLine(std::size_t line);
+		void scrollViewport(std::size_t prevLine);
 		void updatePositions();
+		void updateLayout();
+		void updateScrollBar();
+		void updateGlyphAtlas();
+		QRect linesRect(std::size_t firstLine, std::size_t lastLine) const;
+		void updateNibbles(std::size_t begin, std::size_t end);
+		void updateChanges(std::size_t cursorPos, std::size_t selectBegin, std::size_t selectEnd);
+		QPainter::PixmapFragment glyphFragment(int glyph, qreal x, qreal y) const;
+		void cancelJobs();
+		void releaseData();
+		void watchData();
+		void placeOverviewBar();
+		void startOverview();
+		void closeIndex();
+		void updateOverviewRange();
+		QHexStats *activeStats();
+		QRect statsOverlayRect() const;
+		void drawStatsOverlay(QPainter &painter);
+		void fillBytes(QPainter &painter, std::size_t lineIdx, int yTop, std::size_t begin, std::size_t end, const QColor &color);
+		void fillRange(QPainter &painter, std::size_t firstIdx, std::size_t lastIdx, int yTop, std::size_t begin, std::size_t end, const QColor &color);
+		void selectMatch(std::size_t offset, std::size_t length);
+		bool editKey(QKeyEvent *event, bool merge);
+		void dataResized(std::size_t position);
+		bool revert(bool redo);
 		void resetSelection();
 		void resetSelection(std::size_t pos);
 		void setSelection(std::size_t pos);
@@ -0,0 +1,365 @@
+#include "../include/QHexAggregate.h"
+
+#include <QCryptographicHash>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+#include <zlib.h>
+
+const std::size_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+// Chunks are counted into 32-bit histograms
+const std::size_t MAX_CHUNK_SIZE = 256 * 1024 * 1024;
+// Values converted at a time, small enough to stay in L1
+const std::size_t VALUE_BLOCK = 512;
+
+
+class QHexAggregate::Task: public QRunnable
+{
+	public:
+		Task(QHexAggregate *paggregate): m_paggregate(paggregate) {}
+
+		virtual void run()
+		{
+			m_paggregate->run();
+		}
+	private:
+		QHexAggregate   *m_paggregate;
+};
+
+
+// Streaming XXH64 with seed 0
+class Xxh64
+{
+	public:
+		Xxh64(): m_total(0), m_buffered(0)
+		{
+			m_lanes[0] = PRIME1 + PRIME2;
+			m_lanes[1] = PRIME2;
+			m_lanes[2] = 0;
+			m_lanes[3] = -PRIME1;
+		}
+
+		void update(const uchar *pdata, std::size_t length)
+		{
+			m_total += length;
+			if(m_buffered + length < 32)
+			{
+				memcpy(m_buffer + m_buffered, pdata, length);
+				m_buffered += length;
+				return;
+			}
+
+			if(m_buffered)
+			{
+				std::size_t fill = 32 - m_buffered;
+				memcpy(m_buffer + m_buffered, pdata, fill);
+				stripe(m_buffer);
+				pdata += fill;
+				length -= fill;
+				m_buffered = 0;
+			}
+
+			// Four independent lanes, the loop runs at memory speed
+			for(; length >= 32; pdata += 32, length -= 32)
+				stripe(pdata);
+
+			memcpy(m_buffer, pdata, length);
+			m_buffered = length;
+		}
+
+		quint64 digest() const
+		{
+			quint64 hash;
+			if(m_total >= 32)
+			{
+				hash = rotl(m_lanes[0], 1) + rotl(m_lanes[1], 7) + rotl(m_lanes[2], 12) + rotl(m_lanes[3], 18);
+				for(int i = 0; i < 4; i++)
+					hash = (hash ^ round(0, m_lanes[i])) * PRIME1 + PRIME4;
+			}
+			else
+				hash = PRIME5;
+			hash += m_total;
+
+			const uchar *pdata = m_buffer;
+			std::size_t length = m_buffered;
+			for(; length >= 8; pdata += 8, length -= 8)
+				hash = rotl(hash ^ round(0, qFromLittleEndian<quint64>(pdata)), 27) * PRIME1 + PRIME4;
+			if(length >= 4)
+			{
+				hash = rotl(hash ^ (qFromLittleEndian<quint32>(pdata) * PRIME1), 23) * PRIME2 + PRIME3;
+				pdata += 4;
+				length -= 4;
+			}
+			for(; length; pdata++, length--)
+				hash = rotl(hash ^ (*pdata * PRIME5), 11) * PRIME1;
+
+			hash ^= hash >> 33;
+			hash *= PRIME2;
+			hash ^= hash >> 29;
+			hash *= PRIME3;
+			hash ^= hash >> 32;
+			return hash;
+		}
+
+	private:
+		static const quint64 PRIME1 = 11400714785074694791ULL;
+		static const quint64 PRIME2 = 14029467366897019727ULL;
+		static const quint64 PRIME3 = 1609587929392839161ULL;
+		static const quint64 PRIME4 = 9650029242287828579ULL;
+		static const quint64 PRIME5 = 2870177450012600261ULL;
+
+		static quint64 rotl(quint64 value, int bits)
+		{
+			return (value << bits) | (value >> (64 - bits));
+		}
+
+		static quint64 round(quint64 acc, quint64 input)
+		{
+			return rotl(acc + input * PRIME2, 31) * PRIME1;
+		}
+
+		void stripe(const uchar *pdata)
+		{
+			for(int i = 0; i < 4; i++)
+				m_lanes[i] = round(m_lanes[i], qFromLittleEndian<quint64>(pdata + 8 * i));
+		}
+
+		quint64   m_lanes[4];
+		quint64   m_total;
+		uchar     m_buffer[32];
+		std::size_t m_buffered;
+};
+
+
+static void countBytes(const uchar *pdata, std::size_t length, quint64 *histogram)
+{
+	// Runs of equal bytes would serialize on a single counter, four tables keep the increments independent
+	static const int TABLES = 4;
+	quint32 counts[TABLES][256];
+	memset(counts, 0, sizeof(counts));
+
+	std::size_t i = 0;
+	for(; i + TABLES <= length; i += TABLES)
+	{
+		counts[0][pdata[i]]++;
+		counts[1][pdata[i + 1]]++;
+		counts[2][pdata[i + 2]]++;
+		counts[3][pdata[i + 3]]++;
+	}
+	for(; i < length; i++)
+		counts[0][pdata[i]]++;
+
+	for(int value = 0; value < 256; value++)
+		histogram[value] += counts[0][value] + counts[1][value] + counts[2][value] + counts[3][value];
+}
+
+
+template<typename W>
+struct Totals
+{
+	Totals(): any(false), min(0), max(0), sum(0) {}
+
+	bool     any;
+	W        min;
+	W        max;
+	double   sum;
+};
+
+// T is the element type, S what a block of them is summed in (exact and
+// vectorizable for narrow integers), W what the totals are kept in
+template<typename T, typename S, typename W>
+static void addValues(const char *pdata, std::size_t count, bool swap, Totals<W> &totals)
+{
+	T values[VALUE_BLOCK];
+	for(std::size_t pos = 0; pos < count; pos += VALUE_BLOCK)
+	{
+		std::size_t n = std::min(VALUE_BLOCK, count - pos);
+		memcpy(values, pdata + pos * sizeof(T), n * sizeof(T));
+		if(swap)
+		{
+			char *praw = (char *)values;
+			for(std::size_t i = 0; i < n; i++)
+				std::reverse(praw + i * sizeof(T), praw + (i + 1) * sizeof(T));
+		}
+
+		T low = values[0];
+		T high = values[0];
+		S sum = 0;
+		for(std::size_t i = 0; i < n; i++)
+		{
+			low = values[i] < low ? values[i] : low;
+			high = values[i] > high ? values[i] : high;
+			sum += values[i];
+		}
+
+		if(!totals.any || low < totals.min)
+			totals.min = low;
+		if(!totals.any || high > totals.max)
+			totals.max = high;
+		totals.sum += sum;
+		totals.any = true;
+	}
+}
+
+
+QHexAggregate::QHexAggregate(const QHexView::DataStoragePtr &pData, QObject *parent):
+QHexJob(pData, parent),
+m_chunkSize(DEFAULT_CHUNK_SIZE),
+m_type(UInt8),
+m_bigEndian(false),
+m_offset(0),
+m_length(0)
+{
+}
+
+QHexAggregate::~QHexAggregate()
+{
+	cancel();
+	wait();
+}
+
+void QHexAggregate::setChunkSize(std::size_t size)
+{
+	// Whole elements of any type fit into a chunk
+	m_chunkSize = std::min(std::max<std::size_t>(size / 8 * 8, 8), MAX_CHUNK_SIZE);
+}
+
+void QHexAggregate::setElementType(ElementType type, bool bigEndian)
+{
+	m_type = type;
+	m_bigEndian = bigEndian;
+}
+
+int QHexAggregate::elementSize(ElementType type)
+{
+	switch(type)
+	{
+		case Int8: case UInt8:
+			return 1;
+		case Int16: case UInt16:
+			return 2;
+		case Int32: case UInt32: case Float:
+			return 4;
+		default:
+			return 8;
+	}
+}
+
+void QHexAggregate::start(std::size_t offset, std::size_t length)
+{
+	// The previous range stops at its next chunk instead of running to its end
+	cancel();
+	wait();
+
+	m_offset = offset;
+	m_length = length;
+	resetCanceled();
+
+	taskStarted();
+	QThreadPool::globalInstance()->start(new Task(this));
+}
+
+QHexAggregate::Result QHexAggregate::result() const
+{
+	QMutexLocker lock(&m_resultMtx);
+	return m_result;
+}
+
+void QHexAggregate::run()
+{
+	Result res;
+	res.length = 0;
+	res.elements = 0;
+	res.sum = 0;
+	memset(res.histogram, 0, sizeof(res.histogram));
+
+	QByteArray buffer(m_chunkSize, Qt::Uninitialized);
+	QCryptographicHash sha256(QCryptographicHash::Sha256);
+	Xxh64 xxh64;
+	uLong crc = crc32(0, Z_NULL, 0);
+
+	Totals<qint64> ints;
+	Totals<quint64> uints;
+	Totals<double> floats;
+	bool swap = m_bigEndian == (Q_BYTE_ORDER == Q_LITTLE_ENDIAN);
+	int size = elementSize(m_type);
+
+	bool ok = true;
+	for(std::size_t done = 0; done < m_length; )
+	{
+		if(isCanceled())
+		{
+			ok = false;
+			break;
+		}
+
+		std::size_t count = std::min(m_chunkSize, m_length - done);
+		if(readData(m_offset + done, count, buffer.data()) != count)
+		{
+			ok = false;
+			break;
+		}
+
+		// Every aggregate takes the chunk while it is in cache
+		const char *pdata = buffer.constData();
+		crc = crc32(crc, (const Bytef *)pdata, count);
+		xxh64.update((const uchar *)pdata, count);
+		sha256.addData(pdata, count);
+		countBytes((const uchar *)pdata, count, res.histogram);
+
+		// Chunks hold whole elements, only the end of the range may cut one
+		std::size_t elements = count / size;
+		switch(m_type)
+		{
+			case Int8:   addValues<qint8, qint64>(pdata, elements, swap, ints); break;
+			case UInt8:  addValues<quint8, qint64>(pdata, elements, swap, uints); break;
+			case Int16:  addValues<qint16, qint64>(pdata, elements, swap, ints); break;
+			case UInt16: addValues<quint16, qint64>(pdata, elements, swap, uints); break;
+			case Int32:  addValues<qint32, qint64>(pdata, elements, swap, ints); break;
+			case UInt32: addValues<quint32, qint64>(pdata, elements, swap, uints); break;
+			case Int64:  addValues<qint64, double>(pdata, elements, swap, ints); break;
+			case UInt64: addValues<quint64, double>(pdata, elements, swap, uints); break;
+			case Float:  addValues<float, double>(pdata, elements, swap, floats); break;
+			case Double: addValues<double, double>(pdata, elements, swap, floats); break;
+		}
+		res.elements += elements;
+
+		done += count;
+		res.length = done;
+		emit progress(done, m_length);
+	}
+
+	res.crc32 = crc;
+	res.xxh64 = xxh64.digest();
+	res.sha256 = sha256.result();
+	if(ints.any)
+	{
+		res.min = (qlonglong)ints.min;
+		res.max = (qlonglong)ints.max;
+		res.sum = ints.sum;
+	}
+	else if(uints.any)
+	{
+		res.min = (qulonglong)uints.min;
+		res.max = (qulonglong)uints.max;
+		res.sum = uints.sum;
+	}
+	else if(floats.any)
+	{
+		res.min = floats.min;
+		res.max = floats.max;
+		res.sum = floats.sum;
+	}
+
+	{
+		QMutexLocker lock(&m_resultMtx);
+		m_result = res;
+	}
+	emit finished(ok);
+
+	taskFinished();
+}
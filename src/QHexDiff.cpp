@@ -0,0 +1,328 @@
+#include "../include/QHexDiff.h"
+
+#include <QRunnable>
+#include <QThread>
+
+#include <algorithm>
+#include <cstring>
+
+const std::size_t DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+const std::size_t MIN_CHUNK_SIZE = 4096;
+const std::size_t COMPARE_BLOCK = 4096;
+
+typedef QMap<std::size_t, QVector<QHexDiff::Region> > RegionMap;
+
+
+class QHexDiff::Task: public QRunnable
+{
+	public:
+		Task(QHexDiff *pdiff): m_pdiff(pdiff) {}
+
+		virtual void run()
+		{
+			m_pdiff->run();
+		}
+	private:
+		QHexDiff   *m_pdiff;
+};
+
+
+static bool lessOffset(const QHexDiff::Region &region, std::size_t offset)
+{
+	return region.offset < offset;
+}
+
+static bool endsBefore(const QHexDiff::Region &region, std::size_t offset)
+{
+	return region.offset + region.length <= offset;
+}
+
+static void appendRegion(QVector<QHexDiff::Region> &res, std::size_t offset, std::size_t length)
+{
+	if(!res.isEmpty() && res.last().offset + res.last().length == offset)
+	{
+		res.last().length += length;
+		return;
+	}
+
+	QHexDiff::Region region = {offset, length};
+	res.append(region);
+}
+
+
+QHexDiff::QHexDiff(const QHexView::DataStoragePtr &pFirst, const QHexView::DataStoragePtr &pSecond, QObject *parent):
+QHexJob(pFirst, parent),
+m_psecond(pSecond),
+m_chunkSize(DEFAULT_CHUNK_SIZE),
+m_threads(std::max(QThread::idealThreadCount(), 1)),
+m_common(0),
+m_size(0),
+m_chunks(0)
+{
+	m_pool.setMaxThreadCount(m_threads);
+	m_stats.compared = m_stats.different = m_stats.regions = 0;
+}
+
+QHexDiff::~QHexDiff()
+{
+	cancel();
+	wait();
+}
+
+void QHexDiff::releaseData()
+{
+	QHexJob::releaseData();
+	m_psecond.clear();
+}
+
+void QHexDiff::setChunkSize(std::size_t size)
+{
+	m_chunkSize = std::max(size, MIN_CHUNK_SIZE);
+}
+
+void QHexDiff::setThreadCount(int threads)
+{
+	m_threads = std::max(threads, 1);
+	m_pool.setMaxThreadCount(m_threads);
+}
+
+void QHexDiff::start()
+{
+	cancel();
+	wait();
+
+	{
+		QMutexLocker lock(&m_resultsMtx);
+		m_results.clear();
+		m_stats.compared = m_stats.different = m_stats.regions = 0;
+	}
+
+	std::size_t firstSize = dataSize();
+	std::size_t secondSize = dataSize(m_psecond);
+	m_common = std::min(firstSize, secondSize);
+	m_size = std::max(firstSize, secondSize);
+	m_chunks = (m_size + m_chunkSize - 1) / m_chunkSize;
+	m_nextChunk.storeRelease(0);
+	resetCanceled();
+
+	if(!m_chunks)
+	{
+		emit finished(true);
+		return;
+	}
+
+	int workers = std::min<std::size_t>(m_threads, m_chunks);
+	m_workers.storeRelease(workers);
+	for(int i = 0; i < workers; i++)
+	{
+		taskStarted();
+		m_pool.start(new Task(this));
+	}
+}
+
+void QHexDiff::run()
+{
+	QByteArray first(m_chunkSize, Qt::Uninitialized);
+	QByteArray second(m_chunkSize, Qt::Uninitialized);
+
+	while(!isCanceled())
+	{
+		std::size_t chunk = m_nextChunk.fetchAndAddOrdered(1);
+		if(chunk >= m_chunks)
+			break;
+
+		std::size_t position = chunk * m_chunkSize;
+		std::size_t length = std::min(m_chunkSize, m_size - position);
+		std::size_t common = position < m_common ? std::min(length, m_common - position) : 0;
+
+		// Each storage is locked for its own read only
+		QVector<Region> found;
+		if(common)
+		{
+			std::size_t firstRead = readData(position, common, first.data());
+			std::size_t secondRead = readData(m_psecond, position, common, second.data());
+			common = std::min(firstRead, secondRead);
+			compare(first.constData(), second.constData(), common, position, found);
+		}
+		if(common < length)
+			appendRegion(found, position + common, length - common);
+
+		quint64 different = 0;
+		for(int i = 0; i < found.size(); i++)
+			different += found[i].length;
+
+		Stats stats;
+		{
+			QMutexLocker lock(&m_resultsMtx);
+
+			// Regions running across a chunk boundary count once, whichever chunk comes second
+			int regions = found.size();
+			if(!found.isEmpty())
+			{
+				RegionMap::const_iterator prev = m_results.constFind(chunk - 1);
+				if(chunk && prev != m_results.constEnd() && found.first().offset == position &&
+					prev.value().last().offset + prev.value().last().length == position)
+					regions--;
+
+				RegionMap::const_iterator next = m_results.constFind(chunk + 1);
+				if(next != m_results.constEnd() && found.last().offset + found.last().length == position + length &&
+					next.value().first().offset == position + length)
+					regions--;
+
+				m_results.insert(chunk, found);
+			}
+
+			m_stats.compared += length;
+			m_stats.different += different;
+			m_stats.regions += regions;
+			stats = m_stats;
+		}
+
+		if(!found.isEmpty())
+			emit regionsFound(stats.regions);
+		emit progress(stats.compared, m_size);
+	}
+
+	if(m_workers.fetchAndAddOrdered(-1) == 1)
+		emit finished(!isCanceled());
+
+	taskFinished();
+}
+
+void QHexDiff::compare(const char *pfirst, const char *psecond, std::size_t length, std::size_t offset, QVector<Region> &res)
+{
+	// Equal blocks are skipped with memcmp, which common C libraries vectorize;
+	// differing ones are scanned a word at a time for the exact runs
+	for(std::size_t block = 0; block < length; block += COMPARE_BLOCK)
+	{
+		std::size_t blockEnd = std::min(block + COMPARE_BLOCK, length);
+		if(!memcmp(pfirst + block, psecond + block, blockEnd - block))
+			continue;
+
+		for(std::size_t i = block; i < blockEnd; )
+		{
+			if(i + sizeof(quint64) <= blockEnd)
+			{
+				quint64 firstWord;
+				quint64 secondWord;
+				memcpy(&firstWord, pfirst + i, sizeof(quint64));
+				memcpy(&secondWord, psecond + i, sizeof(quint64));
+				if(firstWord == secondWord)
+				{
+					i += sizeof(quint64);
+					continue;
+				}
+			}
+
+			if(pfirst[i] == psecond[i])
+			{
+				i++;
+				continue;
+			}
+
+			std::size_t start = i;
+			while(i < blockEnd && pfirst[i] != psecond[i])
+				i++;
+			appendRegion(res, offset + start, i - start);
+		}
+	}
+}
+
+QHexDiff::Stats QHexDiff::stats()
+{
+	QMutexLocker lock(&m_resultsMtx);
+	return m_stats;
+}
+
+static bool isContinuation(const RegionMap &results, RegionMap::const_iterator it, int idx, std::size_t chunkSize)
+{
+	// The first region of a chunk continues one ending right at the chunk start
+	if(idx || it == results.constBegin() || it.value()[0].offset != it.key() * chunkSize)
+		return false;
+
+	RegionMap::const_iterator prev = it;
+	--prev;
+	const QHexDiff::Region &last = prev.value().last();
+	return prev.key() + 1 == it.key() && last.offset + last.length == it.value()[0].offset;
+}
+
+QHexDiff::Region QHexDiff::join(RegionMap::const_iterator it, int idx)
+{
+	Region region = it.value()[idx];
+	while(idx == it.value().size() - 1 && region.offset + region.length == (it.key() + 1) * m_chunkSize)
+	{
+		RegionMap::const_iterator next = it;
+		++next;
+		if(next == m_results.constEnd() || next.key() != it.key() + 1 || next.value()[0].offset != region.offset + region.length)
+			break;
+
+		region.length += next.value()[0].length;
+		it = next;
+		idx = 0;
+	}
+	return region;
+}
+
+bool QHexDiff::next(std::size_t offset, Region &region)
+{
+	QMutexLocker lock(&m_resultsMtx);
+
+	for(RegionMap::const_iterator it = m_results.lowerBound(offset / m_chunkSize); it != m_results.constEnd(); ++it)
+	{
+		const QVector<Region> &regions = it.value();
+		int idx = std::lower_bound(regions.constBegin(), regions.constEnd(), offset, lessOffset) - regions.constBegin();
+		for(; idx < regions.size(); idx++)
+		{
+			if(!isContinuation(m_results, it, idx, m_chunkSize))
+			{
+				region = join(it, idx);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool QHexDiff::previous(std::size_t offset, Region &region)
+{
+	QMutexLocker lock(&m_resultsMtx);
+
+	RegionMap::const_iterator it = m_results.upperBound(offset / m_chunkSize);
+	while(it != m_results.constBegin())
+	{
+		--it;
+		const QVector<Region> &regions = it.value();
+		int idx = std::lower_bound(regions.constBegin(), regions.constEnd(), offset, lessOffset) - regions.constBegin() - 1;
+		for(; idx >= 0; idx--)
+		{
+			if(!isContinuation(m_results, it, idx, m_chunkSize))
+			{
+				region = join(it, idx);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+QVector<QHexDiff::Region> QHexDiff::regions(std::size_t begin, std::size_t end)
+{
+	QVector<Region> res;
+	QMutexLocker lock(&m_resultsMtx);
+
+	// Stored regions never cross chunk boundaries, one chunk back covers those reaching into the range
+	std::size_t firstChunk = begin / m_chunkSize;
+	RegionMap::const_iterator it = m_results.lowerBound(firstChunk ? firstChunk - 1 : 0);
+	for(; it != m_results.constEnd() && it.key() * m_chunkSize < end; ++it)
+	{
+		// Regions do not overlap, so their ends are sorted as well
+		const QVector<Region> &regions = it.value();
+		QVector<Region>::const_iterator found = std::lower_bound(regions.constBegin(), regions.constEnd(), begin, endsBefore);
+		for(; found != regions.constEnd() && found->offset < end; ++found)
+			res.append(*found);
+	}
+
+	return res;
+}
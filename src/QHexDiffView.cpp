@@ -0,0 +1,85 @@
+#include "../include/QHexDiffView.h"
+
+#include <QHBoxLayout>
+
+
+QHexDiffView::QHexDiffView(QWidget *parent):
+QWidget(parent),
+m_pfirst(new QHexView),
+m_psecond(new QHexView)
+{
+	QHBoxLayout *playout = new QHBoxLayout(this);
+	playout->setContentsMargins(0, 0, 0, 0);
+	playout->addWidget(m_pfirst, 1);
+	playout->addWidget(m_psecond, 1);
+
+	// Called right away, the lines only match while both show as many bytes per line
+	connect(m_pfirst, SIGNAL(firstLineChanged(qulonglong)), m_psecond, SLOT(setFirstVisibleLine(qulonglong)), Qt::DirectConnection);
+	connect(m_psecond, SIGNAL(firstLineChanged(qulonglong)), m_pfirst, SLOT(setFirstVisibleLine(qulonglong)), Qt::DirectConnection);
+}
+
+QHexView *QHexDiffView::first()
+{
+	return m_pfirst;
+}
+
+QHexView *QHexDiffView::second()
+{
+	return m_psecond;
+}
+
+QHexDiff *QHexDiffView::diff()
+{
+	return m_pdiff;
+}
+
+void QHexDiffView::setData(QHexView::DataStorage *pFirst, QHexView::DataStorage *pSecond)
+{
+	if(m_pdiff)
+		delete m_pdiff;
+
+	m_pfirst->setData(pFirst);
+	m_psecond->setData(pSecond);
+
+	m_pdiff = m_pfirst->createDiff(m_psecond);
+	m_pfirst->setDiff(m_pdiff);
+	m_psecond->setDiff(m_pdiff);
+	m_pdiff->start();
+}
+
+bool QHexDiffView::nextDifference()
+{
+	if(!m_pdiff)
+		return false;
+
+	// Searching goes on after the difference shown last
+	std::size_t from = m_pfirst->selectionLength() ? m_pfirst->selectionOffset() + 1 : m_pfirst->selectionOffset();
+	QHexDiff::Region region;
+	if(!m_pdiff->next(from, region))
+		return false;
+
+	showRegion(region);
+	return true;
+}
+
+bool QHexDiffView::previousDifference()
+{
+	if(!m_pdiff)
+		return false;
+
+	QHexDiff::Region region;
+	if(!m_pdiff->previous(m_pfirst->selectionOffset(), region))
+		return false;
+
+	showRegion(region);
+	return true;
+}
+
+void QHexDiffView::showRegion(const QHexDiff::Region &region)
+{
+	// A difference past the end of the shorter data is shown by the other view, scrolling follows
+	m_pfirst->showFromOffset(region.offset);
+	m_psecond->showFromOffset(region.offset);
+	m_pfirst->setSelected(region.offset, region.length);
+	m_psecond->setSelected(region.offset, region.length);
+}
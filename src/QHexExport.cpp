@@ -0,0 +1,262 @@
+#include "../include/QHexExport.h"
+#include "../include/QHexFormatter.h"
+
+#include <QThreadPool>
+#include <QRunnable>
+
+#include <algorithm>
+
+const std::size_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+const std::size_t DEFAULT_BYTES_PER_LINE = 16;
+const std::size_t CARRAY_BYTES_PER_LINE = 12;
+const std::size_t BASE64_BYTES_PER_LINE = 57; // 76 characters
+
+
+class QHexExport::Task: public QRunnable
+{
+	public:
+		Task(QHexExport *pexport): m_pexport(pexport) {}
+
+		virtual void run()
+		{
+			m_pexport->run();
+		}
+	private:
+		QHexExport   *m_pexport;
+};
+
+
+static void appendAddress(QByteArray &out, std::size_t address)
+{
+	char hex[2 * sizeof(quint64)];
+	quint64 value = address;
+	for(int i = sizeof(hex) - 1; i >= 0; i--, value >>= 4)
+		hex[i] = "0123456789abcdef"[value & 0xF];
+
+	// At least 10 digits, as in the address column of QHexView
+	int skip = 0;
+	while(skip < (int)sizeof(hex) - 10 && hex[skip] == '0')
+		skip++;
+	out.append(hex + skip, sizeof(hex) - skip);
+}
+
+
+QHexExport::QHexExport(const QHexView::DataStoragePtr &pData, QObject *parent):
+QHexJob(pData, parent),
+m_chunkSize(DEFAULT_CHUNK_SIZE),
+m_bytesPerLine(DEFAULT_BYTES_PER_LINE),
+m_pdevice(NULL),
+m_offset(0),
+m_length(0),
+m_format(Raw)
+{
+}
+
+QHexExport::~QHexExport()
+{
+	cancel();
+	wait();
+}
+
+void QHexExport::setChunkSize(std::size_t size)
+{
+	m_chunkSize = std::max<std::size_t>(size, 1);
+}
+
+void QHexExport::setBytesPerLine(std::size_t bytesPerLine)
+{
+	m_bytesPerLine = std::max<std::size_t>(bytesPerLine, 1);
+}
+
+void QHexExport::start(QIODevice *pdevice, std::size_t offset, std::size_t length, Format format)
+{
+	wait();
+
+	m_pdevice = pdevice;
+	m_offset = offset;
+	m_length = length;
+	m_format = format;
+	resetCanceled();
+
+	taskStarted();
+	QThreadPool::globalInstance()->start(new Task(this));
+}
+
+void QHexExport::run()
+{
+	bool ok = exportRange(m_pdevice, m_offset, m_length, m_format);
+	emit finished(ok);
+
+	taskFinished();
+}
+
+QString QHexExport::errorString() const
+{
+	return m_error;
+}
+
+std::size_t QHexExport::unitSize(Format format) const
+{
+	switch(format)
+	{
+		case Hex:
+		case HexDump:
+			return m_bytesPerLine;
+		case CArray:
+			return CARRAY_BYTES_PER_LINE;
+		case Base64:
+			return BASE64_BYTES_PER_LINE;
+		default:
+			return 1;
+	}
+}
+
+void QHexExport::formatChunk(const char *pdata, std::size_t length, std::size_t done, std::size_t total, std::size_t address, Format format, QByteArray &out)
+{
+	switch(format)
+	{
+		case Hex:
+		{
+			// Chunks hold whole lines, so every line can be formatted in one go
+			for(std::size_t pos = 0; pos < length; pos += m_bytesPerLine)
+			{
+				std::size_t count = std::min(m_bytesPerLine, length - pos);
+				std::size_t at = out.size();
+				out.resize(at + 3 * count);
+				QHexFormatter::toHexSpaced(pdata + pos, count, out.data() + at);
+				if(count == m_bytesPerLine)
+					out += '\n';
+			}
+			break;
+		}
+		case HexDump:
+		{
+			for(std::size_t pos = 0; pos < length; pos += m_bytesPerLine)
+			{
+				std::size_t count = std::min(m_bytesPerLine, length - pos);
+				appendAddress(out, address + pos);
+				out += "  ";
+
+				std::size_t at = out.size();
+				out.resize(at + 3 * m_bytesPerLine + count);
+				char *pline = out.data() + at;
+				QHexFormatter::toHexSpaced(pdata + pos, count, pline);
+				std::fill(pline + 3 * count, pline + 3 * m_bytesPerLine, ' ');
+				QHexFormatter::toAscii(pdata + pos, count, pline + 3 * m_bytesPerLine);
+				out += '\n';
+			}
+			break;
+		}
+		case CArray:
+		{
+			char hex[2 * CARRAY_BYTES_PER_LINE];
+			for(std::size_t pos = 0; pos < length; pos += CARRAY_BYTES_PER_LINE)
+			{
+				std::size_t count = std::min(CARRAY_BYTES_PER_LINE, length - pos);
+				QHexFormatter::toHex(pdata + pos, count, hex);
+
+				out += '\t';
+				for(std::size_t i = 0; i < count; i++)
+				{
+					out += "0x";
+					out.append(hex + 2 * i, 2);
+					if(done + pos + i + 1 < total)
+						out += (i + 1 < count) ? ", " : ",";
+				}
+				out += '\n';
+			}
+			break;
+		}
+		case Base64:
+		{
+			QByteArray encoded = QByteArray::fromRawData(pdata, length).toBase64();
+			for(int pos = 0; pos < encoded.size(); pos += 76)
+			{
+				out.append(encoded.constData() + pos, std::min(76, encoded.size() - pos));
+				out += '\n';
+			}
+			break;
+		}
+		default:
+			out.append(pdata, length);
+			break;
+	}
+}
+
+bool QHexExport::exportTo(QIODevice *pdevice, std::size_t offset, std::size_t length, Format format)
+{
+	resetCanceled();
+	return exportRange(pdevice, offset, length, format);
+}
+
+bool QHexExport::exportRange(QIODevice *pdevice, std::size_t offset, std::size_t length, Format format)
+{
+	m_error.clear();
+
+	if(!pdevice || !pdevice->isWritable())
+	{
+		m_error = "Output device is not writable";
+		return false;
+	}
+
+	// Chunks hold whole output lines, so line breaks never depend on chunk boundaries
+	std::size_t unit = unitSize(format);
+	std::size_t chunkSize = std::max(unit, m_chunkSize / unit * unit);
+
+	QByteArray buffer(chunkSize, Qt::Uninitialized);
+	QByteArray out;
+	if(format != Raw)
+		out.reserve(chunkSize * 6 + 64);
+
+	if(format == CArray)
+	{
+		QByteArray header = "const unsigned char data[" + QByteArray::number((qulonglong)length) + "] = {\n";
+		if(pdevice->write(header) != header.size())
+		{
+			m_error = pdevice->errorString();
+			return false;
+		}
+	}
+
+	for(std::size_t done = 0; done < length; )
+	{
+		if(isCanceled())
+		{
+			m_error = "Export canceled";
+			return false;
+		}
+
+		std::size_t count = std::min(chunkSize, length - done);
+		if(readData(offset + done, count, buffer.data()) != count)
+		{
+			m_error = "Failed to read data at offset " + QString::number((qulonglong)(offset + done));
+			return false;
+		}
+
+		const char *pwrite = buffer.constData();
+		qint64 writeSize = count;
+		if(format != Raw)
+		{
+			out.resize(0);
+			formatChunk(buffer.constData(), count, done, length, offset + done, format, out);
+			pwrite = out.constData();
+			writeSize = out.size();
+		}
+
+		if(pdevice->write(pwrite, writeSize) != writeSize)
+		{
+			m_error = pdevice->errorString();
+			return false;
+		}
+
+		done += count;
+		emit progress(done, length);
+	}
+
+	if(format == Hex && length % m_bytesPerLine)
+		pdevice->write("\n");
+	if(format == CArray)
+		pdevice->write("};\n");
+
+	return true;
+}
@@ -0,0 +1,216 @@
+#include "../include/QHexFormatter.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define Q_HEX_FORMATTER_X86
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define Q_HEX_FORMATTER_X86
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+typedef void (*FormatFunc)(const char *src, std::size_t length, char *dst);
+
+
+void QHexFormatter::toHexScalar(const char *src, std::size_t length, char *dst)
+{
+	for(std::size_t i = 0; i < length; i++)
+	{
+		unsigned char ch = src[i];
+		dst[2 * i] = HEX_DIGITS[ch >> 4];
+		dst[2 * i + 1] = HEX_DIGITS[ch & 0xF];
+	}
+}
+
+void QHexFormatter::toAsciiScalar(const char *src, std::size_t length, char *dst)
+{
+	for(std::size_t i = 0; i < length; i++)
+	{
+		unsigned char ch = src[i];
+		dst[i] = ((ch < 0x20) || (ch > 0x7e)) ? '.' : ch;
+	}
+}
+
+
+#ifdef Q_HEX_FORMATTER_X86
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+// Nibbles 0..15 become '0'..'9', 'a'..'f': add '0', and 'a' - '0' - 10 more above 9
+TARGET_SSE2 static inline __m128i nibblesToHex128(__m128i nibbles)
+{
+	__m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+	return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+TARGET_SSE2 static void toHexSSE2(const char *src, std::size_t length, char *dst)
+{
+	std::size_t i = 0;
+	for(; i + 16 <= length; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i hi = nibblesToHex128(_mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0F)));
+		__m128i lo = nibblesToHex128(_mm_and_si128(bytes, _mm_set1_epi8(0x0F)));
+		_mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+
+	QHexFormatter::toHexScalar(src + i, length - i, dst + 2 * i);
+}
+
+TARGET_SSE2 static void toAsciiSSE2(const char *src, std::size_t length, char *dst)
+{
+	std::size_t i = 0;
+	for(; i + 16 <= length; i += 16)
+	{
+		// Signed compare: bytes from 0x80 up are negative and fall out of the printable range
+		__m128i bytes = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i printable = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7f)));
+		__m128i res = _mm_or_si128(_mm_and_si128(printable, bytes), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+		_mm_storeu_si128((__m128i *)(dst + i), res);
+	}
+
+	QHexFormatter::toAsciiScalar(src + i, length - i, dst + i);
+}
+
+TARGET_AVX2 static inline __m256i nibblesToHex256(__m256i nibbles)
+{
+	__m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9)), _mm256_set1_epi8('a' - '0' - 10));
+	return _mm256_add_epi8(_mm256_add_epi8(nibbles, _mm256_set1_epi8('0')), letters);
+}
+
+TARGET_AVX2 static void toHexAVX2(const char *src, std::size_t length, char *dst)
+{
+	std::size_t i = 0;
+	for(; i + 32 <= length; i += 32)
+	{
+		__m256i bytes = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i hi = nibblesToHex256(_mm256_and_si256(_mm256_srli_epi16(bytes, 4), _mm256_set1_epi8(0x0F)));
+		__m256i lo = nibblesToHex256(_mm256_and_si256(bytes, _mm256_set1_epi8(0x0F)));
+
+		// Unpacking works per 128-bit lane, the lane halves are put back in order afterwards
+		__m256i unpackLo = _mm256_unpacklo_epi8(hi, lo);
+		__m256i unpackHi = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(unpackLo, unpackHi, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst + 2 * i + 32), _mm256_permute2x128_si256(unpackLo, unpackHi, 0x31));
+	}
+
+	toHexSSE2(src + i, length - i, dst + 2 * i);
+}
+
+TARGET_AVX2 static void toAsciiAVX2(const char *src, std::size_t length, char *dst)
+{
+	std::size_t i = 0;
+	for(; i + 32 <= length; i += 32)
+	{
+		__m256i bytes = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i printable = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(0x1f)), _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7f), bytes));
+		__m256i res = _mm256_or_si256(_mm256_and_si256(printable, bytes), _mm256_andnot_si256(printable, _mm256_set1_epi8('.')));
+		_mm256_storeu_si256((__m256i *)(dst + i), res);
+	}
+
+	toAsciiSSE2(src + i, length - i, dst + i);
+}
+
+static bool cpuHasAVX2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	// AVX state has to be enabled by the OS (OSXSAVE + XCR0)
+	if(!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+#endif
+
+
+struct FormatImpl
+{
+	FormatFunc    toHex;
+	FormatFunc    toAscii;
+	const char   *name;
+};
+
+static FormatImpl makeImpl(FormatFunc toHex, FormatFunc toAscii, const char *name)
+{
+	FormatImpl impl = {toHex, toAscii, name};
+	return impl;
+}
+
+static FormatImpl selectImpl()
+{
+#ifdef Q_HEX_FORMATTER_X86
+	if(cpuHasAVX2())
+		return makeImpl(toHexAVX2, toAsciiAVX2, "avx2");
+
+	// SSE2 is part of every x86-64 CPU, 32-bit builds check for it
+#if defined(__x86_64__) || defined(_M_X64)
+	return makeImpl(toHexSSE2, toAsciiSSE2, "sse2");
+#elif defined(__GNUC__) || defined(__clang__)
+	if(__builtin_cpu_supports("sse2"))
+		return makeImpl(toHexSSE2, toAsciiSSE2, "sse2");
+#endif
+#endif
+
+	return makeImpl(QHexFormatter::toHexScalar, QHexFormatter::toAsciiScalar, "scalar");
+}
+
+static const FormatImpl &impl()
+{
+	static const FormatImpl selected = selectImpl();
+	return selected;
+}
+
+
+void QHexFormatter::toHex(const char *src, std::size_t length, char *dst)
+{
+	impl().toHex(src, length, dst);
+}
+
+void QHexFormatter::toHexSpaced(const char *src, std::size_t length, char *dst)
+{
+	// Hex digits are produced in blocks on the stack, then spread out with separators
+	char hex[512];
+	const std::size_t block = sizeof(hex) / 2;
+
+	for(std::size_t pos = 0; pos < length; pos += block)
+	{
+		std::size_t count = length - pos < block ? length - pos : block;
+		toHex(src + pos, count, hex);
+		for(std::size_t i = 0; i < count; i++)
+		{
+			char *out = dst + 3 * (pos + i);
+			out[0] = hex[2 * i];
+			out[1] = hex[2 * i + 1];
+			out[2] = ' ';
+		}
+	}
+}
+
+void QHexFormatter::toAscii(const char *src, std::size_t length, char *dst)
+{
+	impl().toAscii(src, length, dst);
+}
+
+const char *QHexFormatter::implementation()
+{
+	return impl().name;
+}
@@ -0,0 +1,245 @@
+#include "../include/QHexHighlights.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Subtrees of up to 2^(SCAN_DEPTH + 1) ranges are scanned linearly
+const int SCAN_DEPTH = 3;
+
+
+struct StateRecord
+{
+	qint32    layer;
+	quint32   color;
+	quint64   begin;
+	quint64   end;
+};
+
+
+static bool beginLess(const QHexHighlights::Range &left, const QHexHighlights::Range &right)
+{
+	return left.begin < right.begin;
+}
+
+
+QHexHighlights::QHexHighlights():
+m_count(0)
+{
+}
+
+void QHexHighlights::add(std::size_t begin, std::size_t end, const QColor &color, int layer)
+{
+	if(begin >= end)
+		return;
+
+	Layer &target = m_layers[layer];
+	Range range = {begin, end, color.rgba()};
+	if(!target.ranges.isEmpty() && range.begin < target.ranges.last().begin)
+		target.sorted = false;
+	target.ranges.append(range);
+	target.depth = -1;
+	m_count++;
+}
+
+void QHexHighlights::remove(std::size_t begin, std::size_t end, int layer)
+{
+	QMap<int, Layer>::iterator it = m_layers.find(layer);
+	if(it == m_layers.end())
+		return;
+
+	QVector<Range> &ranges = it->ranges;
+	int kept = 0;
+	for(int i = 0; i < ranges.size(); i++)
+	{
+		if(ranges[i].begin < end && ranges[i].end > begin)
+			continue;
+		ranges[kept++] = ranges[i];
+	}
+
+	m_count -= ranges.size() - kept;
+	ranges.resize(kept);
+	it->depth = -1;
+
+	if(ranges.isEmpty())
+		m_layers.erase(it);
+}
+
+void QHexHighlights::clear(int layer)
+{
+	QMap<int, Layer>::iterator it = m_layers.find(layer);
+	if(it == m_layers.end())
+		return;
+
+	m_count -= it->ranges.size();
+	m_layers.erase(it);
+}
+
+void QHexHighlights::clear()
+{
+	m_layers.clear();
+	m_count = 0;
+}
+
+bool QHexHighlights::isEmpty() const
+{
+	return m_count == 0;
+}
+
+std::size_t QHexHighlights::count() const
+{
+	return m_count;
+}
+
+QList<int> QHexHighlights::layers() const
+{
+	return m_layers.keys();
+}
+
+void QHexHighlights::build(Layer &layer)
+{
+	if(!layer.sorted)
+		std::stable_sort(layer.ranges.begin(), layer.ranges.end(), beginLess);
+	layer.sorted = true;
+
+	const QVector<Range> &ranges = layer.ranges;
+	QVector<quint64> &maxEnd = layer.maxEnd;
+	std::size_t size = ranges.size();
+	maxEnd.resize(size);
+
+	if(!size)
+	{
+		layer.depth = 0;
+		return;
+	}
+
+	// Leaves are the even indices, nodes of level k have k trailing one bits.
+	// lastEnd carries the maximum of the rightmost, incomplete subtree.
+	std::size_t lastIdx = 0;
+	quint64 lastEnd = 0;
+	for(std::size_t i = 0; i < size; i += 2)
+	{
+		lastIdx = i;
+		lastEnd = maxEnd[i] = ranges[i].end;
+	}
+
+	int level = 1;
+	for(; ((std::size_t)1 << level) <= size; level++)
+	{
+		std::size_t half = (std::size_t)1 << (level - 1);
+		for(std::size_t i = 2 * half - 1; i < size; i += 4 * half)
+		{
+			quint64 leftEnd = maxEnd[i - half];
+			quint64 rightEnd = i + half < size ? maxEnd[i + half] : lastEnd;
+			maxEnd[i] = std::max(ranges[i].end, std::max(leftEnd, rightEnd));
+		}
+
+		lastIdx = ((lastIdx >> level) & 1) ? lastIdx - half : lastIdx + half;
+		if(lastIdx < size && maxEnd[lastIdx] > lastEnd)
+			lastEnd = maxEnd[lastIdx];
+	}
+
+	layer.depth = level - 1;
+}
+
+void QHexHighlights::overlapping(int layer, std::size_t begin, std::size_t end, QVector<Range> &res)
+{
+	QMap<int, Layer>::iterator it = m_layers.find(layer);
+	if(it == m_layers.end())
+		return;
+
+	if(it->depth < 0)
+		build(*it);
+
+	const QVector<Range> &ranges = it->ranges;
+	const QVector<quint64> &maxEnd = it->maxEnd;
+	std::size_t size = ranges.size();
+	if(!size)
+		return;
+
+	struct Node
+	{
+		int           level;
+		std::size_t   idx;
+		bool          leftDone;
+	};
+
+	// Depth-first walk in start order: left subtrees are skipped when they end before
+	// the window, right subtrees when their node starts after it
+	Node stack[64];
+	int top = 0;
+	Node root = {it->depth, ((std::size_t)1 << it->depth) - 1, false};
+	stack[top++] = root;
+
+	while(top)
+	{
+		Node node = stack[--top];
+		if(node.level <= SCAN_DEPTH)
+		{
+			std::size_t first = node.idx >> node.level << node.level;
+			std::size_t last = std::min(first + ((std::size_t)1 << (node.level + 1)) - 1, size);
+			for(std::size_t i = first; i < last && ranges[i].begin < end; i++)
+			{
+				if(ranges[i].end > begin)
+					res.append(ranges[i]);
+			}
+		}
+		else if(!node.leftDone)
+		{
+			std::size_t left = node.idx - ((std::size_t)1 << (node.level - 1));
+			Node self = {node.level, node.idx, true};
+			stack[top++] = self;
+			if(left >= size || maxEnd[left] > begin)
+			{
+				Node child = {node.level - 1, left, false};
+				stack[top++] = child;
+			}
+		}
+		else if(node.idx < size && ranges[node.idx].begin < end)
+		{
+			if(ranges[node.idx].end > begin)
+				res.append(ranges[node.idx]);
+
+			Node child = {node.level - 1, node.idx + ((std::size_t)1 << (node.level - 1)), false};
+			stack[top++] = child;
+		}
+	}
+}
+
+QByteArray QHexHighlights::saveState() const
+{
+	QByteArray res;
+	res.reserve(m_count * sizeof(StateRecord));
+
+	for(QMap<int, Layer>::const_iterator it = m_layers.constBegin(); it != m_layers.constEnd(); ++it)
+	{
+		for(int i = 0; i < it->ranges.size(); i++)
+		{
+			StateRecord record = {it.key(), it->ranges[i].color, it->ranges[i].begin, it->ranges[i].end};
+			res.append((const char *)&record, sizeof(record));
+		}
+	}
+
+	return res;
+}
+
+bool QHexHighlights::restoreState(const QByteArray &state)
+{
+	if(state.size() % sizeof(StateRecord))
+		return false;
+
+	// The saved layers replace the current ones, restoring twice adds nothing
+	StateRecord record;
+	for(int offset = 0; offset < state.size(); offset += sizeof(StateRecord))
+	{
+		memcpy(&record, state.constData() + offset, sizeof(record));
+		clear(record.layer);
+	}
+
+	for(int offset = 0; offset < state.size(); offset += sizeof(StateRecord))
+	{
+		memcpy(&record, state.constData() + offset, sizeof(record));
+		add(record.begin, record.end, QColor::fromRgba(record.color), record.layer);
+	}
+
+	return true;
+}
@@ -0,0 +1,389 @@
+#include "../include/QHexInspector.h"
+
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QLabel>
+#include <QBoxLayout>
+#include <QTimer>
+#include <QDateTime>
+#include <QUuid>
+#include <QtEndian>
+
+#include <cstring>
+
+// Selections are aggregated once they have stayed put this long
+const int SELECTION_DELAY = 200;
+// Enough for the widest value decoded at the cursor, a GUID
+const int CURSOR_BYTES = 16;
+// Between 1601-01-01, where FILETIME counts from, and 1970-01-01
+const qint64 FILETIME_EPOCH_MSECS = Q_INT64_C(11644473600000);
+
+enum CursorRow
+{
+	RowInt8, RowUInt8, RowBits,
+	RowInt16, RowUInt16, RowInt32, RowUInt32, RowInt64, RowUInt64,
+	RowFloat, RowDouble,
+	RowUtf8, RowUtf16,
+	RowUnixTime32, RowUnixTime64, RowFileTime, RowDosTime,
+	RowGuid
+};
+
+static const char *CURSOR_ROWS[] =
+{
+	"int8", "uint8", "bits",
+	"int16", "uint16", "int32", "uint32", "int64", "uint64",
+	"float", "double",
+	"UTF-8", "UTF-16",
+	"Unix time (32 bit)", "Unix time (64 bit)", "FILETIME", "DOS date/time",
+	"GUID"
+};
+
+enum SelectionRow
+{
+	RowLength, RowElements, RowMin, RowMax, RowSum, RowMean,
+	RowCrc32, RowXxh64, RowSha256
+};
+
+static const char *SELECTION_ROWS[] =
+{
+	"Length", "Elements", "Minimum", "Maximum", "Sum", "Mean",
+	"CRC32", "xxHash64", "SHA-256"
+};
+
+// In the order of QHexAggregate::ElementType
+static const char *ELEMENT_TYPES[] =
+{
+	"int8", "uint8", "int16", "uint16", "int32", "uint32", "int64", "uint64", "float", "double"
+};
+
+
+template<typename T>
+static bool load(const QByteArray &data, bool bigEndian, T &value)
+{
+	if(data.size() < (int)sizeof(T))
+		return false;
+
+	const uchar *pdata = (const uchar *)data.constData();
+	value = bigEndian ? qFromBigEndian<T>(pdata) : qFromLittleEndian<T>(pdata);
+	return true;
+}
+
+template<typename T>
+static QString integer(const QByteArray &data, bool bigEndian)
+{
+	T value;
+	return load(data, bigEndian, value) ? QString::number(value) : QString("-");
+}
+
+static QString floating(const QByteArray &data, bool bigEndian, bool isDouble)
+{
+	if(isDouble)
+	{
+		quint64 bits;
+		double value;
+		if(!load(data, bigEndian, bits))
+			return "-";
+		memcpy(&value, &bits, sizeof(value));
+		return QString::number(value, 'g', 17);
+	}
+
+	quint32 bits;
+	float value;
+	if(!load(data, bigEndian, bits))
+		return "-";
+	memcpy(&value, &bits, sizeof(value));
+	return QString::number(value, 'g', 9);
+}
+
+static QString character(uint codePoint)
+{
+	QString text = QString::fromUcs4(&codePoint, 1);
+	if(codePoint < 0x20 || codePoint == 0x7f)
+		text.clear();
+	return QString("%1 U+%2").arg(text, QString::number(codePoint, 16).toUpper().rightJustified(4, '0')).trimmed();
+}
+
+static QString utf8(const QByteArray &data)
+{
+	if(data.isEmpty())
+		return "-";
+
+	uchar lead = data[0];
+	int length = lead < 0x80 ? 1 : (lead >> 5) == 0x06 ? 2 : (lead >> 4) == 0x0e ? 3 : (lead >> 3) == 0x1e ? 4 : 0;
+	if(!length || data.size() < length)
+		return "-";
+
+	QVector<uint> codePoints = QString::fromUtf8(data.constData(), length).toUcs4();
+	if(codePoints.size() != 1 || codePoints[0] == QChar::ReplacementCharacter)
+		return "-";
+	return character(codePoints[0]);
+}
+
+static QString utf16(const QByteArray &data, bool bigEndian)
+{
+	quint16 unit;
+	if(!load(data, bigEndian, unit))
+		return "-";
+	if(QChar::isLowSurrogate(unit))
+		return "-";
+	if(!QChar::isHighSurrogate(unit))
+		return character(unit);
+
+	quint16 low;
+	if(!load(data.mid(2), bigEndian, low) || !QChar::isLowSurrogate(low))
+		return "-";
+	return character(QChar::surrogateToUcs4(unit, low));
+}
+
+static QString dateTime(const QDateTime &time)
+{
+	return time.isValid() ? time.toString(Qt::ISODate) : QString("-");
+}
+
+static QString unixTime(const QByteArray &data, bool bigEndian, bool wide)
+{
+	if(wide)
+	{
+		qint64 seconds;
+		if(!load(data, bigEndian, seconds))
+			return "-";
+		// Beyond what QDateTime holds
+		if(seconds > Q_INT64_C(1) << 40 || seconds < -(Q_INT64_C(1) << 40))
+			return "-";
+		return dateTime(QDateTime::fromMSecsSinceEpoch(seconds * 1000, Qt::UTC));
+	}
+
+	quint32 seconds;
+	if(!load(data, bigEndian, seconds))
+		return "-";
+	return dateTime(QDateTime::fromMSecsSinceEpoch((qint64)seconds * 1000, Qt::UTC));
+}
+
+static QString fileTime(const QByteArray &data, bool bigEndian)
+{
+	quint64 ticks;
+	if(!load(data, bigEndian, ticks))
+		return "-";
+	// 100 ns since 1601-01-01
+	return dateTime(QDateTime::fromMSecsSinceEpoch((qint64)(ticks / 10000) - FILETIME_EPOCH_MSECS, Qt::UTC));
+}
+
+static QString dosTime(const QByteArray &data, bool bigEndian)
+{
+	quint32 value;
+	if(!load(data, bigEndian, value))
+		return "-";
+
+	// The time in the low half, the date in the high one
+	uint time = value & 0xffff;
+	uint date = value >> 16;
+	QDate day(1980 + (date >> 9), (date >> 5) & 0x0f, date & 0x1f);
+	QTime clock(time >> 11, (time >> 5) & 0x3f, (time & 0x1f) * 2);
+	if(!day.isValid() || !clock.isValid())
+		return "-";
+	return dateTime(QDateTime(day, clock));
+}
+
+static QString guid(const QByteArray &data, bool bigEndian)
+{
+	if(data.size() < 16)
+		return "-";
+	if(bigEndian)
+		return QUuid::fromRfc4122(data.left(16)).toString();
+
+	// Microsoft layout: the first three groups are little endian
+	const uchar *pdata = (const uchar *)data.constData();
+	return QUuid(qFromLittleEndian<quint32>(pdata), qFromLittleEndian<quint16>(pdata + 4), qFromLittleEndian<quint16>(pdata + 6),
+		pdata[8], pdata[9], pdata[10], pdata[11], pdata[12], pdata[13], pdata[14], pdata[15]).toString();
+}
+
+
+QHexInspector::QHexInspector(QHexView *pview, QWidget *parent):
+QWidget(parent),
+m_pview(pview)
+{
+	m_ptree = new QTreeWidget(this);
+	m_ptree->setColumnCount(3);
+	m_ptree->setHeaderLabels(QStringList() << "Type" << "Little endian" << "Big endian");
+	m_ptree->setUniformRowHeights(true);
+	m_ptree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+	m_pcursorItem = new QTreeWidgetItem(m_ptree, QStringList("At cursor"));
+	for(int i = 0; i < (int)(sizeof(CURSOR_ROWS) / sizeof(CURSOR_ROWS[0])); i++)
+		new QTreeWidgetItem(m_pcursorItem, QStringList(CURSOR_ROWS[i]));
+
+	m_pselectionItem = new QTreeWidgetItem(m_ptree, QStringList("Selection"));
+	for(int i = 0; i < (int)(sizeof(SELECTION_ROWS) / sizeof(SELECTION_ROWS[0])); i++)
+		new QTreeWidgetItem(m_pselectionItem, QStringList(SELECTION_ROWS[i]));
+	m_phistogramItem = new QTreeWidgetItem(m_pselectionItem, QStringList("Histogram"));
+	for(int value = 0; value < 256; value++)
+		new QTreeWidgetItem(m_phistogramItem, QStringList(QString("0x%1").arg(value, 2, 16, QChar('0'))));
+
+	m_pcursorItem->setExpanded(true);
+	m_pselectionItem->setExpanded(true);
+
+	m_ptypeBox = new QComboBox(this);
+	for(int i = 0; i < (int)(sizeof(ELEMENT_TYPES) / sizeof(ELEMENT_TYPES[0])); i++)
+		m_ptypeBox->addItem(ELEMENT_TYPES[i]);
+	m_pbigEndianBox = new QCheckBox("Big endian", this);
+
+	QHBoxLayout *ptypeLayout = new QHBoxLayout;
+	ptypeLayout->addWidget(new QLabel("Selection as", this));
+	ptypeLayout->addWidget(m_ptypeBox);
+	ptypeLayout->addWidget(m_pbigEndianBox);
+	ptypeLayout->addStretch();
+
+	QVBoxLayout *playout = new QVBoxLayout(this);
+	playout->setContentsMargins(0, 0, 0, 0);
+	playout->addWidget(m_ptree);
+	playout->addLayout(ptypeLayout);
+
+	m_pselectionTimer = new QTimer(this);
+	m_pselectionTimer->setSingleShot(true);
+	m_pselectionTimer->setInterval(SELECTION_DELAY);
+	connect(m_pselectionTimer, SIGNAL(timeout()), SLOT(slotAggregate()));
+
+	connect(m_ptypeBox, SIGNAL(currentIndexChanged(int)), SLOT(slotSelectionChanged()));
+	connect(m_pbigEndianBox, SIGNAL(toggled(bool)), SLOT(slotSelectionChanged()));
+	connect(m_pview, SIGNAL(cursorMoved(qulonglong)), SLOT(slotCursorMoved()));
+	connect(m_pview, SIGNAL(selectionChanged(qulonglong, qulonglong)), SLOT(slotSelectionChanged()));
+	connect(m_pview, SIGNAL(dataEdited()), SLOT(slotCursorMoved()));
+	connect(m_pview, SIGNAL(dataEdited()), SLOT(slotSelectionChanged()));
+}
+
+QHexInspector::~QHexInspector()
+{
+	cancelAggregate();
+}
+
+void QHexInspector::showEvent(QShowEvent *event)
+{
+	QWidget::showEvent(event);
+
+	// Changes while hidden were not followed
+	slotCursorMoved();
+	slotSelectionChanged();
+}
+
+void QHexInspector::setRow(QTreeWidgetItem *pparent, int row, const QString &little, const QString &big)
+{
+	QTreeWidgetItem *pitem = pparent->child(row);
+	pitem->setText(1, little);
+	pitem->setText(2, big);
+}
+
+void QHexInspector::slotCursorMoved()
+{
+	if(isVisible())
+		updateCursor();
+}
+
+void QHexInspector::updateCursor()
+{
+	QByteArray data;
+	if(m_pview)
+		data = m_pview->readData(m_pview->cursorOffset(), CURSOR_BYTES);
+
+	m_pcursorItem->setText(1, m_pview ? QString("0x%1").arg(m_pview->cursorOffset(), 0, 16) : QString());
+
+	setRow(m_pcursorItem, RowInt8, integer<qint8>(data, false));
+	setRow(m_pcursorItem, RowUInt8, integer<quint8>(data, false));
+	setRow(m_pcursorItem, RowBits, data.isEmpty() ? QString("-") : QString("%1").arg((uchar)data[0], 8, 2, QChar('0')));
+	setRow(m_pcursorItem, RowInt16, integer<qint16>(data, false), integer<qint16>(data, true));
+	setRow(m_pcursorItem, RowUInt16, integer<quint16>(data, false), integer<quint16>(data, true));
+	setRow(m_pcursorItem, RowInt32, integer<qint32>(data, false), integer<qint32>(data, true));
+	setRow(m_pcursorItem, RowUInt32, integer<quint32>(data, false), integer<quint32>(data, true));
+	setRow(m_pcursorItem, RowInt64, integer<qint64>(data, false), integer<qint64>(data, true));
+	setRow(m_pcursorItem, RowUInt64, integer<quint64>(data, false), integer<quint64>(data, true));
+	setRow(m_pcursorItem, RowFloat, floating(data, false, false), floating(data, true, false));
+	setRow(m_pcursorItem, RowDouble, floating(data, false, true), floating(data, true, true));
+	setRow(m_pcursorItem, RowUtf8, utf8(data));
+	setRow(m_pcursorItem, RowUtf16, utf16(data, false), utf16(data, true));
+	setRow(m_pcursorItem, RowUnixTime32, unixTime(data, false, false), unixTime(data, true, false));
+	setRow(m_pcursorItem, RowUnixTime64, unixTime(data, false, true), unixTime(data, true, true));
+	setRow(m_pcursorItem, RowFileTime, fileTime(data, false), fileTime(data, true));
+	setRow(m_pcursorItem, RowDosTime, dosTime(data, false), dosTime(data, true));
+	setRow(m_pcursorItem, RowGuid, guid(data, false), guid(data, true));
+}
+
+void QHexInspector::cancelAggregate()
+{
+	m_pselectionTimer->stop();
+	if(m_paggregate)
+	{
+		// Waits for the chunk in progress, a few milliseconds at most
+		disconnect(m_paggregate, 0, this, 0);
+		delete m_paggregate;
+	}
+}
+
+void QHexInspector::slotSelectionChanged()
+{
+	if(!isVisible())
+		return;
+
+	cancelAggregate();
+	m_pselectionItem->setText(1, QString());
+	for(int row = 0; row < m_pselectionItem->childCount(); row++)
+		setRow(m_pselectionItem, row, QString());
+	for(int value = 0; value < 256; value++)
+		setRow(m_phistogramItem, value, QString());
+
+	if(m_pview && m_pview->selectionLength())
+		m_pselectionTimer->start();
+}
+
+void QHexInspector::slotAggregate()
+{
+	if(!m_pview || !m_pview->selectionLength())
+		return;
+
+	m_paggregate = m_pview->createAggregate();
+	m_paggregate->setElementType((QHexAggregate::ElementType)m_ptypeBox->currentIndex(), m_pbigEndianBox->isChecked());
+	connect(m_paggregate, SIGNAL(progress(qulonglong, qulonglong)), SLOT(slotAggregateProgress(qulonglong, qulonglong)));
+	connect(m_paggregate, SIGNAL(finished(bool)), SLOT(slotAggregateFinished(bool)));
+	m_paggregate->start(m_pview->selectionOffset(), m_pview->selectionLength());
+}
+
+void QHexInspector::slotAggregateProgress(qulonglong done, qulonglong total)
+{
+	if(sender() == m_paggregate.data() && total)
+		m_pselectionItem->setText(1, QString("%1%").arg(done * 100 / total));
+}
+
+void QHexInspector::slotAggregateFinished(bool ok)
+{
+	// Signals queued before the job was replaced
+	if(!m_paggregate || sender() != m_paggregate.data())
+		return;
+
+	if(!ok)
+	{
+		m_pselectionItem->setText(1, "Not available");
+		return;
+	}
+
+	m_pselectionItem->setText(1, QString());
+	showAggregate(m_paggregate->result());
+}
+
+void QHexInspector::showAggregate(const QHexAggregate::Result &res)
+{
+	setRow(m_pselectionItem, RowLength, QString::number(res.length));
+	setRow(m_pselectionItem, RowElements, QString::number(res.elements));
+	setRow(m_pselectionItem, RowMin, res.min.isValid() ? res.min.toString() : QString("-"));
+	setRow(m_pselectionItem, RowMax, res.max.isValid() ? res.max.toString() : QString("-"));
+	setRow(m_pselectionItem, RowSum, res.elements ? QString::number(res.sum, 'g', 17) : QString("-"));
+	setRow(m_pselectionItem, RowMean, res.elements ? QString::number(res.sum / res.elements, 'g', 17) : QString("-"));
+	setRow(m_pselectionItem, RowCrc32, QString("%1").arg(res.crc32, 8, 16, QChar('0')));
+	setRow(m_pselectionItem, RowXxh64, QString("%1").arg(res.xxh64, 16, 16, QChar('0')));
+	setRow(m_pselectionItem, RowSha256, QString(res.sha256.toHex()));
+
+	for(int value = 0; value < 256; value++)
+	{
+		double share = res.length ? 100.0 * res.histogram[value] / res.length : 0;
+		setRow(m_phistogramItem, value, QString::number(res.histogram[value]), QString("%1%").arg(share, 0, 'f', 2));
+	}
+}
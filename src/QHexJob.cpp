@@ -0,0 +1,77 @@
+#include "../include/QHexJob.h"
+
+
+QHexJob::QHexJob(const QHexView::DataStoragePtr &pData, QObject *parent):
+QObject(parent),
+m_pdata(pData),
+m_tasks(0)
+{
+}
+
+bool QHexJob::isRunning()
+{
+	QMutexLocker lock(&m_stateMtx);
+	return m_tasks > 0;
+}
+
+bool QHexJob::isCanceled() const
+{
+	return m_canceled.loadAcquire() != 0;
+}
+
+void QHexJob::wait()
+{
+	QMutexLocker lock(&m_stateMtx);
+	while(m_tasks > 0)
+		m_stateCond.wait(&m_stateMtx);
+}
+
+void QHexJob::releaseData()
+{
+	cancel();
+	wait();
+	m_pdata.clear();
+}
+
+void QHexJob::cancel()
+{
+	m_canceled.storeRelease(1);
+}
+
+void QHexJob::resetCanceled()
+{
+	m_canceled.storeRelease(0);
+}
+
+void QHexJob::taskStarted()
+{
+	QMutexLocker lock(&m_stateMtx);
+	m_tasks++;
+}
+
+void QHexJob::taskFinished()
+{
+	QMutexLocker lock(&m_stateMtx);
+	if(--m_tasks == 0)
+		m_stateCond.wakeAll();
+}
+
+std::size_t QHexJob::readData(std::size_t position, std::size_t length, char *dst)
+{
+	return readData(m_pdata, position, length, dst);
+}
+
+std::size_t QHexJob::dataSize()
+{
+	return dataSize(m_pdata);
+}
+
+std::size_t QHexJob::readData(const QHexView::DataStoragePtr &pData, std::size_t position, std::size_t length, char *dst)
+{
+	return pData ? pData->read(position, length, dst) : 0;
+}
+
+std::size_t QHexJob::dataSize(const QHexView::DataStoragePtr &pData)
+{
+	return pData ? pData->size() : 0;
+}
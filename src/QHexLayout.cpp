@@ -0,0 +1,166 @@
+#include "../include/QHexLayout.h"
+
+#include <algorithm>
+
+
+QHexLayout::QHexLayout():
+m_bytesPerLine(16),
+m_groupSize(1),
+m_littleEndian(false),
+m_baseOffset(0),
+m_lead(0),
+m_charWidth(1),
+m_hexLeft(0),
+m_asciiGap(0),
+m_asciiLeft(0)
+{
+	update();
+}
+
+void QHexLayout::update()
+{
+	m_lead = (m_bytesPerLine - m_baseOffset % m_bytesPerLine) % m_bytesPerLine;
+	m_asciiLeft = hexRight() + m_asciiGap;
+}
+
+void QHexLayout::setBytesPerLine(std::size_t bytes)
+{
+	m_bytesPerLine = std::max<std::size_t>(bytes, 1);
+	update();
+}
+
+std::size_t QHexLayout::bytesPerLine() const
+{
+	return m_bytesPerLine;
+}
+
+void QHexLayout::setGrouping(int groupSize, bool littleEndian)
+{
+	m_groupSize = groupSize == 2 || groupSize == 4 || groupSize == 8 ? groupSize : 1;
+	m_littleEndian = littleEndian && m_groupSize > 1;
+	update();
+}
+
+int QHexLayout::groupSize() const
+{
+	return m_groupSize;
+}
+
+bool QHexLayout::littleEndian() const
+{
+	return m_littleEndian;
+}
+
+void QHexLayout::setBaseOffset(std::size_t offset)
+{
+	m_baseOffset = offset;
+	update();
+}
+
+std::size_t QHexLayout::baseOffset() const
+{
+	return m_baseOffset;
+}
+
+void QHexLayout::setGeometry(int charWidth, int hexLeft, int asciiGap)
+{
+	m_charWidth = std::max(charWidth, 1);
+	m_hexLeft = hexLeft;
+	m_asciiGap = asciiGap;
+	update();
+}
+
+std::size_t QHexLayout::line(std::size_t offset) const
+{
+	return (offset + m_lead) / m_bytesPerLine;
+}
+
+std::size_t QHexLayout::column(std::size_t offset) const
+{
+	return (offset + m_lead) % m_bytesPerLine;
+}
+
+std::size_t QHexLayout::lineStart(std::size_t line) const
+{
+	return line ? line * m_bytesPerLine - m_lead : 0;
+}
+
+std::size_t QHexLayout::lineCount(std::size_t size) const
+{
+	return size ? line(size - 1) + 1 : 0;
+}
+
+std::size_t QHexLayout::offsetAt(std::size_t line, std::size_t column) const
+{
+	std::size_t position = line * m_bytesPerLine + column;
+	return position > m_lead ? position - m_lead : 0;
+}
+
+std::size_t QHexLayout::moveLines(std::size_t nibble, qint64 lines) const
+{
+	std::size_t distance = (lines < 0 ? -lines : lines) * 2 * m_bytesPerLine;
+	if(lines >= 0)
+		return nibble + distance;
+	return nibble > distance ? nibble - distance : 0;
+}
+
+int QHexLayout::hexX(std::size_t column) const
+{
+	// A word takes two characters per byte and a space
+	std::size_t group = column / m_groupSize;
+	int slot = column % m_groupSize;
+	if(m_littleEndian)
+		slot = m_groupSize - 1 - slot;
+	return m_hexLeft + (group * (2 * m_groupSize + 1) + 2 * slot) * m_charWidth;
+}
+
+int QHexLayout::hexLeft() const
+{
+	return m_hexLeft;
+}
+
+int QHexLayout::hexRight() const
+{
+	std::size_t groups = (m_bytesPerLine + m_groupSize - 1) / m_groupSize;
+	return m_hexLeft + (groups * (2 * m_groupSize + 1) - 1) * m_charWidth;
+}
+
+int QHexLayout::asciiX(std::size_t column) const
+{
+	return m_asciiLeft + column * m_charWidth;
+}
+
+int QHexLayout::asciiLeft() const
+{
+	return m_asciiLeft;
+}
+
+int QHexLayout::asciiRight() const
+{
+	return asciiX(m_bytesPerLine);
+}
+
+bool QHexLayout::hexColumnAt(int x, std::size_t &column, bool &low) const
+{
+	if(x < m_hexLeft || x >= hexRight())
+		return false;
+
+	// The space after a word counts as the low nibble of its last slot
+	int groupChars = 2 * m_groupSize + 1;
+	std::size_t chars = (x - m_hexLeft) / m_charWidth;
+	int within = chars % groupChars;
+	int slot = std::min(within / 2, m_groupSize - 1);
+	low = within % 2 || within == groupChars - 1;
+
+	column = chars / groupChars * m_groupSize + (m_littleEndian ? m_groupSize - 1 - slot : slot);
+	return column < m_bytesPerLine;
+}
+
+bool QHexLayout::asciiColumnAt(int x, std::size_t &column) const
+{
+	if(x < m_asciiLeft || x >= asciiRight())
+		return false;
+
+	column = (x - m_asciiLeft) / m_charWidth;
+	return true;
+}
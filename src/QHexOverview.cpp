@@ -0,0 +1,352 @@
+#include "../include/QHexOverview.h"
+
+#include <QRunnable>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const std::size_t MIN_BLOCK_SIZE = 4096;
+// Blocks grow with the storage so the finest level stays below this many cells
+const std::size_t MAX_BLOCKS = 64 * 1024;
+const std::size_t CHUNK_BLOCKS = 16;
+
+struct StateHeader
+{
+	quint64   size;
+	quint64   blockSize;
+	quint64   blocks;
+};
+
+
+class QHexOverview::Task: public QRunnable
+{
+	public:
+		Task(QHexOverview *poverview): m_poverview(poverview) {}
+
+		virtual void run()
+		{
+			m_poverview->run();
+		}
+	private:
+		QHexOverview   *m_poverview;
+};
+
+
+static QHexOverview::Cell emptyCell()
+{
+	QHexOverview::Cell cell = {0, 0, 0, 0, 0};
+	return cell;
+}
+
+static void addCell(QHexOverview::Cell &sum, const QHexOverview::Cell &cell)
+{
+	quint32 blocks = sum.blocks + cell.blocks;
+	if(!blocks)
+		return;
+
+	float weight = (float)cell.blocks / blocks;
+	sum.entropy += (cell.entropy - sum.entropy) * weight;
+	sum.zeros += (cell.zeros - sum.zeros) * weight;
+	sum.ones += (cell.ones - sum.ones) * weight;
+	sum.printable += (cell.printable - sum.printable) * weight;
+	sum.blocks = blocks;
+}
+
+static QHexOverview::Cell blockCell(const uchar *pdata, std::size_t length)
+{
+	// Four interleaved histograms keep consecutive equal bytes from
+	// serializing on the same counter
+	quint32 counts[4][256];
+	memset(counts, 0, sizeof(counts));
+
+	std::size_t i = 0;
+	for(; i + 4 <= length; i += 4)
+	{
+		counts[0][pdata[i]]++;
+		counts[1][pdata[i + 1]]++;
+		counts[2][pdata[i + 2]]++;
+		counts[3][pdata[i + 3]]++;
+	}
+	for(; i < length; i++)
+		counts[0][pdata[i]]++;
+
+	double entropy = 0;
+	quint32 printable = 0;
+	for(int value = 0; value < 256; value++)
+	{
+		quint32 count = counts[0][value] + counts[1][value] + counts[2][value] + counts[3][value];
+		counts[0][value] = count;
+		if(!count)
+			continue;
+
+		double p = (double)count / length;
+		entropy -= p * std::log(p);
+		if(value >= 0x20 && value < 0x7f)
+			printable += count;
+	}
+
+	QHexOverview::Cell cell;
+	cell.entropy = entropy / std::log(256.0);
+	cell.zeros = (float)counts[0][0] / length;
+	cell.ones = (float)counts[0][0xff] / length;
+	cell.printable = (float)printable / length;
+	cell.blocks = 1;
+	return cell;
+}
+
+
+QHexOverview::QHexOverview(const QHexView::DataStoragePtr &pData, QObject *parent):
+QHexJob(pData, parent),
+m_threads(std::max(QThread::idealThreadCount(), 1)),
+m_blockSize(MIN_BLOCK_SIZE),
+m_blocks(0),
+m_size(0),
+m_total(0),
+m_complete(false),
+m_done(0)
+{
+	m_pool.setMaxThreadCount(m_threads);
+}
+
+QHexOverview::~QHexOverview()
+{
+	cancel();
+	wait();
+}
+
+void QHexOverview::setThreadCount(int threads)
+{
+	m_threads = std::max(threads, 1);
+	m_pool.setMaxThreadCount(m_threads);
+}
+
+void QHexOverview::start(std::size_t position)
+{
+	cancel();
+	wait();
+
+	std::size_t size = dataSize();
+	std::size_t first;
+	bool complete;
+	{
+		QMutexLocker lock(&m_cellsMtx);
+
+		first = resize(size, position);
+
+		// Blocks from first on are computed again, their sums are cleared up the pyramid
+		for(std::size_t i = first; i < m_blocks; i++)
+			m_levels[0][i] = emptyCell();
+		merge(first, m_blocks);
+
+		m_total = m_size - std::min(first * m_blockSize, m_size);
+		m_done = 0;
+		m_complete = complete = first == m_blocks;
+	}
+
+	m_nextBlock.storeRelease(first);
+	resetCanceled();
+
+	if(complete)
+	{
+		emit updated();
+		emit finished(true);
+		return;
+	}
+
+	std::size_t chunks = (m_blocks - first + CHUNK_BLOCKS - 1) / CHUNK_BLOCKS;
+	int workers = std::min<std::size_t>(m_threads, chunks);
+	m_workers.storeRelease(workers);
+	for(int i = 0; i < workers; i++)
+	{
+		taskStarted();
+		m_pool.start(new Task(this));
+	}
+}
+
+void QHexOverview::run()
+{
+	QByteArray buffer(CHUNK_BLOCKS * m_blockSize, Qt::Uninitialized);
+	QVector<Cell> found;
+
+	while(!isCanceled())
+	{
+		std::size_t block = m_nextBlock.fetchAndAddOrdered(CHUNK_BLOCKS);
+		if(block >= m_blocks)
+			break;
+
+		std::size_t position = block * m_blockSize;
+		std::size_t length = std::min(CHUNK_BLOCKS * m_blockSize, m_size - position);
+		length = readData(position, length, buffer.data());
+
+		found.clear();
+		for(std::size_t offset = 0; offset < length; offset += m_blockSize)
+			found.append(blockCell((const uchar *)buffer.constData() + offset, std::min(m_blockSize, length - offset)));
+
+		quint64 done;
+		{
+			QMutexLocker lock(&m_cellsMtx);
+			std::copy(found.constBegin(), found.constEnd(), m_levels[0].begin() + block);
+			merge(block, block + found.size());
+			done = m_done += length;
+		}
+
+		emit updated();
+		emit progress(done, m_total);
+	}
+
+	if(m_workers.fetchAndAddOrdered(-1) == 1)
+	{
+		{
+			QMutexLocker lock(&m_cellsMtx);
+			m_complete = !isCanceled();
+		}
+		emit finished(!isCanceled());
+	}
+
+	taskFinished();
+}
+
+std::size_t QHexOverview::resize(std::size_t size, std::size_t position)
+{
+	std::size_t blockSize = MIN_BLOCK_SIZE;
+	while(blockSize * MAX_BLOCKS < size)
+		blockSize *= 2;
+
+	if(blockSize != m_blockSize)
+	{
+		m_levels.clear();
+		position = 0;
+	}
+	m_blockSize = blockSize;
+	m_size = size;
+	m_blocks = (size + blockSize - 1) / blockSize;
+
+	std::size_t cells = m_blocks;
+	int level = 0;
+	do
+	{
+		if(level == m_levels.size())
+			m_levels.append(QVector<Cell>());
+		m_levels[level].resize(cells);
+		cells = (cells + 1) / 2;
+		level++;
+	}
+	while(m_levels[level - 1].size() > 1);
+	m_levels.resize(level);
+
+	return std::min(position / blockSize, m_blocks);
+}
+
+void QHexOverview::merge(std::size_t first, std::size_t last)
+{
+	// Parents of the changed cells are summed up again, level by level
+	for(int level = 1; level < m_levels.size() && first < last; level++)
+	{
+		const QVector<Cell> &children = m_levels[level - 1];
+		QVector<Cell> &parents = m_levels[level];
+
+		first /= 2;
+		last = (last + 1) / 2;
+		for(std::size_t i = first; i < last; i++)
+		{
+			Cell cell = children[2 * i];
+			if(2 * i + 1 < (std::size_t)children.size())
+				addCell(cell, children[2 * i + 1]);
+			parents[i] = cell;
+		}
+	}
+}
+
+QHexOverview::Cell QHexOverview::range(std::size_t first, std::size_t last) const
+{
+	// Whole cells are taken from the highest level which covers them, as in a segment tree
+	Cell res = emptyCell();
+	for(int level = 0; level < m_levels.size() && first < last; level++)
+	{
+		const QVector<Cell> &cells = m_levels[level];
+		if(first & 1)
+			addCell(res, cells[first++]);
+		if(last & 1)
+			addCell(res, cells[--last]);
+		first /= 2;
+		last /= 2;
+	}
+	return res;
+}
+
+std::size_t QHexOverview::size()
+{
+	QMutexLocker lock(&m_cellsMtx);
+	return m_size;
+}
+
+std::size_t QHexOverview::blockSize()
+{
+	QMutexLocker lock(&m_cellsMtx);
+	return m_blockSize;
+}
+
+QVector<QHexOverview::Cell> QHexOverview::cells(int count)
+{
+	QVector<Cell> res;
+	QMutexLocker lock(&m_cellsMtx);
+
+	if(!m_blocks || count <= 0)
+		return res;
+
+	res.reserve(count);
+	for(int i = 0; i < count; i++)
+	{
+		// Ranges smaller than a block show the block they fall into
+		std::size_t first = (quint64)m_blocks * i / count;
+		std::size_t last = std::max<std::size_t>((quint64)m_blocks * (i + 1) / count, first + 1);
+		res.append(range(first, last));
+	}
+	return res;
+}
+
+QByteArray QHexOverview::saveState()
+{
+	QMutexLocker lock(&m_cellsMtx);
+
+	if(!m_complete || m_levels.isEmpty())
+		return QByteArray();
+
+	StateHeader header = {m_size, m_blockSize, m_blocks};
+	QByteArray res((const char *)&header, sizeof(header));
+	res.append((const char *)m_levels[0].constData(), m_blocks * sizeof(Cell));
+	return res;
+}
+
+bool QHexOverview::restoreState(const QByteArray &state)
+{
+	if((std::size_t)state.size() < sizeof(StateHeader))
+		return false;
+
+	StateHeader header;
+	memcpy(&header, state.constData(), sizeof(header));
+	if(header.size != dataSize() || (std::size_t)state.size() != sizeof(header) + header.blocks * sizeof(Cell))
+		return false;
+
+	cancel();
+	wait();
+
+	{
+		QMutexLocker lock(&m_cellsMtx);
+
+		resize(header.size, 0);
+		if(header.blockSize != m_blockSize || header.blocks != m_blocks)
+			return false;
+
+		memcpy(m_levels[0].data(), state.constData() + sizeof(header), m_blocks * sizeof(Cell));
+		merge(0, m_blocks);
+		m_total = m_done = m_size;
+		m_complete = true;
+	}
+
+	emit updated();
+	emit finished(true);
+	return true;
+}
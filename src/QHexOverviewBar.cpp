@@ -0,0 +1,127 @@
+#include "../include/QHexOverviewBar.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+
+#include <algorithm>
+
+const int BAR_WIDTH = 16;
+
+
+QHexOverviewBar::QHexOverviewBar(QWidget *parent):
+QWidget(parent),
+m_mode(Entropy),
+m_visibleOffset(0),
+m_visibleLength(0)
+{
+	setCursor(Qt::PointingHandCursor);
+}
+
+void QHexOverviewBar::setOverview(QHexOverview *poverview)
+{
+	if(m_poverview)
+		disconnect(m_poverview, 0, this, 0);
+
+	// Cells arrive from worker threads, repaints coalesce until the strip is drawn
+	m_poverview = poverview;
+	if(m_poverview)
+		connect(m_poverview, SIGNAL(updated()), SLOT(update()));
+	update();
+}
+
+void QHexOverviewBar::setMode(Mode mode)
+{
+	m_mode = mode;
+	update();
+}
+
+QHexOverviewBar::Mode QHexOverviewBar::mode() const
+{
+	return m_mode;
+}
+
+void QHexOverviewBar::setVisibleRange(std::size_t offset, std::size_t length)
+{
+	if(offset == m_visibleOffset && length == m_visibleLength)
+		return;
+
+	m_visibleOffset = offset;
+	m_visibleLength = length;
+	update();
+}
+
+QSize QHexOverviewBar::sizeHint() const
+{
+	return QSize(BAR_WIDTH, 0);
+}
+
+QColor QHexOverviewBar::cellColor(const QHexOverview::Cell &cell) const
+{
+	if(!cell.blocks)
+		return palette().color(QPalette::Window);
+
+	switch(m_mode)
+	{
+		case Entropy:
+			return QColor::fromHsv(240 * (1 - cell.entropy), 255, 64 + 191 * cell.entropy);
+		case Density:
+		{
+			int gray = 128 + 127 * (cell.ones - cell.zeros);
+			return QColor(gray, gray, gray);
+		}
+		case ByteClass:
+		default:
+		{
+			float other = std::max(1 - cell.zeros - cell.ones - cell.printable, 0.0f);
+			return QColor(255 * cell.ones + 55 * cell.printable + 228 * other,
+				255 * cell.ones + 126 * cell.printable + 26 * other,
+				255 * cell.ones + 184 * cell.printable + 28 * other);
+		}
+	}
+}
+
+void QHexOverviewBar::paintEvent(QPaintEvent *event)
+{
+	QPainter painter(this);
+	painter.fillRect(event->rect(), palette().color(QPalette::Window));
+
+	if(!m_poverview || height() <= 0)
+		return;
+
+	// One cell per pixel row, summed up from the pyramid
+	QVector<QHexOverview::Cell> cells = m_poverview->cells(height());
+	for(int y = event->rect().top(); y <= event->rect().bottom() && y < cells.size(); y++)
+		painter.fillRect(0, y, width(), 1, cellColor(cells[y]));
+
+	std::size_t size = m_poverview->size();
+	if(!size || !m_visibleLength)
+		return;
+
+	int top = (double)m_visibleOffset / size * height();
+	int bottom = (double)std::min(m_visibleOffset + m_visibleLength, size) / size * height();
+	painter.setPen(palette().color(QPalette::Highlight));
+	painter.drawRect(0, top, width() - 1, std::max(bottom - top, 2));
+}
+
+void QHexOverviewBar::reportOffset(int y)
+{
+	if(!m_poverview || height() <= 0)
+		return;
+
+	std::size_t size = m_poverview->size();
+	y = std::max(0, std::min(y, height() - 1));
+	emit offsetClicked((double)y / height() * size);
+}
+
+void QHexOverviewBar::mousePressEvent(QMouseEvent *event)
+{
+	if(event->button() == Qt::LeftButton)
+		reportOffset(event->y());
+}
+
+void QHexOverviewBar::mouseMoveEvent(QMouseEvent *event)
+{
+	if(event->buttons() & Qt::LeftButton)
+		reportOffset(event->y());
+}
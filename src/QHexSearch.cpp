@@ -0,0 +1,451 @@
+#include "../include/QHexSearch.h"
+
+#include <QRunnable>
+#include <QThread>
+
+#include <algorithm>
+#include <cstring>
+
+const std::size_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+const std::size_t MIN_CHUNK_SIZE = 4096;
+const std::size_t DEFAULT_MAX_MATCH_LENGTH = 256;
+
+
+class QHexSearch::Task: public QRunnable
+{
+	public:
+		Task(QHexSearch *psearch): m_psearch(psearch) {}
+
+		virtual void run()
+		{
+			m_psearch->run();
+		}
+	private:
+		QHexSearch   *m_psearch;
+};
+
+
+static int hexValue(QChar ch)
+{
+	ushort c = ch.unicode();
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+// Regular expressions see every byte as the Latin-1 character with the same code
+static QString escapeBytes(const QByteArray &bytes)
+{
+	QString res;
+	for(int i = 0; i < bytes.size(); i++)
+		res += QString("\\x{%1}").arg((uint)(uchar)bytes[i], 2, 16, QChar('0'));
+	return res;
+}
+
+static QByteArray toUtf16(const QString &text)
+{
+	QByteArray res;
+	for(int i = 0; i < text.size(); i++)
+	{
+		ushort ch = text[i].unicode();
+		res += (char)(ch & 0xFF);
+		res += (char)(ch >> 8);
+	}
+	return res;
+}
+
+static bool lessOffset(const QHexSearch::Match &match, std::size_t offset)
+{
+	return match.offset < offset;
+}
+
+
+QHexSearch::QHexSearch(const QHexView::DataStoragePtr &pData, QObject *parent):
+QHexJob(pData, parent),
+m_chunkSize(DEFAULT_CHUNK_SIZE),
+m_threads(std::max(QThread::idealThreadCount(), 1)),
+m_maxMatchLength(DEFAULT_MAX_MATCH_LENGTH),
+m_anchor(0),
+m_useRegex(false),
+m_overlap(0),
+m_size(0),
+m_chunks(0),
+m_count(0)
+{
+	m_pool.setMaxThreadCount(m_threads);
+}
+
+QHexSearch::~QHexSearch()
+{
+	cancel();
+	wait();
+}
+
+void QHexSearch::setChunkSize(std::size_t size)
+{
+	m_chunkSize = std::max(size, MIN_CHUNK_SIZE);
+}
+
+void QHexSearch::setThreadCount(int threads)
+{
+	m_threads = std::max(threads, 1);
+	m_pool.setMaxThreadCount(m_threads);
+}
+
+void QHexSearch::setMaxMatchLength(std::size_t length)
+{
+	m_maxMatchLength = std::max<std::size_t>(length, 1);
+}
+
+QString QHexSearch::errorString() const
+{
+	return m_error;
+}
+
+bool QHexSearch::compile(const QString &pattern, Mode mode, Qt::CaseSensitivity cs)
+{
+	m_error.clear();
+	m_bytes.clear();
+	m_mask.clear();
+	m_useRegex = false;
+
+	switch(mode)
+	{
+		case HexPattern:
+		{
+			// Whitespace is ignored, a '?' stands for any nibble
+			QString digits = pattern.simplified().remove(' ');
+			if(digits.isEmpty() || digits.size() % 2)
+			{
+				m_error = "Hex pattern must have an even number of digits";
+				return false;
+			}
+
+			for(int i = 0; i < digits.size(); i += 2)
+			{
+				uchar byte = 0;
+				uchar mask = 0;
+				for(int j = 0; j < 2; j++)
+				{
+					int shift = j ? 0 : 4;
+					if(digits[i + j] == QChar('?'))
+						continue;
+
+					int value = hexValue(digits[i + j]);
+					if(value < 0)
+					{
+						m_error = "Invalid hex digit '" + QString(digits[i + j]) + "'";
+						return false;
+					}
+					byte |= value << shift;
+					mask |= 0xF << shift;
+				}
+				m_bytes += (char)byte;
+				m_mask += (char)mask;
+			}
+			break;
+		}
+		case Ascii:
+		{
+			if(pattern.isEmpty())
+			{
+				m_error = "Search text is empty";
+				return false;
+			}
+
+			// toLatin1 would search for '?' instead
+			for(int i = 0; i < pattern.size(); i++)
+			{
+				if(pattern[i].unicode() > 0xFF)
+				{
+					m_error = "Character '" + QString(pattern[i]) + "' is not Latin-1";
+					return false;
+				}
+			}
+
+			QByteArray bytes = pattern.toLatin1();
+			if(cs == Qt::CaseInsensitive)
+			{
+				m_regex = QRegularExpression(QRegularExpression::escape(QString::fromLatin1(bytes)), QRegularExpression::CaseInsensitiveOption);
+				m_useRegex = true;
+				m_overlap = bytes.size() - 1;
+			}
+			else
+			{
+				m_bytes = bytes;
+				m_mask = QByteArray(bytes.size(), (char)0xFF);
+			}
+			break;
+		}
+		case Utf16:
+		{
+			if(pattern.isEmpty())
+			{
+				m_error = "Search text is empty";
+				return false;
+			}
+
+			if(cs == Qt::CaseInsensitive)
+			{
+				// Both code units of a character are matched together, letters as alternatives
+				QString regex;
+				for(int i = 0; i < pattern.size(); i++)
+				{
+					QString lower = escapeBytes(toUtf16(pattern[i].toLower()));
+					QString upper = escapeBytes(toUtf16(pattern[i].toUpper()));
+					regex += (lower == upper) ? lower : "(?:" + lower + "|" + upper + ")";
+				}
+				m_regex = QRegularExpression(regex);
+				m_useRegex = true;
+				m_overlap = 2 * pattern.size() - 1;
+			}
+			else
+			{
+				m_bytes = toUtf16(pattern);
+				m_mask = QByteArray(m_bytes.size(), (char)0xFF);
+			}
+			break;
+		}
+		case RegularExpression:
+		{
+			// Binary data has line breaks anywhere, '.' has to cross them
+			QRegularExpression::PatternOptions options = QRegularExpression::DotMatchesEverythingOption;
+			if(cs == Qt::CaseInsensitive)
+				options |= QRegularExpression::CaseInsensitiveOption;
+
+			m_regex = QRegularExpression(pattern, options);
+			m_useRegex = true;
+			m_overlap = m_maxMatchLength - 1;
+			break;
+		}
+	}
+
+	if(m_useRegex)
+	{
+		if(!m_regex.isValid())
+		{
+			m_error = m_regex.errorString();
+			return false;
+		}
+		m_regex.optimize();
+		return true;
+	}
+
+	// The prefilter looks for the first byte without wildcards
+	m_anchor = m_mask.indexOf((char)0xFF);
+	if(m_anchor < 0)
+	{
+		m_error = "Hex pattern needs at least one byte without wildcards";
+		return false;
+	}
+	m_overlap = m_bytes.size() - 1;
+	return true;
+}
+
+bool QHexSearch::start(const QString &pattern, Mode mode, Qt::CaseSensitivity cs)
+{
+	cancel();
+	wait();
+
+	if(!compile(pattern, mode, cs))
+		return false;
+
+	{
+		QMutexLocker lock(&m_resultsMtx);
+		m_results.clear();
+		m_count = 0;
+	}
+
+	m_size = dataSize();
+	m_chunks = (m_size + m_chunkSize - 1) / m_chunkSize;
+	m_nextChunk.storeRelease(0);
+	m_chunksDone.storeRelease(0);
+	resetCanceled();
+
+	if(!m_chunks)
+	{
+		emit finished(true);
+		return true;
+	}
+
+	int workers = std::min<std::size_t>(m_threads, m_chunks);
+	m_workers.storeRelease(workers);
+	for(int i = 0; i < workers; i++)
+	{
+		taskStarted();
+		m_pool.start(new Task(this));
+	}
+
+	return true;
+}
+
+void QHexSearch::run()
+{
+	QByteArray buffer(m_chunkSize + m_overlap, Qt::Uninitialized);
+
+	// Workers take the next unsearched chunk until none is left
+	while(!isCanceled())
+	{
+		std::size_t chunk = m_nextChunk.fetchAndAddOrdered(1);
+		if(chunk >= m_chunks)
+			break;
+
+		std::size_t position = chunk * m_chunkSize;
+		std::size_t length = std::min(m_chunkSize + m_overlap, m_size - position);
+		length = readData(position, length, buffer.data());
+
+		// Only matches starting inside the chunk are reported, the overlap belongs to the next one
+		std::size_t limit = std::min(m_chunkSize, length);
+
+		QVector<Match> found;
+		if(m_useRegex)
+			searchRegex(buffer.constData(), length, limit, position, found);
+		else
+			searchBytes(buffer.constData(), length, limit, position, found);
+
+		if(!found.isEmpty())
+		{
+			std::size_t count;
+			{
+				QMutexLocker lock(&m_resultsMtx);
+				m_results.insert(chunk, found);
+				m_count += found.size();
+				count = m_count;
+			}
+			emit matchesFound(count);
+		}
+
+		std::size_t done = m_chunksDone.fetchAndAddOrdered(1) + 1;
+		emit progress(std::min(done * m_chunkSize, m_size), m_size);
+	}
+
+	// The last worker to leave reports the end of the search
+	if(m_workers.fetchAndAddOrdered(-1) == 1)
+		emit finished(!isCanceled());
+
+	taskFinished();
+}
+
+void QHexSearch::searchBytes(const char *pdata, std::size_t length, std::size_t limit, std::size_t offset, QVector<Match> &res)
+{
+	std::size_t patternSize = m_bytes.size();
+	if(length < patternSize)
+		return;
+
+	const char *pbytes = m_bytes.constData();
+	const char *pmask = m_mask.constData();
+	char anchor = pbytes[m_anchor];
+
+	// Candidates are found with memchr on the anchor byte (vectorized in common C libraries),
+	// only those are compared in full
+	std::size_t last = std::min(limit, length - patternSize + 1);
+	for(std::size_t start = 0; start < last; )
+	{
+		const char *phit = (const char *)memchr(pdata + start + m_anchor, anchor, last - start);
+		if(!phit)
+			break;
+
+		std::size_t candidate = phit - pdata - m_anchor;
+		const char *pcandidate = pdata + candidate;
+
+		std::size_t i = 0;
+		while(i < patternSize && !((pcandidate[i] ^ pbytes[i]) & pmask[i]))
+			i++;
+
+		if(i == patternSize)
+		{
+			Match match = {offset + candidate, patternSize};
+			res.append(match);
+		}
+		start = candidate + 1;
+	}
+}
+
+void QHexSearch::searchRegex(const char *pdata, std::size_t length, std::size_t limit, std::size_t offset, QVector<Match> &res)
+{
+	QString text = QString::fromLatin1(pdata, length);
+	QRegularExpressionMatchIterator it = m_regex.globalMatch(text);
+	while(it.hasNext())
+	{
+		QRegularExpressionMatch found = it.next();
+		if((std::size_t)found.capturedStart() >= limit)
+			break;
+
+		if(found.capturedLength() > 0)
+		{
+			Match match = {offset + found.capturedStart(), (quint64)found.capturedLength()};
+			res.append(match);
+		}
+	}
+}
+
+std::size_t QHexSearch::count()
+{
+	QMutexLocker lock(&m_resultsMtx);
+	return m_count;
+}
+
+bool QHexSearch::next(std::size_t offset, Match &match)
+{
+	QMutexLocker lock(&m_resultsMtx);
+
+	QMap<std::size_t, QVector<Match> >::const_iterator it = m_results.lowerBound(offset / m_chunkSize);
+	for(; it != m_results.constEnd(); ++it)
+	{
+		const QVector<Match> &matches = it.value();
+		QVector<Match>::const_iterator found = std::lower_bound(matches.constBegin(), matches.constEnd(), offset, lessOffset);
+		if(found != matches.constEnd())
+		{
+			match = *found;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool QHexSearch::previous(std::size_t offset, Match &match)
+{
+	QMutexLocker lock(&m_resultsMtx);
+
+	QMap<std::size_t, QVector<Match> >::const_iterator it = m_results.upperBound(offset / m_chunkSize);
+	while(it != m_results.constBegin())
+	{
+		--it;
+		const QVector<Match> &matches = it.value();
+		QVector<Match>::const_iterator found = std::lower_bound(matches.constBegin(), matches.constEnd(), offset, lessOffset);
+		if(found != matches.constBegin())
+		{
+			match = *(found - 1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+QVector<QHexSearch::Match> QHexSearch::matches(std::size_t begin, std::size_t end)
+{
+	QVector<Match> res;
+	QMutexLocker lock(&m_resultsMtx);
+
+	// Matches starting up to m_overlap bytes earlier may still reach into the range
+	std::size_t first = begin > m_overlap ? begin - m_overlap : 0;
+	QMap<std::size_t, QVector<Match> >::const_iterator it = m_results.lowerBound(first / m_chunkSize);
+	for(; it != m_results.constEnd() && it.key() * m_chunkSize < end; ++it)
+	{
+		const QVector<Match> &matches = it.value();
+		QVector<Match>::const_iterator found = std::lower_bound(matches.constBegin(), matches.constEnd(), first, lessOffset);
+		for(; found != matches.constEnd() && found->offset < end; ++found)
+		{
+			if(found->offset + found->length > begin)
+				res.append(*found);
+		}
+	}
+
+	return res;
+}
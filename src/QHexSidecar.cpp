@@ -0,0 +1,219 @@
+#include "../include/QHexSidecar.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
+
+const char INDEX_MAGIC[4] = {'Q', 'H', 'X', 'I'};
+const quint32 INDEX_VERSION = 1;
+// Written in native order; an index from a machine of the other byte order reads back swapped
+const quint32 BYTE_ORDER_MARK = 0x01020304;
+const int HASH_LENGTH = 20;
+
+// The hash covers this many samples, the first and last ones at the ends of the file
+const int SAMPLE_COUNT = 16;
+const qint64 SAMPLE_SIZE = 4096;
+
+
+struct IndexHeader
+{
+	char      magic[4];
+	quint32   version;
+	quint32   byteOrder;
+	quint32   sections;
+	quint64   size;
+	qint64    modified;
+	uchar     hash[HASH_LENGTH];
+	quint32   reserved;
+};
+
+struct IndexEntry
+{
+	quint32   tag;
+	quint32   reserved;
+	quint64   offset;
+	quint64   length;
+};
+
+// Sections start 8-byte aligned, so their contents can be read in place
+static quint64 align(quint64 offset)
+{
+	return (offset + 7) & ~(quint64)7;
+}
+
+
+QHexSidecar::QHexSidecar(const QString &indexPath):
+m_file(indexPath),
+m_pmap(NULL)
+{
+}
+
+QHexSidecar::~QHexSidecar()
+{
+	close();
+}
+
+QString QHexSidecar::defaultPath(const QString &fileName, const QString &kind)
+{
+	QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+	QByteArray key = QCryptographicHash::hash(QFileInfo(fileName).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+	QString suffix = kind.isEmpty() ? QString() : "-" + kind;
+	return dir + "/index/" + key.toHex() + suffix + ".qhexidx";
+}
+
+QHexSidecar::Identity QHexSidecar::identity(const QString &fileName)
+{
+	Identity res;
+	QFileInfo info(fileName);
+	res.size = info.size();
+	res.modified = info.lastModified().toMSecsSinceEpoch();
+
+	QFile file(fileName);
+	if(!file.open(QIODevice::ReadOnly))
+		return res;
+
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData((const char *)&res.size, sizeof(res.size));
+
+	qint64 size = res.size;
+	QByteArray sample(SAMPLE_SIZE, Qt::Uninitialized);
+	for(int i = 0; i < SAMPLE_COUNT; i++)
+	{
+		qint64 position = size > SAMPLE_SIZE ? (size - SAMPLE_SIZE) / (SAMPLE_COUNT - 1) * i : 0;
+		if(!file.seek(position))
+			return res;
+
+		qint64 length = file.read(sample.data(), SAMPLE_SIZE);
+		if(length < 0)
+			return res;
+		hash.addData(sample.constData(), length);
+
+		if(size <= SAMPLE_SIZE)
+			break;
+	}
+
+	res.hash = hash.result();
+	return res;
+}
+
+bool QHexSidecar::open(const QString &fileName)
+{
+	close();
+
+	if(!m_file.open(QIODevice::ReadOnly))
+		return false;
+
+	qint64 size = m_file.size();
+	if(size < (qint64)sizeof(IndexHeader) || !(m_pmap = m_file.map(0, size)))
+	{
+		close();
+		return false;
+	}
+
+	IndexHeader header;
+	memcpy(&header, m_pmap, sizeof(header));
+	quint64 tableEnd = sizeof(header) + (quint64)header.sections * sizeof(IndexEntry);
+	if(memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) || header.version != INDEX_VERSION ||
+		header.byteOrder != BYTE_ORDER_MARK || tableEnd > (quint64)size)
+	{
+		close();
+		return false;
+	}
+
+	// Size and time are checked first, the sampled hash only if they match
+	QFileInfo info(fileName);
+	if(header.size != (quint64)info.size() || header.modified != info.lastModified().toMSecsSinceEpoch())
+	{
+		close();
+		return false;
+	}
+
+	Identity current = identity(fileName);
+	if(current.hash.size() != HASH_LENGTH || memcmp(header.hash, current.hash.constData(), HASH_LENGTH))
+	{
+		close();
+		return false;
+	}
+
+	for(quint32 i = 0; i < header.sections; i++)
+	{
+		IndexEntry entry;
+		memcpy(&entry, m_pmap + sizeof(header) + i * sizeof(IndexEntry), sizeof(entry));
+		if(entry.offset > (quint64)size || entry.length > (quint64)size - entry.offset)
+		{
+			close();
+			return false;
+		}
+		m_sections.insert(entry.tag, qMakePair(entry.offset, entry.length));
+	}
+
+	return true;
+}
+
+void QHexSidecar::close()
+{
+	if(m_pmap)
+		m_file.unmap(m_pmap);
+	m_pmap = NULL;
+	m_sections.clear();
+	m_file.close();
+}
+
+QByteArray QHexSidecar::section(quint32 tag) const
+{
+	QMap<quint32, QPair<quint64, quint64> >::const_iterator it = m_sections.constFind(tag);
+	if(!m_pmap || it == m_sections.constEnd())
+		return QByteArray();
+
+	return QByteArray::fromRawData((const char *)m_pmap + it->first, it->second);
+}
+
+bool QHexSidecar::write(const QString &indexPath, const QString &fileName, const QMap<quint32, QByteArray> &sections)
+{
+	Identity current = identity(fileName);
+	if(current.hash.size() != HASH_LENGTH)
+		return false;
+
+	IndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.version = INDEX_VERSION;
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.sections = sections.size();
+	header.size = current.size;
+	header.modified = current.modified;
+	memcpy(header.hash, current.hash.constData(), HASH_LENGTH);
+
+	QByteArray table;
+	quint64 offset = align(sizeof(header) + sections.size() * sizeof(IndexEntry));
+	for(QMap<quint32, QByteArray>::const_iterator it = sections.constBegin(); it != sections.constEnd(); ++it)
+	{
+		IndexEntry entry = {it.key(), 0, offset, (quint64)it.value().size()};
+		table.append((const char *)&entry, sizeof(entry));
+		offset = align(offset + entry.length);
+	}
+
+	QDir().mkpath(QFileInfo(indexPath).absolutePath());
+	QSaveFile file(indexPath);
+	if(!file.open(QIODevice::WriteOnly))
+		return false;
+
+	QByteArray data((const char *)&header, sizeof(header));
+	data += table;
+	for(QMap<quint32, QByteArray>::const_iterator it = sections.constBegin(); it != sections.constEnd(); ++it)
+	{
+		data.append(QByteArray(align(data.size()) - data.size(), '\0'));
+		if(file.write(data) != data.size())
+			return false;
+		data = it.value();
+	}
+	if(file.write(data) != data.size())
+		return false;
+
+	return file.commit();
+}
@@ -0,0 +1,222 @@
+#include "../include/QHexStats.h"
+
+#include <QtAlgorithms>
+#include <QSysInfo>
+
+#include <algorithm>
+#include <cstring>
+
+// Histograms whose name ends so count bytes, all others nanoseconds
+static const char BYTES_SUFFIX[] = ".bytes";
+
+
+static QString formatValue(const QByteArray &name, double value)
+{
+	if(name.endsWith(BYTES_SUFFIX))
+	{
+		if(value < 1024)
+			return QString("%1 B").arg(value, 0, 'f', 0);
+		if(value < 1024 * 1024)
+			return QString("%1 KB").arg(value / 1024, 0, 'f', 1);
+		return QString("%1 MB").arg(value / (1024 * 1024), 0, 'f', 1);
+	}
+
+	if(value < 1000)
+		return QString("%1 ns").arg(value, 0, 'f', 0);
+	if(value < 1000 * 1000)
+		return QString("%1 us").arg(value / 1000, 0, 'f', 1);
+	return QString("%1 ms").arg(value / (1000 * 1000), 0, 'f', 1);
+}
+
+
+QHexStats::Histogram::Histogram():
+m_count(0),
+m_total(0),
+m_max(0)
+{
+	memset(m_buckets, 0, sizeof(m_buckets));
+}
+
+void QHexStats::Histogram::add(qint64 value)
+{
+	value = std::max<qint64>(value, 0);
+	int bucket = value ? 64 - qCountLeadingZeroBits((quint64)value) : 0;
+	m_buckets[std::min(bucket, BUCKETS - 1)]++;
+	m_count++;
+	m_total += value;
+	m_max = std::max(m_max, value);
+}
+
+quint64 QHexStats::Histogram::count() const
+{
+	return m_count;
+}
+
+double QHexStats::Histogram::mean() const
+{
+	return m_count ? m_total / m_count : 0;
+}
+
+qint64 QHexStats::Histogram::max() const
+{
+	return m_max;
+}
+
+qint64 QHexStats::Histogram::percentile(double p) const
+{
+	quint64 needed = qMax<quint64>(1, p * m_count + 0.5);
+	quint64 seen = 0;
+	for(int i = 0; i < BUCKETS; i++)
+	{
+		seen += m_buckets[i];
+		if(seen >= needed)
+			return i ? std::min<qint64>(((quint64)1 << i) - 1, m_max) : 0;
+	}
+	return m_max;
+}
+
+QJsonObject QHexStats::Histogram::toJson() const
+{
+	QJsonObject res;
+	res["count"] = (double)m_count;
+	res["mean"] = mean();
+	res["p50"] = (double)percentile(0.5);
+	res["p95"] = (double)percentile(0.95);
+	res["p99"] = (double)percentile(0.99);
+	res["max"] = (double)m_max;
+	return res;
+}
+
+
+QHexStats::Timer::Timer(QHexStats *pstats, const char *name):
+m_pstats(pstats),
+m_name(name)
+{
+	if(m_pstats)
+		m_timer.start();
+}
+
+QHexStats::Timer::~Timer()
+{
+	if(m_pstats)
+		m_pstats->add(m_name, m_timer.nsecsElapsed());
+}
+
+
+QHexStats::QHexStats()
+{
+	m_since.start();
+}
+
+void QHexStats::add(const char *name, qint64 value)
+{
+	QMutexLocker lock(&m_mtx);
+	QMap<QByteArray, Histogram>::iterator it = m_histograms.find(QByteArray::fromRawData(name, strlen(name)));
+	if(it == m_histograms.end())
+		it = m_histograms.insert(QByteArray(name), Histogram());
+	it->add(value);
+}
+
+void QHexStats::addLookup(const char *cache, bool hit)
+{
+	QMutexLocker lock(&m_mtx);
+	QMap<QByteArray, Lookups>::iterator it = m_lookups.find(QByteArray::fromRawData(cache, strlen(cache)));
+	if(it == m_lookups.end())
+	{
+		Lookups lookups = {0, 0};
+		it = m_lookups.insert(QByteArray(cache), lookups);
+	}
+
+	if(hit)
+		it->hits++;
+	else
+		it->misses++;
+}
+
+void QHexStats::reset()
+{
+	QMutexLocker lock(&m_mtx);
+	m_histograms.clear();
+	m_lookups.clear();
+	m_since.start();
+}
+
+QMap<QByteArray, QHexStats::Histogram> QHexStats::histograms()
+{
+	QMutexLocker lock(&m_mtx);
+	return m_histograms;
+}
+
+QMap<QByteArray, QHexStats::Lookups> QHexStats::lookups()
+{
+	QMutexLocker lock(&m_mtx);
+	return m_lookups;
+}
+
+QJsonObject QHexStats::toJson()
+{
+	QMap<QByteArray, Histogram> histograms;
+	QMap<QByteArray, Lookups> lookups;
+	qint64 elapsed;
+	{
+		QMutexLocker lock(&m_mtx);
+		histograms = m_histograms;
+		lookups = m_lookups;
+		elapsed = m_since.elapsed();
+	}
+
+	QJsonObject histogramsJson;
+	for(QMap<QByteArray, Histogram>::const_iterator it = histograms.constBegin(); it != histograms.constEnd(); ++it)
+		histogramsJson[QString::fromLatin1(it.key())] = it->toJson();
+
+	QJsonObject lookupsJson;
+	for(QMap<QByteArray, Lookups>::const_iterator it = lookups.constBegin(); it != lookups.constEnd(); ++it)
+	{
+		QJsonObject cache;
+		cache["hits"] = (double)it->hits;
+		cache["misses"] = (double)it->misses;
+		lookupsJson[QString::fromLatin1(it.key())] = cache;
+	}
+
+	QJsonObject res;
+	res["qt"] = QString(qVersion());
+	res["os"] = QSysInfo::prettyProductName();
+	res["cpu"] = QSysInfo::currentCpuArchitecture();
+	res["elapsedMs"] = (double)elapsed;
+	res["histograms"] = histogramsJson;
+	res["lookups"] = lookupsJson;
+	return res;
+}
+
+QStringList QHexStats::summary()
+{
+	QMap<QByteArray, Histogram> histograms;
+	QMap<QByteArray, Lookups> lookups;
+	{
+		QMutexLocker lock(&m_mtx);
+		histograms = m_histograms;
+		lookups = m_lookups;
+	}
+
+	QStringList res;
+	for(QMap<QByteArray, Histogram>::const_iterator it = histograms.constBegin(); it != histograms.constEnd(); ++it)
+	{
+		res.append(QString("%1 n %2  p50 %3  p95 %4  max %5")
+			.arg(QString::fromLatin1(it.key()), -12)
+			.arg(it->count(), -7)
+			.arg(formatValue(it.key(), it->percentile(0.5)), -8)
+			.arg(formatValue(it.key(), it->percentile(0.95)), -8)
+			.arg(formatValue(it.key(), it->max())));
+	}
+
+	for(QMap<QByteArray, Lookups>::const_iterator it = lookups.constBegin(); it != lookups.constEnd(); ++it)
+	{
+		quint64 total = it->hits + it->misses;
+		res.append(QString("%1 hits %2% of %3")
+			.arg(QString::fromLatin1("cache." + it.key()), -12)
+			.arg(total ? 100.0 * it->hits / total : 0, 0, 'f', 1)
+			.arg(total));
+	}
+
+	return res;
+}
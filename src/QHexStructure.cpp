@@ -0,0 +1,631 @@
+#include "../include/QHexStructure.h"
+
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// Decoded elements kept per array; a viewport never shows more than this many
+static const int ELEMENT_CACHE = 16384;
+// Bytes of char and byte arrays shown as their value
+static const int PREVIEW_BYTES = 32;
+
+
+struct QHexStructure::Node
+{
+	Node(const QHexTemplate::Field *pdef, Node *pparent, quint64 index, bool element):
+	pdef(pdef),
+	pparent(pparent),
+	index(index),
+	element(element),
+	offset(0),
+	size(-1),
+	items(-1),
+	laidOut(false),
+	valueRead(false)
+	{
+		elements.setMaxCost(ELEMENT_CACHE);
+	}
+
+	~Node()
+	{
+		qDeleteAll(fields);
+	}
+
+	const QHexTemplate::Field   *pdef;
+	Node                        *pparent;
+	quint64                      index;       // of the field in its struct or of the element in its array
+	bool                         element;     // a single item of the array pdef describes
+	quint64                      offset;
+	qint64                       size;        // -1 until known
+	qint64                       items;       // of an array, -1 until known
+	bool                         laidOut;
+	bool                         valueRead;
+	QString                      value;
+	QVector<Node *>              fields;      // of a struct, once laid out
+	QVector<quint64>             ends;        // of the variable sized elements found so far
+	QCache<quint64, Node>        elements;
+};
+
+
+static qint64 decodeInteger(const uchar *pdata, int primitive, bool bigEndian)
+{
+	switch(primitive)
+	{
+		case QHexTemplate::U8:
+			return *pdata;
+		case QHexTemplate::I8:
+			return (qint8)*pdata;
+		case QHexTemplate::U16:
+			return bigEndian ? qFromBigEndian<quint16>(pdata) : qFromLittleEndian<quint16>(pdata);
+		case QHexTemplate::I16:
+			return bigEndian ? qFromBigEndian<qint16>(pdata) : qFromLittleEndian<qint16>(pdata);
+		case QHexTemplate::U32:
+			return bigEndian ? qFromBigEndian<quint32>(pdata) : qFromLittleEndian<quint32>(pdata);
+		case QHexTemplate::I32:
+			return bigEndian ? qFromBigEndian<qint32>(pdata) : qFromLittleEndian<qint32>(pdata);
+		default:
+			return bigEndian ? qFromBigEndian<qint64>(pdata) : qFromLittleEndian<qint64>(pdata);
+	}
+}
+
+
+QHexStructure::QHexStructure(const QHexView::DataStoragePtr &pData, const QHexTemplate &tmpl, QObject *parent):
+QHexJob(pData, parent),
+m_template(tmpl),
+m_proot(NULL),
+m_dataSize(0),
+m_decoded(0)
+{
+}
+
+QHexStructure::~QHexStructure()
+{
+	delete m_proot;
+}
+
+void QHexStructure::reset()
+{
+	delete m_proot;
+	m_proot = NULL;
+	m_decoded = 0;
+}
+
+quint64 QHexStructure::decoded() const
+{
+	return m_decoded;
+}
+
+QHexStructure::Node *QHexStructure::rootNode()
+{
+	if(!m_proot && m_template.isValid())
+	{
+		m_dataSize = dataSize();
+		m_proot = new Node(&m_template.root(), NULL, 0, false);
+		m_proot->offset = value(m_template.root().at, NULL);
+		m_decoded++;
+	}
+	return m_proot;
+}
+
+bool QHexStructure::isArray(const Node *pnode) const
+{
+	return pnode->pdef->array && !pnode->element;
+}
+
+bool QHexStructure::isStruct(const Node *pnode) const
+{
+	return pnode->pdef->primitive == QHexTemplate::Struct && !isArray(pnode);
+}
+
+bool QHexStructure::isLeaf(const Node *pnode) const
+{
+	// Arrays of characters and bytes are shown as one value
+	if(isArray(pnode))
+		return pnode->pdef->primitive == QHexTemplate::Char || pnode->pdef->primitive == QHexTemplate::Byte;
+	return !isStruct(pnode);
+}
+
+quint64 QHexStructure::value(const QHexTemplate::Value &value, Node *pstruct)
+{
+	switch(value.kind)
+	{
+		case QHexTemplate::Value::Constant:
+			return value.constant;
+		case QHexTemplate::Value::FieldValue:
+			return pstruct && value.field < pstruct->fields.size() ? readInteger(pstruct->fields[value.field]) : 0;
+		default:
+			return 0;
+	}
+}
+
+quint64 QHexStructure::readInteger(Node *pnode)
+{
+	uchar buffer[8];
+	int size = QHexTemplate::primitiveSize(pnode->pdef->primitive);
+	if(readData(pnode->offset, size, (char *)buffer) != (std::size_t)size)
+		return 0;
+
+	// Negative counts and offsets count as none
+	return std::max<qint64>(decodeInteger(buffer, pnode->pdef->primitive, pnode->pdef->bigEndian), 0);
+}
+
+void QHexStructure::layout(Node *pnode)
+{
+	if(pnode->laidOut)
+		return;
+	pnode->laidOut = true;
+
+	const QVector<QHexTemplate::Field> &defs = m_template.structAt(pnode->pdef->structIdx).fields;
+
+	// The size of the last field in place is only needed for that of the struct, which waits until asked
+	int last = -1;
+	for(int i = 0; i < defs.size(); i++)
+	{
+		if(defs[i].at.kind == QHexTemplate::Value::None)
+			last = i;
+	}
+
+	quint64 cursor = pnode->offset;
+	for(int i = 0; i < defs.size(); i++)
+	{
+		Node *pfield = new Node(&defs[i], pnode, i, false);
+		pnode->fields.append(pfield);
+		m_decoded++;
+
+		if(defs[i].at.kind != QHexTemplate::Value::None)
+		{
+			pfield->offset = value(defs[i].at, pnode);
+			continue;
+		}
+
+		pfield->offset = cursor;
+		if(i != last)
+			cursor += sizeOf(pfield);
+	}
+}
+
+qint64 QHexStructure::count(Node *parray)
+{
+	if(parray->items >= 0)
+		return parray->items;
+
+	const QHexTemplate::Field &def = *parray->pdef;
+	qint64 item = m_template.itemSize(def);
+	quint64 available = parray->offset < m_dataSize ? m_dataSize - parray->offset : 0;
+
+	// Items of fixed size are counted right away, no more of them than the data holds
+	if(def.count.kind == QHexTemplate::Value::ToEnd)
+	{
+		if(item > 0)
+			parray->items = available / item;
+		else if(item == 0)
+			parray->items = 0;
+	}
+	else
+	{
+		quint64 items = value(def.count, parray->pparent);
+		if(item > 0)
+			items = std::min<quint64>(items, available / item);
+		parray->items = std::min<quint64>(items, std::numeric_limits<qint64>::max());
+	}
+
+	return parray->items;
+}
+
+bool QHexStructure::extendTo(Node *parray, quint64 idx)
+{
+	// Variable sized elements are sized one after the other, each only once
+	qint64 items = count(parray);
+	while((quint64)parray->ends.size() <= idx)
+	{
+		quint64 next = parray->ends.size();
+		if(items >= 0 && next >= (quint64)items)
+			return false;
+
+		quint64 start = next ? parray->ends.last() : parray->offset;
+		if(start >= m_dataSize)
+		{
+			parray->items = next;
+			return false;
+		}
+
+		Node *pelement = parray->elements.object(next);
+		if(!pelement)
+		{
+			pelement = new Node(parray->pdef, parray, next, true);
+			pelement->offset = start;
+			parray->elements.insert(next, pelement);
+			m_decoded++;
+		}
+
+		quint64 size = sizeOf(pelement);
+		parray->ends.append(start + size);
+
+		// Records are decoded from their offset alone, so those after an empty one
+		// would be the same empty record again, up to the end of the data or the count
+		if(!size)
+		{
+			parray->items = parray->ends.size();
+			return next >= idx;
+		}
+	}
+
+	return true;
+}
+
+QHexStructure::Node *QHexStructure::element(Node *parray, quint64 idx)
+{
+	if(Node *pelement = parray->elements.object(idx))
+		return pelement;
+
+	qint64 item = m_template.itemSize(*parray->pdef);
+	qint64 items = count(parray);
+	quint64 offset;
+	if(item >= 0)
+	{
+		if(idx >= (quint64)items)
+			return NULL;
+		offset = parray->offset + idx * item;
+	}
+	else
+	{
+		if(idx && !extendTo(parray, idx - 1))
+			return NULL;
+
+		// Sizing the previous elements may have created this one
+		if(Node *pelement = parray->elements.object(idx))
+			return pelement;
+
+		offset = idx ? parray->ends[idx - 1] : parray->offset;
+		items = parray->items;
+		if((items >= 0 && idx >= (quint64)items) || offset >= m_dataSize)
+			return NULL;
+	}
+
+	Node *pelement = new Node(parray->pdef, parray, idx, true);
+	pelement->offset = offset;
+	parray->elements.insert(idx, pelement);
+	m_decoded++;
+	return pelement;
+}
+
+quint64 QHexStructure::sizeOf(Node *pnode)
+{
+	if(pnode->size >= 0)
+		return pnode->size;
+
+	if(isArray(pnode))
+	{
+		qint64 item = m_template.itemSize(*pnode->pdef);
+		qint64 items = count(pnode);
+		if(item >= 0)
+			pnode->size = items * item;
+		else
+		{
+			if(items)
+				extendTo(pnode, items > 0 ? items - 1 : std::numeric_limits<quint64>::max());
+			pnode->size = pnode->ends.isEmpty() ? 0 : pnode->ends.last() - pnode->offset;
+		}
+	}
+	else if(isStruct(pnode))
+	{
+		qint64 fixedSize = m_template.structAt(pnode->pdef->structIdx).fixedSize;
+		if(fixedSize >= 0)
+			pnode->size = fixedSize;
+		else
+		{
+			// Up to the end of the last field in place, those placed elsewhere do not count
+			layout(pnode);
+			pnode->size = 0;
+			for(int i = pnode->fields.size() - 1; i >= 0; i--)
+			{
+				Node *pfield = pnode->fields[i];
+				if(pfield->pdef->at.kind == QHexTemplate::Value::None)
+				{
+					pnode->size = pfield->offset + sizeOf(pfield) - pnode->offset;
+					break;
+				}
+			}
+		}
+	}
+	else
+		pnode->size = QHexTemplate::primitiveSize(pnode->pdef->primitive);
+
+	return pnode->size;
+}
+
+quint64 QHexStructure::firstItem(Node *parray, quint64 offset)
+{
+	if(offset <= parray->offset)
+		return 0;
+
+	qint64 item = m_template.itemSize(*parray->pdef);
+	if(item >= 0)
+		return item ? (offset - parray->offset) / item : 0;
+
+	// First element ending past offset, sizing more of them while offset lies beyond those known
+	while(parray->ends.isEmpty() || parray->ends.last() <= offset)
+	{
+		if(!extendTo(parray, parray->ends.size()))
+			break;
+	}
+	return std::upper_bound(parray->ends.constBegin(), parray->ends.constEnd(), offset) - parray->ends.constBegin();
+}
+
+void QHexStructure::collect(Node *pnode, quint64 begin, quint64 end, QVector<Field> *pfields, QVector<QHexHighlights::Range> *pranges)
+{
+	if(isLeaf(pnode))
+	{
+		quint64 size = sizeOf(pnode);
+		if(!size || pnode->offset >= end || pnode->offset + size <= begin)
+			return;
+
+		if(pfields)
+			pfields->append(describe(pnode));
+		if(pranges)
+		{
+			QHexHighlights::Range range = {pnode->offset, pnode->offset + size, colorOf(pnode)};
+			pranges->append(range);
+		}
+		return;
+	}
+
+	if(isArray(pnode))
+	{
+		// Elements are visited only from the first one overlapping the range on;
+		// each is dropped from here before the next one may evict it
+		for(quint64 idx = firstItem(pnode, begin); ; idx++)
+		{
+			Node *pelement = element(pnode, idx);
+			if(!pelement || pelement->offset >= end)
+				break;
+			collect(pelement, begin, end, pfields, pranges);
+		}
+		return;
+	}
+
+	// Structs outside the range are skipped, unless fields of theirs lie elsewhere.
+	// Variable sized ones are not sized just for that, sizing one ending in an array
+	// of records would size every record; their fields are skipped one by one.
+	const QHexTemplate::Struct &def = m_template.structAt(pnode->pdef->structIdx);
+	if(!def.follows)
+	{
+		if(pnode->offset >= end)
+			return;
+		if(def.fixedSize >= 0 && pnode->offset + def.fixedSize <= begin)
+			return;
+	}
+
+	layout(pnode);
+	for(int i = 0; i < pnode->fields.size(); i++)
+		collect(pnode->fields[i], begin, end, pfields, pranges);
+}
+
+QRgb QHexStructure::colorOf(const Node *pnode) const
+{
+	// Alternate shades tell neighbouring elements apart
+	if(pnode->element && (pnode->index & 1))
+		return QColor::fromRgba(pnode->pdef->color).darker(110).rgba();
+	return pnode->pdef->color;
+}
+
+QString QHexStructure::path(const Node *pnode) const
+{
+	if(!pnode->pparent)
+		return pnode->pdef->name;
+	if(pnode->element)
+		return QString("%1[%2]").arg(path(pnode->pparent)).arg(pnode->index);
+	return path(pnode->pparent) + "." + pnode->pdef->name;
+}
+
+QString QHexStructure::format(Node *pnode)
+{
+	if(pnode->valueRead)
+		return pnode->value;
+	pnode->valueRead = true;
+
+	const QHexTemplate::Field &def = *pnode->pdef;
+	int primitive = def.primitive;
+	std::size_t size = std::min<quint64>(sizeOf(pnode), PREVIEW_BYTES);
+	QByteArray data(size, Qt::Uninitialized);
+	if(readData(pnode->offset, size, data.data()) != size)
+	{
+		pnode->value = "?";
+		return pnode->value;
+	}
+
+	if(isArray(pnode) && primitive == QHexTemplate::Char)
+	{
+		// Text up to its terminating zero, if any
+		int length = data.indexOf('\0');
+		QByteArray text = length >= 0 ? data.left(length) : data;
+		for(int i = 0; i < text.size(); i++)
+		{
+			if((uchar)text[i] < 0x20 || (uchar)text[i] >= 0x7f)
+				text[i] = '.';
+		}
+		bool cut = length < 0 && sizeOf(pnode) > size;
+		pnode->value = "\"" + QString::fromLatin1(text) + (cut ? "\"..." : "\"");
+	}
+	else if(isArray(pnode))
+		pnode->value = QString::fromLatin1(data.toHex(' ')) + (sizeOf(pnode) > size ? " ..." : "");
+	else if(primitive == QHexTemplate::Char)
+		pnode->value = (uchar)data[0] >= 0x20 && (uchar)data[0] < 0x7f ? QString("'%1'").arg(QChar::fromLatin1(data[0])) : QString::number((uchar)data[0]);
+	else if(primitive == QHexTemplate::Byte)
+		pnode->value = QString("0x%1").arg((uchar)data[0], 2, 16, QChar('0'));
+	else if(primitive == QHexTemplate::F32 || primitive == QHexTemplate::F64)
+	{
+		const uchar *pdata = (const uchar *)data.constData();
+		if(primitive == QHexTemplate::F32)
+		{
+			quint32 bits = def.bigEndian ? qFromBigEndian<quint32>(pdata) : qFromLittleEndian<quint32>(pdata);
+			float number;
+			memcpy(&number, &bits, sizeof(number));
+			pnode->value = QString::number(number, 'g', 9);
+		}
+		else
+		{
+			quint64 bits = def.bigEndian ? qFromBigEndian<quint64>(pdata) : qFromLittleEndian<quint64>(pdata);
+			double number;
+			memcpy(&number, &bits, sizeof(number));
+			pnode->value = QString::number(number, 'g', 17);
+		}
+	}
+	else
+	{
+		qint64 number = decodeInteger((const uchar *)data.constData(), primitive, def.bigEndian);
+		bool isSigned = primitive >= QHexTemplate::I8 && primitive <= QHexTemplate::I64;
+		pnode->value = isSigned ? QString::number(number) : QString::number((quint64)number);
+
+		QString name = m_template.enumName(def.enumIdx, number);
+		if(!name.isEmpty())
+			pnode->value += " (" + name + ")";
+		else if(!isSigned && (quint64)number > 9)
+			pnode->value += QString(" (0x%1)").arg((quint64)number, 0, 16);
+	}
+
+	return pnode->value;
+}
+
+QHexStructure::Field QHexStructure::describe(Node *pnode)
+{
+	Field field;
+	field.offset = pnode->offset;
+	field.path = path(pnode);
+	field.type = m_template.typeName(*pnode->pdef);
+	if(pnode->element)
+		field.type = field.type.left(field.type.indexOf('['));
+
+	field.color = colorOf(pnode);
+
+	field.children = 0;
+	if(isLeaf(pnode))
+	{
+		field.length = sizeOf(pnode);
+		field.value = format(pnode);
+	}
+	else if(isArray(pnode))
+	{
+		// Arrays of variable sized records are not sized just to be shown, their length is that found so far
+		field.children = count(pnode);
+		if(pnode->size < 0 && m_template.itemSize(*pnode->pdef) < 0)
+			field.length = pnode->ends.isEmpty() ? 0 : pnode->ends.last() - pnode->offset;
+		else
+			field.length = sizeOf(pnode);
+	}
+	else
+	{
+		field.children = m_template.structAt(pnode->pdef->structIdx).fields.size();
+		field.length = sizeOf(pnode);
+	}
+
+	return field;
+}
+
+QHexStructure::Node *QHexStructure::find(const QString &path)
+{
+	Node *pnode = rootNode();
+	if(!pnode || !path.startsWith(pnode->pdef->name))
+		return NULL;
+
+	int pos = pnode->pdef->name.size();
+	while(pnode && pos < path.size())
+	{
+		if(path[pos] == '[' && isArray(pnode))
+		{
+			int close = path.indexOf(']', pos);
+			bool ok = false;
+			quint64 idx = path.mid(pos + 1, close - pos - 1).toULongLong(&ok);
+			if(close < 0 || !ok)
+				return NULL;
+			pnode = element(pnode, idx);
+			pos = close + 1;
+		}
+		else if(path[pos] == '.' && isStruct(pnode))
+		{
+			int next = pos + 1;
+			while(next < path.size() && path[next] != '.' && path[next] != '[')
+				next++;
+			QString name = path.mid(pos + 1, next - pos - 1);
+
+			layout(pnode);
+			Node *pfield = NULL;
+			for(int i = 0; i < pnode->fields.size() && !pfield; i++)
+			{
+				if(pnode->fields[i]->pdef->name == name)
+					pfield = pnode->fields[i];
+			}
+			pnode = pfield;
+			pos = next;
+		}
+		else
+			return NULL;
+	}
+
+	return pnode;
+}
+
+QVector<QHexStructure::Field> QHexStructure::fields(std::size_t begin, std::size_t end)
+{
+	QVector<Field> res;
+	if(Node *proot = rootNode())
+		collect(proot, begin, end, &res, NULL);
+	return res;
+}
+
+void QHexStructure::ranges(std::size_t begin, std::size_t end, QVector<QHexHighlights::Range> &res)
+{
+	if(Node *proot = rootNode())
+		collect(proot, begin, end, NULL, &res);
+}
+
+bool QHexStructure::fieldAt(std::size_t offset, Field &field)
+{
+	QVector<Field> res = fields(offset, offset + 1);
+	if(res.isEmpty())
+		return false;
+
+	// Fields placed with "at" are laid over the others
+	field = res.last();
+	return true;
+}
+
+QHexStructure::Field QHexStructure::root()
+{
+	Node *proot = rootNode();
+	if(!proot)
+	{
+		Field field = {0, 0, QString(), QString(), QString(), 0, 0};
+		return field;
+	}
+	return describe(proot);
+}
+
+QVector<QHexStructure::Field> QHexStructure::children(const QString &path, quint64 first, quint64 count)
+{
+	QVector<Field> res;
+	Node *pnode = find(path);
+	if(!pnode || isLeaf(pnode))
+		return res;
+
+	if(isArray(pnode))
+	{
+		for(quint64 idx = first; idx - first < count; idx++)
+		{
+			Node *pelement = element(pnode, idx);
+			if(!pelement)
+				break;
+			res.append(describe(pelement));
+		}
+	}
+	else
+	{
+		layout(pnode);
+		for(quint64 idx = first; idx < (quint64)pnode->fields.size() && idx - first < count; idx++)
+			res.append(describe(pnode->fields[idx]));
+	}
+
+	return res;
+}
@@ -0,0 +1,317 @@
+#include "../include/QHexTemplate.h"
+
+#include <QJsonDocument>
+#include <QJsonArray>
+
+// Fields without a color of their own take the next of these, so neighbours differ
+static const QRgb FIELD_COLORS[] =
+{
+	0xffc6e2ff, 0xffd4f0c8, 0xffffe4c4, 0xffe8d6ff, 0xffffd6e0, 0xffd0f0f0
+};
+
+static const char *PRIMITIVE_NAMES[] =
+{
+	"u8", "u16", "u32", "u64",
+	"i8", "i16", "i32", "i64",
+	"f32", "f64",
+	"char", "byte"
+};
+
+
+QHexTemplate::QHexTemplate():
+m_bigEndian(false),
+m_valid(false)
+{
+}
+
+bool QHexTemplate::fail(const QString &error)
+{
+	m_error = error;
+	m_valid = false;
+	return false;
+}
+
+bool QHexTemplate::load(const QByteArray &json)
+{
+	m_structs.clear();
+	m_structIdx.clear();
+	m_enums.clear();
+	m_enumIdx.clear();
+	m_error.clear();
+	m_valid = false;
+
+	QJsonParseError parseError;
+	QJsonDocument doc = QJsonDocument::fromJson(json, &parseError);
+	if(!doc.isObject())
+		return fail(parseError.errorString());
+
+	QJsonObject description = doc.object();
+	m_bigEndian = description.value("endian").toString() == "big";
+
+	QJsonObject enums = description.value("enums").toObject();
+	for(QJsonObject::const_iterator it = enums.constBegin(); it != enums.constEnd(); ++it)
+	{
+		QMap<qint64, QString> names;
+		QJsonObject values = it.value().toObject();
+		for(QJsonObject::const_iterator value = values.constBegin(); value != values.constEnd(); ++value)
+		{
+			bool ok = false;
+			qint64 number = value.key().toLongLong(&ok, 0);
+			if(!ok)
+				return fail(QString("Enum %1: `%2` is not a number").arg(it.key(), value.key()));
+			names.insert(number, value.value().toString());
+		}
+		m_enumIdx.insert(it.key(), m_enums.size());
+		m_enums.append(names);
+	}
+
+	// Structs may refer to each other in any order, so all names are known first
+	QJsonObject structs = description.value("structs").toObject();
+	for(QJsonObject::const_iterator it = structs.constBegin(); it != structs.constEnd(); ++it)
+	{
+		Struct def;
+		def.name = it.key();
+		def.fixedSize = -1;
+		def.follows = false;
+		m_structIdx.insert(def.name, m_structs.size());
+		m_structs.append(def);
+	}
+
+	for(int idx = 0; idx < m_structs.size(); idx++)
+	{
+		QJsonArray fields = structs.value(m_structs[idx].name).toArray();
+		for(int i = 0; i < fields.size(); i++)
+		{
+			Field field;
+			if(!parseField(fields[i].toObject(), &m_structs[idx], i, field))
+				return false;
+			m_structs[idx].follows |= field.at.kind != Value::None;
+			m_structs[idx].fields.append(field);
+		}
+	}
+
+	QJsonValue root = description.value("root");
+	QJsonObject rootObject = root.isString() ? QJsonObject() : root.toObject();
+	if(root.isString())
+		rootObject.insert("type", root);
+	if(!rootObject.contains("name"))
+		rootObject.insert("name", QString("root"));
+	if(!parseField(rootObject, NULL, 0, m_root))
+		return false;
+
+	QVector<int> state(m_structs.size(), 0);
+	for(int idx = 0; idx < m_structs.size(); idx++)
+	{
+		if(!computeSize(idx, state))
+			return false;
+	}
+	if(m_root.array && itemSize(m_root) == 0)
+		return fail(QString("%1: array of items taking no room").arg(m_root.name));
+
+	m_valid = true;
+	return true;
+}
+
+bool QHexTemplate::parseField(const QJsonObject &object, const Struct *pstruct, int colorIdx, Field &field)
+{
+	field.name = object.value("name").toString();
+	QString context = pstruct ? pstruct->name + "." + field.name : field.name;
+	if(field.name.isEmpty())
+		return fail(QString("%1: field %2 has no name").arg(pstruct ? pstruct->name : QString("root")).arg(colorIdx));
+
+	for(int i = 0; pstruct && i < pstruct->fields.size(); i++)
+	{
+		if(pstruct->fields[i].name == field.name)
+			return fail(QString("%1: defined twice").arg(context));
+	}
+
+	QString type = object.value("type").toString();
+	field.primitive = Struct;
+	field.structIdx = -1;
+	for(int i = 0; i < (int)(sizeof(PRIMITIVE_NAMES) / sizeof(PRIMITIVE_NAMES[0])); i++)
+	{
+		if(type == PRIMITIVE_NAMES[i])
+			field.primitive = i;
+	}
+	if(field.primitive == Struct)
+	{
+		field.structIdx = m_structIdx.value(type, -1);
+		if(field.structIdx < 0)
+			return fail(QString("%1: unknown type `%2`").arg(context, type));
+	}
+
+	field.enumIdx = -1;
+	if(object.contains("enum"))
+	{
+		field.enumIdx = m_enumIdx.value(object.value("enum").toString(), -1);
+		if(field.enumIdx < 0 || !isInteger(field.primitive))
+			return fail(QString("%1: unknown enum or not an integer").arg(context));
+	}
+
+	QString endian = object.value("endian").toString();
+	field.bigEndian = endian.isEmpty() ? m_bigEndian : endian == "big";
+
+	if(!parseValue(object.value("count"), pstruct, true, field.count))
+		return fail(QString("%1: bad count, %2").arg(context, m_error));
+	if(!parseValue(object.value("at"), pstruct, false, field.at))
+		return fail(QString("%1: bad offset, %2").arg(context, m_error));
+	field.array = field.count.kind != Value::None;
+
+	QColor color(object.value("color").toString());
+	field.color = color.isValid() ? color.rgba() : FIELD_COLORS[colorIdx % (sizeof(FIELD_COLORS) / sizeof(FIELD_COLORS[0]))];
+	return true;
+}
+
+bool QHexTemplate::parseValue(const QJsonValue &value, const Struct *pstruct, bool toEnd, Value &res)
+{
+	res.kind = Value::None;
+	res.constant = 0;
+	res.field = -1;
+
+	if(value.isUndefined())
+		return true;
+
+	if(value.isDouble() && value.toDouble() >= 0)
+	{
+		res.kind = Value::Constant;
+		res.constant = value.toDouble();
+		return true;
+	}
+
+	QString text = value.toString();
+	if(text == "*" && toEnd)
+	{
+		res.kind = Value::ToEnd;
+		return true;
+	}
+
+	bool ok = false;
+	res.constant = text.toULongLong(&ok, 0);
+	if(ok)
+	{
+		res.kind = Value::Constant;
+		return true;
+	}
+
+	// Only earlier integers of the same struct are known when the field is reached
+	for(int i = 0; pstruct && i < pstruct->fields.size(); i++)
+	{
+		const Field &field = pstruct->fields[i];
+		if(field.name == text && isInteger(field.primitive) && !field.array)
+		{
+			res.kind = Value::FieldValue;
+			res.field = i;
+			return true;
+		}
+	}
+
+	m_error = QString("`%1` is no earlier integer field").arg(text);
+	return false;
+}
+
+bool QHexTemplate::computeSize(int idx, QVector<int> &state)
+{
+	// 0 not visited, 1 being computed, 2 done
+	if(state[idx] == 2)
+		return true;
+	if(state[idx] == 1)
+		return fail(QString("%1: structs must not contain themselves").arg(m_structs[idx].name));
+	state[idx] = 1;
+
+	qint64 size = 0;
+	const QVector<Field> &fields = m_structs[idx].fields;
+	for(int i = 0; i < fields.size(); i++)
+	{
+		const Field &field = fields[i];
+		if(field.primitive == Struct && !computeSize(field.structIdx, state))
+			return false;
+		// Their elements would all sit at the same offset, as many as the count says
+		if(field.array && itemSize(field) == 0)
+			return fail(QString("%1.%2: array of items taking no room").arg(m_structs[idx].name, field.name));
+		if(field.at.kind != Value::None)
+			continue;
+
+		qint64 item = itemSize(field);
+		if(size < 0 || item < 0 || (field.array && field.count.kind != Value::Constant))
+			size = -1;
+		else
+			size += item * (field.array ? field.count.constant : 1);
+	}
+
+	m_structs[idx].fixedSize = size;
+	state[idx] = 2;
+	return true;
+}
+
+bool QHexTemplate::isValid() const
+{
+	return m_valid;
+}
+
+QString QHexTemplate::errorString() const
+{
+	return m_error;
+}
+
+const QHexTemplate::Field &QHexTemplate::root() const
+{
+	return m_root;
+}
+
+const QHexTemplate::Struct &QHexTemplate::structAt(int idx) const
+{
+	return m_structs[idx];
+}
+
+qint64 QHexTemplate::itemSize(const Field &field) const
+{
+	if(field.primitive == Struct)
+		return m_structs[field.structIdx].fixedSize;
+	return primitiveSize(field.primitive);
+}
+
+QString QHexTemplate::typeName(const Field &field) const
+{
+	QString name = field.primitive == Struct ? m_structs[field.structIdx].name : QString(PRIMITIVE_NAMES[field.primitive]);
+	if(!field.array)
+		return name;
+
+	switch(field.count.kind)
+	{
+		case Value::Constant:
+			return QString("%1[%2]").arg(name).arg(field.count.constant);
+		case Value::ToEnd:
+			return name + "[*]";
+		default:
+			return name + "[]";
+	}
+}
+
+QString QHexTemplate::enumName(int enumIdx, qint64 value) const
+{
+	if(enumIdx < 0 || enumIdx >= m_enums.size())
+		return QString();
+	return m_enums[enumIdx].value(value);
+}
+
+int QHexTemplate::primitiveSize(int primitive)
+{
+	switch(primitive)
+	{
+		case U8: case I8: case Char: case Byte:
+			return 1;
+		case U16: case I16:
+			return 2;
+		case U32: case I32: case F32:
+			return 4;
+		case U64: case I64: case F64:
+			return 8;
+		default:
+			return -1;
+	}
+}
+
+bool QHexTemplate::isInteger(int primitive)
+{
+	return primitive >= U8 && primitive <= I64;
+}
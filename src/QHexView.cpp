@@ -1,26 +1,150 @@
 #include "../include/QHexView.h"
+#include "../include/QHexFormatter.h"
+#include "../include/QHexExport.h"
+#include "../include/QHexAggregate.h"
+#include "../include/QHexSearch.h"
+#include "../include/QHexDiff.h"
+#include "../include/QHexStructure.h"
+#include "../include/QHexOverview.h"
+#include "../include/QHexOverviewBar.h"
+#include "../include/QHexSidecar.h"
 #include <QScrollBar>
 #include <QPainter>
 #include <QSize>
 #include <QPaintEvent>
 #include <QKeyEvent>
+#include <QResizeEvent>
+#include <QWheelEvent>
 #include <QClipboard>
 #include <QApplication>
+#include <QVector>
+#include <QTimer>
+#include <QThread>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QElapsedTimer>
+#include <QHelpEvent>
+#include <QToolTip>
 
 #include <QDebug>
 
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+
+#include <zlib.h>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <sys/uio.h>
+#endif
 
-const int MIN_HEXCHARS_IN_LINE = 47;
 const int GAP_ADR_HEX = 10;
 const int GAP_HEX_ASCII = 16;
 const int MIN_BYTES_PER_LINE = 16;
 const int ADR_LENGTH = 10;
+const std::size_t DEFAULT_COPY_LIMIT = 16 * 1024 * 1024;
+const int DEFAULT_POLL_INTERVAL = 1000;
+
+// Above this many lines the scrollbar range is scaled, the exact first line is kept in m_firstLine
+const int SCROLL_MAX = 1 << 30;
+
+// Glyph atlas cells: one per byte value, printable ASCII or '.'. Hex digits are
+// printable, so formatted text maps straight to cells.
+const int GLYPH_COUNT = 256;
+
+// Gzip storage: file reads, inflate window, cached pages and how often indexing progress is told
+const std::size_t GZIP_CHUNK = 64 * 1024;
+const std::size_t GZIP_WINDOW = 32 * 1024;
+const std::size_t GZIP_PAGE = 64 * 1024;
+const int GZIP_CACHED_PAGES = 64;
+const quint64 GZIP_NOTIFY_STEP = 1024 * 1024;
+
+// statsUpdated and the overlay follow the stats at this interval (msec)
+const int STATS_INTERVAL = 500;
+const int STATS_OVERLAY_COLUMNS = 60;
+const int STATS_OVERLAY_LINES = 16;
+
+
+// Forwards storage notifications, which may come from worker threads, to the GUI
+// thread. Once the view lets go of the storage the listener is detached and
+// drops them, the storage may outlive the view's interest in a job.
+class QHexView::StorageListener: public QHexView::DataStorage::Listener
+{
+	public:
+		StorageListener(QHexView *pview): m_pview(pview) {}
+
+		void detach()
+		{
+			QMutexLocker lock(&m_mtx);
+			m_pview = NULL;
+		}
+
+		virtual void dataReady(std::size_t position, std::size_t length)
+		{
+			QMutexLocker lock(&m_mtx);
+			if(m_pview)
+				QMetaObject::invokeMethod(m_pview, "slotDataReady", Qt::QueuedConnection,
+					Q_ARG(qulonglong, position), Q_ARG(qulonglong, length));
+		}
+
+		virtual void dataChanged(std::size_t position, std::size_t length)
+		{
+			QMutexLocker lock(&m_mtx);
+			if(m_pview)
+				QMetaObject::invokeMethod(m_pview, "slotDataChanged", Qt::QueuedConnection,
+					Q_ARG(qulonglong, position), Q_ARG(qulonglong, length));
+		}
+	private:
+		QMutex      m_mtx;
+		QHexView   *m_pview;
+};
+
+// Deletes a storage once nothing shares it, its listener is kept alive until then
+struct QHexView::StorageDeleter
+{
+	StorageDeleter(const QSharedPointer<StorageListener> &plistener): m_plistener(plistener) {}
+
+	void operator()(DataStorage *pdata)
+	{
+		delete pdata;
+	}
+
+	QSharedPointer<StorageListener>   m_plistener;
+};
 
 
 QHexView::QHexView(QWidget *parent):
 QAbstractScrollArea(parent),
-m_pdata(NULL)
+m_pedit(NULL),
+m_lineBytes(0),
+m_scrollX(0),
+m_addressLength(ADR_LENGTH),
+m_copyLimit(DEFAULT_COPY_LIMIT),
+m_insertMode(false),
+m_typingPos(std::numeric_limits<std::size_t>::max()),
+m_follow(false),
+m_followTail(true),
+m_ppollTimer(new QTimer(this)),
+m_pwatcher(new QFileSystemWatcher(this)),
+m_poverviewBar(new QHexOverviewBar(this)),
+m_psidecar(NULL),
+m_statsEnabled(false),
+m_statsOverlay(false),
+m_pstatsTimer(new QTimer(this)),
+m_statsFrames(0),
+m_firstLine(0),
+m_scrollSync(false),
+m_hasActionLine(false),
+m_atlasRatio(1)
 {
 	setFont(QFont("Courier", 10));
 
@@ -32,567 +156,3836 @@ m_pdata(NULL)
 	m_charHeight = fontMetrics().height();
 
 	m_posAddr = 0;
-	m_posHex = ADR_LENGTH * m_charWidth + GAP_ADR_HEX;
-	m_posAscii = m_posHex + MIN_HEXCHARS_IN_LINE * m_charWidth + GAP_HEX_ASCII;
-	m_bytesPerLine = MIN_BYTES_PER_LINE;
+	m_layout.setGeometry(m_charWidth, m_addressLength * m_charWidth + GAP_ADR_HEX, GAP_HEX_ASCII);
+	m_layout.setBytesPerLine(MIN_BYTES_PER_LINE);
 
-	setMinimumWidth(m_posAscii + (MIN_BYTES_PER_LINE * m_charWidth));
+	setMinimumWidth(m_layout.asciiRight());
 
 	setFocusPolicy(Qt::StrongFocus);
+
+	connect(verticalScrollBar(), SIGNAL(actionTriggered(int)), SLOT(slotScrollAction(int)));
+
+	// File notifications arrive right away but can be missed (network file systems,
+	// replaced files), the timer catches up with those
+	m_ppollTimer->setInterval(DEFAULT_POLL_INTERVAL);
+	connect(m_ppollTimer, SIGNAL(timeout()), SLOT(slotPoll()));
+	connect(m_pwatcher, SIGNAL(fileChanged(const QString &)), SLOT(slotPoll()));
+
+	m_poverviewBar->hide();
+	connect(m_poverviewBar, SIGNAL(offsetClicked(qulonglong)), SLOT(slotOverviewClicked(qulonglong)));
+
+	m_pstatsTimer->setInterval(STATS_INTERVAL);
+	connect(m_pstatsTimer, SIGNAL(timeout()), SLOT(slotStatsTimer()));
 }
 
 
 QHexView::~QHexView()
 {
-	if(m_pdata)
-		delete m_pdata;
+	cancelJobs();
+	releaseData();
+	closeIndex();
 }
 
 void QHexView::setData(QHexView::DataStorage *pData)
 {
-	QMutexLocker lock(&m_dataMtx);
+	cancelJobs();
+	releaseData();
 
-	verticalScrollBar()->setValue(0);
-	if(m_pdata)
-		delete m_pdata;
-	m_pdata = pData;
+	m_firstLine = 0;
+	if(pData)
+	{
+		m_plistener = QSharedPointer<StorageListener>(new StorageListener(this));
+		m_pdata = DataStoragePtr(pData, StorageDeleter(m_plistener));
+		m_pdata->setListener(m_plistener.data());
+		m_pdata->setStats(activeStats());
+	}
+	m_pedit = dynamic_cast<DataStorageEditable *>(pData);
+	m_typingPos = std::numeric_limits<std::size_t>::max();
 	m_cursorPos = 0;
 	resetSelection(0);
+	m_highlights.clear();
+	closeIndex();
+	updatePositions();
+	viewport()->update();
+	watchData();
+	startOverview();
+
+	emit cursorMoved(0);
+	emit selectionChanged(0, 0);
 }
 
 
 void QHexView::showFromOffset(std::size_t offset)
 {
-	QMutexLocker lock(&m_dataMtx);
-
 	if(m_pdata && offset < m_pdata->size())
 	{
-		updatePositions();
-
+		std::size_t prevCursor = m_cursorPos;
 		setCursorPos(offset * 2);
 
-		int cursorY = m_cursorPos / (2 * m_bytesPerLine);
-
-		verticalScrollBar() -> setValue(cursorY);
-		viewport()->update();
+		setFirstLine(m_layout.line(offset));
+		updateChanges(prevCursor, m_selectBegin, m_selectEnd);
 	}
 }
 
 void QHexView::clear()
 {
-	QMutexLocker lock(&m_dataMtx);
+	cancelJobs();
+	releaseData();
 
-	if (m_pdata)
-	{
-		delete m_pdata;
-		m_pdata = NULL;
-	}
-	verticalScrollBar()->setValue(0);
+	m_highlights.clear();
+	closeIndex();
+	m_firstLine = 0;
+	updateScrollBar();
 	viewport()->update();
+	watchData();
+	startOverview();
 }
 
 
-QSize QHexView::fullSize() const
+QHexExport *QHexView::createExport()
 {
-	if(!m_pdata)
-		return QSize(0, 0);
-
-	std::size_t width = m_posAscii + (m_bytesPerLine * m_charWidth);
-	std::size_t height = m_pdata->size() / m_bytesPerLine;
-	if(m_pdata->size() % m_bytesPerLine)
-		height++;
+	QHexExport *pexport = new QHexExport(m_pdata, this);
+	pexport->setBytesPerLine(m_layout.bytesPerLine());
+	m_jobs.removeAll(QPointer<QHexJob>());
+	m_jobs.append(pexport);
+	return pexport;
+}
 
-	height *= m_charHeight;
+QHexAggregate *QHexView::createAggregate()
+{
+	QHexAggregate *paggregate = new QHexAggregate(m_pdata, this);
+	m_jobs.removeAll(QPointer<QHexJob>());
+	m_jobs.append(paggregate);
+	return paggregate;
+}
 
-	return QSize(width, height);
+QHexSearch *QHexView::createSearch()
+{
+	QHexSearch *psearch = new QHexSearch(m_pdata, this);
+	m_jobs.removeAll(QPointer<QHexJob>());
+	m_jobs.append(psearch);
+	return psearch;
 }
 
-void QHexView::updatePositions()
+void QHexView::setSearch(QHexSearch *psearch)
 {
-#if QT_VERSION >= 0x051100
-	m_charWidth = fontMetrics().horizontalAdvance(QLatin1Char('9'));
-#else
-	m_charWidth = fontMetrics().width(QLatin1Char('9'));
-#endif
-	m_charHeight = fontMetrics().height();
+	if(m_psearch)
+		disconnect(m_psearch, 0, viewport(), 0);
 
-	int serviceSymbolsWidth = ADR_LENGTH * m_charWidth + GAP_ADR_HEX + GAP_HEX_ASCII;
+	m_psearch = psearch;
+	if(m_psearch)
+		connect(m_psearch, SIGNAL(matchesFound(qulonglong)), viewport(), SLOT(update()));
+	viewport()->update();
+}
 
-	m_bytesPerLine = (width() - serviceSymbolsWidth) / (4 * m_charWidth) - 1; // 4 symbols per byte
+QHexDiff *QHexView::createDiff(QHexView *pother)
+{
+	QHexDiff *pdiff = new QHexDiff(m_pdata, pother->m_pdata, this);
+	m_jobs.removeAll(QPointer<QHexJob>());
+	m_jobs.append(pdiff);
+	pother->m_jobs.removeAll(QPointer<QHexJob>());
+	pother->m_jobs.append(pdiff);
+	return pdiff;
+}
 
-	m_posAddr = 0;
-	m_posHex = ADR_LENGTH * m_charWidth + GAP_ADR_HEX;
-	m_posAscii = m_posHex + (m_bytesPerLine * 3 - 1) * m_charWidth + GAP_HEX_ASCII;
+void QHexView::setDiff(QHexDiff *pdiff)
+{
+	if(m_pdiff)
+		disconnect(m_pdiff, 0, viewport(), 0);
 
-	QSize areaSize = viewport()->size();
-	QSize  widgetSize = fullSize();
-	verticalScrollBar()->setPageStep(areaSize.height() / m_charHeight);
-	verticalScrollBar()->setRange(0, (widgetSize.height() - areaSize.height()) / m_charHeight + 1);
+	m_pdiff = pdiff;
+	if(m_pdiff)
+		connect(m_pdiff, SIGNAL(regionsFound(qulonglong)), viewport(), SLOT(update()));
+	viewport()->update();
 }
 
-void QHexView::paintEvent(QPaintEvent *event)
+QHexStructure *QHexView::createStructure(const QHexTemplate &tmpl)
 {
-	QMutexLocker lock(&m_dataMtx);
+	QHexStructure *pstructure = new QHexStructure(m_pdata, tmpl, this);
+	m_jobs.removeAll(QPointer<QHexJob>());
+	m_jobs.append(pstructure);
+	return pstructure;
+}
 
-	if(!m_pdata)
-		return;
-	QPainter painter(viewport());
+void QHexView::setStructure(QHexStructure *pstructure)
+{
+	m_pstructure = pstructure;
+	viewport()->update();
+}
 
-	updatePositions();
+std::size_t QHexView::firstVisibleLine() const
+{
+	return m_firstLine;
+}
 
-	QSize areaSize = viewport()->size();
-	QSize  widgetSize = fullSize();
+void QHexView::setFirstVisibleLine(qulonglong line)
+{
+	setFirstLine(line);
+}
 
-	int firstLineIdx = verticalScrollBar() -> value();
+bool QHexView::findNext()
+{
+	if(!m_pdata || !m_psearch)
+		return false;
 
-	int lastLineIdx = firstLineIdx + areaSize.height() / m_charHeight;
-    if((unsigned int)lastLineIdx > m_pdata->size() / m_bytesPerLine)
-	{
-		lastLineIdx = m_pdata->size() / m_bytesPerLine;
-		if(m_pdata->size() % m_bytesPerLine)
-			lastLineIdx++;
-	}
+	// The search continues after the selected match, and wraps around at the end
+	std::size_t from = (m_selectEnd > m_selectBegin) ? selectionOffset() + 1 : m_cursorPos / 2;
+	QHexSearch::Match match;
+	if(!m_psearch->next(from, match) && !m_psearch->next(0, match))
+		return false;
 
-	painter.fillRect(event->rect(), this->palette().color(QPalette::Base));
+	selectMatch(match.offset, match.length);
+	return true;
+}
 
-	QColor addressAreaColor = QColor(0xd4, 0xd4, 0xd4, 0xff);
-	painter.fillRect(QRect(m_posAddr, event->rect().top(), m_posHex - GAP_ADR_HEX + 2 , height()), addressAreaColor);
+bool QHexView::findPrevious()
+{
+	if(!m_pdata || !m_psearch)
+		return false;
 
-	int linePos = m_posAscii - (GAP_HEX_ASCII / 2);
-	painter.setPen(Qt::gray);
+	std::size_t from = (m_selectEnd > m_selectBegin) ? selectionOffset() : m_cursorPos / 2;
+	QHexSearch::Match match;
+	if(!m_psearch->previous(from, match) && !m_psearch->previous(std::numeric_limits<std::size_t>::max(), match))
+		return false;
 
-	painter.drawLine(linePos, event->rect().top(), linePos, height());
+	selectMatch(match.offset, match.length);
+	return true;
+}
 
-	painter.setPen(Qt::black);
+void QHexView::selectMatch(std::size_t offset, std::size_t length)
+{
+	std::size_t prevCursor = m_cursorPos;
+	std::size_t prevBegin = m_selectBegin;
+	std::size_t prevEnd = m_selectEnd;
 
-	int yPosStart = m_charHeight;
+	setCursorPos(offset * 2);
+	m_selectInit = m_selectBegin = offset * 2;
+	m_selectEnd = (offset + length) * 2;
 
-	QBrush def = painter.brush();
-    QBrush selected = QBrush(QColor(0x6d, 0x9e, 0xff, 0xff));
-    QByteArray data = m_pdata->getData(firstLineIdx * m_bytesPerLine, (lastLineIdx - firstLineIdx) * m_bytesPerLine);
+	ensureVisible();
+	updateChanges(prevCursor, prevBegin, prevEnd);
+}
 
-	for (int lineIdx = firstLineIdx, yPos = yPosStart;  lineIdx < lastLineIdx; lineIdx += 1, yPos += m_charHeight)
+void QHexView::cancelJobs()
+{
+	// Jobs stop after the read they are in and let go of the data
+	for(int i = 0; i < m_jobs.size(); i++)
 	{
-		QString address = QString("%1").arg(lineIdx * m_bytesPerLine, 10, 16, QChar('0'));
-		painter.drawText(m_posAddr, yPos, address);
-
-		for(int xPos = m_posHex, i=0; i< m_bytesPerLine && ((lineIdx - firstLineIdx) * m_bytesPerLine + i) < data.size(); i++, xPos += 3 * m_charWidth)
-		{
-			std::size_t pos = (lineIdx * m_bytesPerLine + i) * 2;
-			if(pos >= m_selectBegin && pos < m_selectEnd)
-			{
-				painter.setBackground(selected);
-				painter.setBackgroundMode(Qt::OpaqueMode);
-			}
+		if(m_jobs[i])
+			m_jobs[i]->releaseData();
+	}
+	m_jobs.clear();
 
-			QString val = QString::number((data.at((lineIdx - firstLineIdx) * m_bytesPerLine + i) & 0xF0) >> 4, 16);
-			painter.drawText(xPos, yPos, val);
+	// Results of a search, diff or structure refer to the data they ran on
+	setSearch(NULL);
+	setDiff(NULL);
+	setStructure(NULL);
+}
 
+void QHexView::releaseData()
+{
+	if(m_plistener)
+		m_plistener->detach();
 
-			if((pos+1) >= m_selectBegin && (pos+1) < m_selectEnd)
-			{
-				painter.setBackground(selected);
-				painter.setBackgroundMode(Qt::OpaqueMode);
-			}
-			else
-			{
-				painter.setBackground(def);
-				painter.setBackgroundMode(Qt::OpaqueMode);
-			}
+	// The stats belong to the view, a storage still shared with a job must not record into them
+	if(m_pdata)
+		m_pdata->setStats(NULL);
 
-			val = QString::number((data.at((lineIdx - firstLineIdx) * m_bytesPerLine + i) & 0xF), 16);
-			painter.drawText(xPos+m_charWidth, yPos, val);
+	m_pdata.clear();
+	m_plistener.clear();
+	m_pedit = NULL;
+}
 
-			painter.setBackground(def);
-			painter.setBackgroundMode(Qt::OpaqueMode);
+void QHexView::setFollow(bool follow, bool scrollToTail)
+{
+	m_follow = follow;
+	m_followTail = scrollToTail;
+	watchData();
 
-		}
+	if(m_follow)
+		slotPoll();
+}
 
-		for (int xPosAscii = m_posAscii, i=0; ((lineIdx - firstLineIdx) * m_bytesPerLine + i) < data.size() && (i < m_bytesPerLine); i++, xPosAscii += m_charWidth)
-		{
-			char ch = data[(lineIdx - firstLineIdx) * (uint)m_bytesPerLine + i];
-			if ((ch < 0x20) || (ch > 0x7e))
-			ch = '.';
+bool QHexView::follow() const
+{
+	return m_follow;
+}
 
-			painter.drawText(xPosAscii, yPos, QString(ch));
-		}
+void QHexView::setPollInterval(int msec)
+{
+	m_ppollTimer->setInterval(msec);
+}
 
-	}
+void QHexView::watchData()
+{
+	if(!m_pwatcher->files().isEmpty())
+		m_pwatcher->removePaths(m_pwatcher->files());
 
-	if (hasFocus())
+	if(!m_follow || !m_pdata)
 	{
-		int x = (m_cursorPos % (2 * m_bytesPerLine));
-		int y = m_cursorPos / (2 * m_bytesPerLine);
-		y -= firstLineIdx;
-		int cursorX = (((x / 2) * 3) + (x % 2)) * m_charWidth + m_posHex;
-		int cursorY = y * m_charHeight + 4;
-		painter.fillRect(cursorX, cursorY, 2, m_charHeight, this->palette().color(QPalette::WindowText));
+		m_ppollTimer->stop();
+		return;
 	}
+
+	QString fileName = m_pdata->fileName();
+	if(!fileName.isEmpty())
+		m_pwatcher->addPath(fileName);
+	m_ppollTimer->start();
 }
 
+void QHexView::slotPoll()
+{
+	if(!m_follow || !m_pdata)
+		return;
+
+	// Changes are reported through the listener and handled in slotDataChanged
+	m_pdata->refresh();
 
-void QHexView::keyPressEvent(QKeyEvent *event)
+	// The watch is lost when the file gets replaced, e.g. by log rotation
+	QString fileName = m_pdata->fileName();
+	if(!fileName.isEmpty() && m_pwatcher->files().isEmpty() && QFileInfo(fileName).exists())
+		m_pwatcher->addPath(fileName);
+}
+
+void QHexView::slotDataChanged(qulonglong position, qulonglong length)
 {
-	QMutexLocker lock(&m_dataMtx);
+	if(!m_pdata)
+		return;
 
-	bool setVisible = false;
+	// The scrollbar still has the range of the previous size
+	bool atTail = verticalScrollBar()->value() >= verticalScrollBar()->maximum();
 
-/*****************************************************************************/
-/* Cursor movements */
-/*****************************************************************************/
-	if(event->matches(QKeySequence::MoveToNextChar))
-	{
-		setCursorPos(m_cursorPos + 1);
-		resetSelection(m_cursorPos);
-		setVisible = true;
-	}
-	if(event->matches(QKeySequence::MoveToPreviousChar))
-	{
-		setCursorPos(m_cursorPos - 1);
-		resetSelection(m_cursorPos);
-		setVisible = true;
-	}
-	if(event->matches(QKeySequence::MoveToEndOfLine))
-	{
-		setCursorPos(m_cursorPos | ((m_bytesPerLine * 2) - 1));
-		resetSelection(m_cursorPos);
-		setVisible = true;
-	}
-	if(event->matches(QKeySequence::MoveToStartOfLine))
-	{
-		setCursorPos(m_cursorPos | (m_cursorPos % (m_bytesPerLine * 2)));
-		resetSelection(m_cursorPos);
-		setVisible = true;
-	}
-	if(event->matches(QKeySequence::MoveToPreviousLine))
-	{
-		setCursorPos(m_cursorPos - m_bytesPerLine * 2);
-		resetSelection(m_cursorPos);
-		setVisible = true;
-	}
-	if(event->matches(QKeySequence::MoveToNextLine))
-	{
-		setCursorPos(m_cursorPos + m_bytesPerLine * 2);
-		resetSelection(m_cursorPos);
-		setVisible = true;
-	}
+	std::size_t size = m_pdata->size() * 2;
+	setCursorPos(m_cursorPos);
+	m_selectInit = std::min<std::size_t>(m_selectInit, size);
+	m_selectBegin = std::min<std::size_t>(m_selectBegin, size);
+	m_selectEnd = std::min<std::size_t>(m_selectEnd, size);
 
-	if(event->matches(QKeySequence::MoveToNextPage))
-	{
-		setCursorPos(m_cursorPos + (viewport()->height() / m_charHeight - 1) * 2 * m_bytesPerLine);
-		resetSelection(m_cursorPos);
-		setVisible = true;
-	}
-	if(event->matches(QKeySequence::MoveToPreviousPage))
+	// A new layout of sparse data may need a wider address column
+	std::size_t prevLine = m_firstLine;
+	std::size_t prevBytesPerLine = m_layout.bytesPerLine();
+	updatePositions();
+	if(prevBytesPerLine != m_layout.bytesPerLine())
+		viewport()->update();
+	if(prevLine != m_firstLine)
 	{
-		setCursorPos(m_cursorPos - (viewport()->height() / m_charHeight - 1) * 2 * m_bytesPerLine);
-		resetSelection(m_cursorPos);
-		setVisible = true;
+		viewport()->update();
+		emit firstLineChanged(m_firstLine);
 	}
-	if(event->matches(QKeySequence::MoveToEndOfDocument))
+
+	if(m_follow && m_followTail && atTail)
+		setFirstLine(maxFirstLine());
+
+	// Lines scrolled in are repainted by the scroll, changed ones which were already shown here
+	std::size_t lastLine = length ? m_layout.line(position + length - 1) : std::numeric_limits<std::size_t>::max();
+	viewport()->update(linesRect(m_layout.line(position), lastLine));
+
+	// Only the blocks from the change on are computed again
+	if(m_poverview)
+		m_poverview->start(position);
+	// Decoded fields may have moved anywhere
+	if(m_pstructure)
+		m_pstructure->reset();
+}
+
+QHexOverview *QHexView::createOverview()
+{
+	QHexOverview *poverview = new QHexOverview(m_pdata, this);
+	m_jobs.removeAll(QPointer<QHexJob>());
+	m_jobs.append(poverview);
+	return poverview;
+}
+
+void QHexView::setOverviewVisible(bool visible)
+{
+	if(visible == m_poverviewBar->isVisibleTo(this))
+		return;
+
+	m_poverviewBar->setVisible(visible);
+	setViewportMargins(0, 0, visible ? m_poverviewBar->sizeHint().width() : 0, 0);
+	startOverview();
+
+	// The strip takes its width from the lines
+	placeOverviewBar();
+	updateLayout();
+}
+
+bool QHexView::overviewVisible() const
+{
+	return m_poverviewBar->isVisibleTo(this);
+}
+
+QHexOverviewBar *QHexView::overviewBar()
+{
+	return m_poverviewBar;
+}
+
+void QHexView::placeOverviewBar()
+{
+	QRect area = viewport()->geometry();
+	m_poverviewBar->setGeometry(area.right() + 1, area.top(), m_poverviewBar->sizeHint().width(), area.height());
+}
+
+void QHexView::startOverview()
+{
+	if(m_poverview)
+		delete m_poverview;
+
+	if(!m_pdata || !overviewVisible())
 	{
-		if(m_pdata)
-			setCursorPos(m_pdata->size() * 2);
-		resetSelection(m_cursorPos);
-		setVisible = true;
+		m_poverviewBar->setOverview(NULL);
+		return;
 	}
-	if(event->matches(QKeySequence::MoveToStartOfDocument))
+
+	m_poverview = createOverview();
+	m_poverviewBar->setOverview(m_poverview);
+	if(m_overviewState.isEmpty() || !m_poverview->restoreState(m_overviewState))
+		m_poverview->start();
+}
+
+bool QHexView::loadIndex(const QString &indexPath)
+{
+	// The file is the source of truth, edits made since it was opened are not in it
+	QHexSidecar *psidecar = new QHexSidecar(indexPath);
+	if(!m_pdata || (m_pedit && m_pedit->isModified()) || !psidecar->open(m_pdata->fileName()))
 	{
-		setCursorPos(0);
-		resetSelection(m_cursorPos);
-		setVisible = true;
+		delete psidecar;
+		return false;
 	}
 
-/*****************************************************************************/
-/* Select commands */
-/*****************************************************************************/
-	if (event->matches(QKeySequence::SelectAll))
+	// The sections are read from the mapping, which stays open until the data
+	// changes; the overview only reads its blocks once it is shown
+	closeIndex();
+	m_psidecar = psidecar;
+	m_overviewState = m_psidecar->section(QHexSidecar::Overview);
+	bool valid = m_highlights.restoreState(m_psidecar->section(QHexSidecar::Highlights));
+	viewport()->update();
+
+	startOverview();
+	return valid;
+}
+
+void QHexView::closeIndex()
+{
+	// m_overviewState points into the mapping
+	m_overviewState.clear();
+	delete m_psidecar;
+	m_psidecar = NULL;
+}
+
+bool QHexView::saveIndex(const QString &indexPath)
+{
+	if(!m_pdata || (m_pedit && m_pedit->isModified()) || m_pdata->fileName().isEmpty())
+		return false;
+
+	QMap<quint32, QByteArray> sections;
+	QByteArray overview = m_poverview ? m_poverview->saveState() : m_overviewState;
+	if(!overview.isEmpty())
+		sections.insert(QHexSidecar::Overview, overview);
+	if(!m_highlights.isEmpty())
+		sections.insert(QHexSidecar::Highlights, m_highlights.saveState());
+
+	return QHexSidecar::write(indexPath, m_pdata->fileName(), sections);
+}
+
+void QHexView::updateOverviewRange()
+{
+	if(overviewVisible())
+		m_poverviewBar->setVisibleRange(m_layout.lineStart(m_firstLine), visibleLines() * m_layout.bytesPerLine());
+}
+
+void QHexView::slotOverviewClicked(qulonglong offset)
+{
+	showFromOffset(offset);
+}
+
+void QHexView::setCopyLimit(std::size_t bytes)
+{
+	m_copyLimit = bytes;
+}
+
+std::size_t QHexView::copyLimit() const
+{
+	return m_copyLimit;
+}
+
+void QHexView::setStatsEnabled(bool enabled)
+{
+	m_statsEnabled = enabled;
+	if(m_pdata)
+		m_pdata->setStats(activeStats());
+
+	if(enabled)
+		m_pstatsTimer->start();
+	else
 	{
-		resetSelection(0);
-		if(m_pdata)
-			setSelection(2 * m_pdata->size() + 1);
-		setVisible = true;
+		m_pstatsTimer->stop();
+		m_statsOverlay = false;
 	}
-	if (event->matches(QKeySequence::SelectNextChar))
-	{
-		std::size_t pos = m_cursorPos + 1;
+	viewport()->update();
+}
+
+bool QHexView::statsEnabled() const
+{
+	return m_statsEnabled;
+}
+
+QHexStats *QHexView::stats()
+{
+	return &m_stats;
+}
+
+void QHexView::setStatsOverlayVisible(bool visible)
+{
+	if(visible && !m_statsEnabled)
+		setStatsEnabled(true);
+
+	m_statsOverlay = visible;
+	viewport()->update();
+}
+
+bool QHexView::statsOverlayVisible() const
+{
+	return m_statsOverlay;
+}
+
+QHexStats *QHexView::activeStats()
+{
+	return m_statsEnabled ? &m_stats : NULL;
+}
+
+void QHexView::slotStatsTimer()
+{
+	quint64 frames = m_stats.histograms().value("paint.frame").count();
+	if(frames == m_statsFrames)
+		return;
+
+	m_statsFrames = frames;
+	if(m_statsOverlay)
+		viewport()->update(statsOverlayRect());
+	emit statsUpdated();
+}
+
+QRect QHexView::statsOverlayRect() const
+{
+	int width = (STATS_OVERLAY_COLUMNS + 2) * m_charWidth;
+	int height = (STATS_OVERLAY_LINES + 1) * m_charHeight;
+	return QRect(viewport()->width() - width - m_charWidth, m_charHeight / 2, width, height);
+}
+
+void QHexView::drawStatsOverlay(QPainter &painter)
+{
+	QRect rect = statsOverlayRect();
+	painter.fillRect(rect, QColor(0, 0, 0, 0xc0));
+	painter.setPen(Qt::white);
+
+	QStringList lines = m_stats.summary();
+	int yPos = rect.top() + m_charHeight / 2 + fontMetrics().ascent();
+	for(int i = 0; i < lines.size() && i < STATS_OVERLAY_LINES; i++, yPos += m_charHeight)
+		painter.drawText(rect.left() + m_charWidth, yPos, lines[i]);
+
+	painter.setPen(Qt::black);
+}
+
+void QHexView::addHighlight(std::size_t offset, std::size_t length, const QColor &color, int layer)
+{
+	if(!length)
+		return;
+
+	m_highlights.add(offset, offset + length, color, layer);
+	updateNibbles(offset * 2, (offset + length) * 2 - 1);
+}
+
+void QHexView::removeHighlight(std::size_t offset, std::size_t length, int layer)
+{
+	if(!length)
+		return;
+
+	m_highlights.remove(offset, offset + length, layer);
+	viewport()->update();
+}
+
+void QHexView::clearHighlights(int layer)
+{
+	m_highlights.clear(layer);
+	viewport()->update();
+}
+
+void QHexView::clearHighlights()
+{
+	m_highlights.clear();
+	viewport()->update();
+}
+
+void QHexView::setBytesPerLine(std::size_t bytes)
+{
+	m_lineBytes = bytes;
+	updateLayout();
+}
+
+std::size_t QHexView::bytesPerLine() const
+{
+	return m_layout.bytesPerLine();
+}
+
+void QHexView::setGrouping(int groupSize, bool littleEndian)
+{
+	m_layout.setGrouping(groupSize, littleEndian);
+	updateLayout();
+}
+
+void QHexView::setBaseOffset(std::size_t offset)
+{
+	m_layout.setBaseOffset(offset);
+	updateLayout();
+}
+
+const QHexLayout &QHexView::hexLayout() const
+{
+	return m_layout;
+}
+
+std::size_t QHexView::selectionOffset() const
+{
+	return m_selectBegin / 2;
+}
+
+std::size_t QHexView::selectionLength() const
+{
+	// Partially selected bytes are included
+	return (m_selectEnd + 1) / 2 - m_selectBegin / 2;
+}
+
+std::size_t QHexView::cursorOffset() const
+{
+	return m_cursorPos / 2;
+}
+
+QByteArray QHexView::readData(std::size_t offset, std::size_t length)
+{
+	if(!m_pdata || offset >= m_pdata->size())
+		return QByteArray();
+
+	QByteArray data(std::min(length, m_pdata->size() - offset), Qt::Uninitialized);
+	data.resize(m_pdata->read(offset, data.size(), data.data()));
+	return data;
+}
+
+
+void QHexView::slotDataReady(qulonglong position, qulonglong length)
+{
+	if(!m_pdata || !length)
+		return;
+
+	std::size_t firstLineIdx = m_firstLine;
+	std::size_t lastLineIdx = firstLineIdx + visibleLines() + 1;
+
+	std::size_t firstChanged = std::max<std::size_t>(m_layout.line(position), firstLineIdx);
+	std::size_t lastChanged = std::min<std::size_t>(m_layout.line(position + length - 1) + 1, lastLineIdx);
+
+	// Only the lines which received data are repainted
+	if(firstChanged < lastChanged)
+		viewport()->update(linesRect(firstChanged, lastChanged - 1));
+}
+
+QRect QHexView::linesRect(std::size_t firstLine, std::size_t lastLine) const
+{
+	std::size_t firstLineIdx = m_firstLine;
+	std::size_t lastLineIdx = firstLineIdx + visibleLines() + 1;
+
+	firstLine = std::max(firstLine, firstLineIdx);
+	lastLine = std::min(lastLine, lastLineIdx);
+	if(firstLine > lastLine)
+		return QRect();
+
+	// Glyph descents and the cursor reach below the line, one extra line covers them
+	return QRect(0, (firstLine - firstLineIdx) * m_charHeight, viewport()->width(), (lastLine - firstLine + 2) * m_charHeight);
+}
+
+void QHexView::updateNibbles(std::size_t begin, std::size_t end)
+{
+	if(begin > end)
+		std::swap(begin, end);
+
+	viewport()->update(linesRect(m_layout.line(begin / 2), m_layout.line(end / 2)));
+}
+
+void QHexView::updateChanges(std::size_t cursorPos, std::size_t selectBegin, std::size_t selectEnd)
+{
+	if(cursorPos != m_cursorPos)
+	{
+		updateNibbles(cursorPos, cursorPos);
+		updateNibbles(m_cursorPos, m_cursorPos);
+	}
+
+	// The bounds moves cover every nibble whose selection state changed
+	if(selectBegin != m_selectBegin)
+		updateNibbles(selectBegin, m_selectBegin);
+	if(selectEnd != m_selectEnd)
+		updateNibbles(selectEnd, m_selectEnd);
+
+	if(cursorPos / 2 != m_cursorPos / 2)
+		emit cursorMoved(cursorOffset());
+	if(selectBegin != m_selectBegin || selectEnd != m_selectEnd)
+		emit selectionChanged(selectionOffset(), selectionLength());
+}
+
+void QHexView::resizeEvent(QResizeEvent *event)
+{
+	QAbstractScrollArea::resizeEvent(event);
+	placeOverviewBar();
+
+	std::size_t prevBytesPerLine = m_layout.bytesPerLine();
+	std::size_t firstByte = m_layout.lineStart(m_firstLine);
+	updatePositions();
+	if(prevBytesPerLine != m_layout.bytesPerLine())
+	{
+		// Keep the first visible byte at the top when the line width changes
+		m_firstLine = m_layout.line(firstByte);
+		updateScrollBar();
+		viewport()->update();
+	}
+}
+
+void QHexView::changeEvent(QEvent *event)
+{
+	QAbstractScrollArea::changeEvent(event);
+
+	if(event->type() == QEvent::FontChange)
+	{
+		updatePositions();
+		viewport()->update();
+	}
+}
+
+bool QHexView::viewportEvent(QEvent *event)
+{
+	if(event->type() != QEvent::ToolTip || !m_pstructure || !m_pdata)
+		return QAbstractScrollArea::viewportEvent(event);
+
+	// The field under the mouse, over either the hex or the text column
+	QHelpEvent *phelp = static_cast<QHelpEvent *>(event);
+	std::size_t offset = std::numeric_limits<std::size_t>::max();
+	std::size_t nibble = cursorPos(phelp->pos());
+	std::size_t column;
+	if(nibble != std::numeric_limits<std::size_t>::max())
+		offset = nibble / 2;
+	else if(m_layout.asciiColumnAt(phelp->pos().x() + m_scrollX, column) && phelp->pos().y() >= 0)
+		offset = m_layout.offsetAt(m_firstLine + phelp->pos().y() / m_charHeight, column);
+
+	QHexStructure::Field field;
+	if(offset < m_pdata->size() && m_pstructure->fieldAt(offset, field))
+	{
+		QToolTip::showText(phelp->globalPos(), QString("%1 : %2\n%3\noffset 0x%4, %5 bytes")
+			.arg(field.path, field.type, field.value)
+			.arg(field.offset, 0, 16)
+			.arg(field.length), viewport());
+	}
+	else
+	{
+		QToolTip::hideText();
+		event->ignore();
+	}
+	return true;
+}
+
+void QHexView::scrollContentsBy(int dx, int)
+{
+	if(m_scrollSync)
+		return;
+
+	// The address column stays in place, only the hex and text columns move sideways
+	if(dx)
+	{
+		m_scrollX = horizontalScrollBar()->value();
+		viewport()->update();
+	}
+
+	std::size_t prevLine = m_firstLine;
+	int value = verticalScrollBar()->value();
+
+	if(m_hasActionLine)
+		m_firstLine = m_actionLine;
+	else if(lineToScrollValue(m_firstLine) != value)
+		m_firstLine = scrollValueToLine(value);
+	m_hasActionLine = false;
+
+	scrollViewport(prevLine);
+}
+
+void QHexView::slotScrollAction(int action)
+{
+	// In scaled mode one scrollbar unit spans many lines, so steps are applied to the exact line
+	if(maxFirstLine() <= (std::size_t)SCROLL_MAX)
+		return;
+
+	std::size_t page = std::max<std::size_t>(visibleLines(), 1);
+	std::size_t line = m_firstLine;
+	switch(action)
+	{
+		case QAbstractSlider::SliderSingleStepAdd:
+			line += 1;
+			break;
+		case QAbstractSlider::SliderSingleStepSub:
+			line = line ? line - 1 : 0;
+			break;
+		case QAbstractSlider::SliderPageStepAdd:
+			line += page;
+			break;
+		case QAbstractSlider::SliderPageStepSub:
+			line = line > page ? line - page : 0;
+			break;
+		default:
+			return;
+	}
+
+	line = std::min(line, maxFirstLine());
+	int value = lineToScrollValue(line);
+	if(value == verticalScrollBar()->value())
+		setFirstLine(line);
+	else
+	{
+		m_actionLine = line;
+		m_hasActionLine = true;
+		verticalScrollBar()->setSliderPosition(value);
+	}
+}
+
+void QHexView::wheelEvent(QWheelEvent *event)
+{
+	if(maxFirstLine() <= (std::size_t)SCROLL_MAX || event->angleDelta().y() == 0)
+	{
+		QAbstractScrollArea::wheelEvent(event);
+		return;
+	}
+
+	qint64 lines = -(qint64)event->angleDelta().y() * QApplication::wheelScrollLines() / 120;
+	if(lines < 0)
+		setFirstLine((std::size_t)-lines > m_firstLine ? 0 : m_firstLine + lines);
+	else
+		setFirstLine(m_firstLine + lines);
+	event->accept();
+}
+
+void QHexView::setFirstLine(std::size_t line)
+{
+	std::size_t prevLine = m_firstLine;
+	m_firstLine = std::min(line, maxFirstLine());
+
+	m_scrollSync = true;
+	verticalScrollBar()->setValue(lineToScrollValue(m_firstLine));
+	m_scrollSync = false;
+
+	scrollViewport(prevLine);
+}
+
+void QHexView::scrollViewport(std::size_t prevLine)
+{
+	if(prevLine == m_firstLine)
+		return;
+
+	// Rendered lines are moved by the scroll distance, only the exposed ones get repainted
+	std::size_t distance = prevLine > m_firstLine ? prevLine - m_firstLine : m_firstLine - prevLine;
+	if(distance >= visibleLines())
+		viewport()->update();
+	else if(prevLine > m_firstLine)
+		viewport()->scroll(0, distance * m_charHeight);
+	else
+		viewport()->scroll(0, -(int)(distance * m_charHeight));
+
+	// The overlay stays in place, what it was scrolled to is painted again
+	if(m_statsOverlay)
+	{
+		int dy = std::min(distance, visibleLines()) * m_charHeight;
+		viewport()->update(statsOverlayRect().adjusted(0, -dy, 0, dy));
+	}
+
+	updateOverviewRange();
+	emit firstLineChanged(m_firstLine);
+}
+
+int QHexView::lineToScrollValue(std::size_t line) const
+{
+	std::size_t maxLine = maxFirstLine();
+	if(maxLine <= (std::size_t)SCROLL_MAX)
+		return line;
+
+	return qRound((double)line / maxLine * SCROLL_MAX);
+}
+
+std::size_t QHexView::scrollValueToLine(int value) const
+{
+	std::size_t maxLine = maxFirstLine();
+	if(maxLine <= (std::size_t)SCROLL_MAX)
+		return value;
+
+	return std::min<std::size_t>(qRound64((double)value / SCROLL_MAX * maxLine), maxLine);
+}
+
+std::size_t QHexView::lineCount() const
+{
+	if(!m_pdata)
+		return 0;
+
+	return m_layout.lineCount(m_pdata->size());
+}
+
+std::size_t QHexView::visibleLines() const
+{
+	return viewport()->height() / m_charHeight;
+}
+
+std::size_t QHexView::maxFirstLine() const
+{
+	// One line of the bottom margin stays reachable, as with the original pixel-based range
+	std::size_t lines = lineCount() + 1;
+	std::size_t visible = visibleLines();
+	return lines > visible ? lines - visible : 0;
+}
+
+void QHexView::updatePositions()
+{
+	QHexStats::Timer timer(activeStats(), "layout");
+
+#if QT_VERSION >= 0x051100
+	m_charWidth = fontMetrics().horizontalAdvance(QLatin1Char('9'));
+#else
+	m_charWidth = fontMetrics().width(QLatin1Char('9'));
+#endif
+	m_charHeight = fontMetrics().height();
+
+	// Addresses of sparse data (process memory) may take up to 16 digits
+	m_addressLength = ADR_LENGTH;
+	if(m_pdata && m_pdata->size())
+	{
+		quint64 maxAddress = m_pdata->address(m_pdata->size() - 1);
+		int digits = 1;
+		while(maxAddress >>= 4)
+			digits++;
+		m_addressLength = std::max(ADR_LENGTH, digits);
+	}
+
+	int serviceSymbolsWidth = m_addressLength * m_charWidth + GAP_ADR_HEX + GAP_HEX_ASCII;
+
+	std::size_t bytesPerLine = m_lineBytes;
+	if(!bytesPerLine)
+	{
+		// As many words as fit, a word takes 3 symbols per byte and a space
+		int groupSize = m_layout.groupSize();
+		int availableWidth = width() - (overviewVisible() ? m_poverviewBar->sizeHint().width() : 0);
+		int groups = (availableWidth - serviceSymbolsWidth) / ((3 * groupSize + 1) * (int)m_charWidth) - 1;
+		bytesPerLine = std::max(groups, 1) * groupSize;
+	}
+
+	m_posAddr = 0;
+	m_layout.setBytesPerLine(bytesPerLine);
+	m_layout.setGeometry(m_charWidth, m_addressLength * m_charWidth + GAP_ADR_HEX, GAP_HEX_ASCII);
+
+	updateScrollBar();
+}
+
+void QHexView::updateLayout()
+{
+	// The first visible byte stays at the top
+	std::size_t prevLine = m_firstLine;
+	std::size_t firstByte = m_layout.lineStart(m_firstLine);
+	updatePositions();
+	m_firstLine = m_layout.line(firstByte);
+	updateScrollBar();
+	viewport()->update();
+
+	if(prevLine != m_firstLine)
+		emit firstLineChanged(m_firstLine);
+}
+
+void QHexView::updateScrollBar()
+{
+	std::size_t maxLine = maxFirstLine();
+	m_firstLine = std::min(m_firstLine, maxLine);
+
+	std::size_t pageStep = visibleLines();
+	if(maxLine > (std::size_t)SCROLL_MAX)
+		pageStep = std::max<std::size_t>((double)pageStep / maxLine * SCROLL_MAX, 1);
+
+	m_scrollSync = true;
+	verticalScrollBar()->setPageStep(pageStep);
+	verticalScrollBar()->setRange(0, std::min<std::size_t>(maxLine, SCROLL_MAX));
+	verticalScrollBar()->setValue(lineToScrollValue(m_firstLine));
+
+	// Lines wider than the viewport scroll sideways, the address column stays
+	int dataWidth = viewport()->width() - m_layout.hexLeft();
+	horizontalScrollBar()->setPageStep(std::max(dataWidth, 1));
+	horizontalScrollBar()->setSingleStep(m_charWidth);
+	horizontalScrollBar()->setRange(0, std::max(m_layout.asciiRight() + (int)m_charWidth - viewport()->width(), 0));
+	m_scrollX = horizontalScrollBar()->value();
+	m_scrollSync = false;
+
+	updateOverviewRange();
+}
+
+void QHexView::updateGlyphAtlas()
+{
+#if QT_VERSION >= 0x050600
+	qreal ratio = viewport()->devicePixelRatioF();
+#else
+	qreal ratio = 1;
+#endif
+
+	if(!m_glyphAtlas.isNull() && m_atlasFont == font() && m_atlasRatio == ratio)
+		return;
+
+	QPixmap atlas(QSize(GLYPH_COUNT * m_charWidth, m_charHeight) * ratio);
+	atlas.setDevicePixelRatio(ratio);
+	atlas.fill(Qt::transparent);
+
+	QPainter painter(&atlas);
+	painter.setFont(font());
+	painter.setPen(Qt::black);
+
+	int ascent = fontMetrics().ascent();
+	for(int i = 0; i < GLYPH_COUNT; i++)
+	{
+		char ch = i;
+		QHexFormatter::toAscii(&ch, 1, &ch);
+		painter.drawText(i * m_charWidth, ascent, QString(ch));
+	}
+
+	painter.end();
+
+	m_glyphAtlas = atlas;
+	m_atlasFont = font();
+	m_atlasRatio = ratio;
+}
+
+void QHexView::fillBytes(QPainter &painter, std::size_t lineIdx, int yTop, std::size_t begin, std::size_t end, const QColor &color)
+{
+	// Fills the part of the byte range [begin, end) on the line, in both the hex and ASCII columns
+	std::size_t first = std::max<std::size_t>(begin, m_layout.lineStart(lineIdx));
+	std::size_t last = std::min<std::size_t>(end, m_layout.lineStart(lineIdx + 1));
+	if(first >= last)
+		return;
+
+	std::size_t firstColumn = m_layout.column(first);
+	std::size_t lastColumn = firstColumn + (last - first);
+	painter.fillRect(m_layout.asciiX(firstColumn), yTop, (last - first) * m_charWidth, m_charHeight, color);
+
+	// The bytes of a word are adjacent in either byte order, so each word takes one rectangle.
+	// It covers the space to the next word when the range goes on there.
+	std::size_t groupSize = m_layout.groupSize();
+	for(std::size_t column = firstColumn; column < lastColumn; )
+	{
+		std::size_t groupStart = column / groupSize * groupSize;
+		std::size_t groupEnd = std::min(groupStart + groupSize, lastColumn);
+		int left = std::min(m_layout.hexX(column), m_layout.hexX(groupEnd - 1));
+		int right = std::max(m_layout.hexX(column), m_layout.hexX(groupEnd - 1)) + 2 * m_charWidth;
+
+		std::size_t rightSlot = m_layout.littleEndian() ? groupStart : groupStart + groupSize - 1;
+		std::size_t nextLeftSlot = m_layout.littleEndian() ? groupStart + 2 * groupSize - 1 : groupStart + groupSize;
+		if(column <= rightSlot && rightSlot < groupEnd && nextLeftSlot < lastColumn)
+			right += m_charWidth;
+
+		painter.fillRect(left, yTop, right - left, m_charHeight, color);
+		column = groupEnd;
+	}
+}
+
+void QHexView::fillRange(QPainter &painter, std::size_t firstIdx, std::size_t lastIdx, int yTop, std::size_t begin, std::size_t end, const QColor &color)
+{
+	// Only the painted lines [firstIdx, lastIdx) are filled, yTop is the top of firstIdx
+	std::size_t rangeFirst = std::max<std::size_t>(m_layout.line(begin), firstIdx);
+	std::size_t rangeLast = std::min<std::size_t>(m_layout.line(end - 1) + 1, lastIdx);
+	for(std::size_t lineIdx = rangeFirst; lineIdx < rangeLast; lineIdx++)
+		fillBytes(painter, lineIdx, yTop + (lineIdx - firstIdx) * m_charHeight, begin, end, color);
+}
+
+QPainter::PixmapFragment QHexView::glyphFragment(int glyph, qreal x, qreal y) const
+{
+	// Source rectangles are in device pixels of the atlas, fragments are positioned by their centre
+	QRectF source(glyph * m_charWidth * m_atlasRatio, 0, m_charWidth * m_atlasRatio, m_charHeight * m_atlasRatio);
+	return QPainter::PixmapFragment::create(QPointF(x + m_charWidth / 2.0, y + m_charHeight / 2.0), source, 1 / m_atlasRatio, 1 / m_atlasRatio);
+}
+
+void QHexView::paintEvent(QPaintEvent *event)
+{
+	// Repaints of the overlay alone do not count as frames
+	QHexStats *pstats = activeStats();
+	if(m_statsOverlay && statsOverlayRect().contains(event->rect()))
+		pstats = NULL;
+
+	QElapsedTimer frameTimer;
+	if(pstats)
+		frameTimer.start();
+
+	if(!m_pdata)
+		return;
+	QPainter painter(viewport());
+
+	std::size_t firstLineIdx = m_firstLine;
+	std::size_t lastLineIdx = std::min(firstLineIdx + visibleLines(), lineCount());
+
+	// Only the lines intersecting the exposed area are fetched and drawn
+	std::size_t paintFirstIdx = std::min<std::size_t>(lastLineIdx, firstLineIdx + std::max(0, event->rect().top() / (int)m_charHeight - 1));
+	std::size_t paintLastIdx = std::min<std::size_t>(lastLineIdx, firstLineIdx + event->rect().bottom() / (int)m_charHeight + 1);
+
+	painter.fillRect(event->rect(), this->palette().color(QPalette::Base));
+
+	// The hex and text columns are shifted by the horizontal scroll, the address
+	// column is painted over them at the end
+	painter.translate(-m_scrollX, 0);
+
+	int linePos = m_layout.asciiLeft() - (GAP_HEX_ASCII / 2);
+	painter.setPen(Qt::gray);
+
+	painter.drawLine(linePos, event->rect().top(), linePos, height());
+
+	painter.setPen(Qt::black);
+
+	int yPosStart = (paintFirstIdx - firstLineIdx + 1) * m_charHeight;
+
+	QColor selected = QColor(0x6d, 0x9e, 0xff, 0xff);
+	int ascent = fontMetrics().ascent();
+
+	updateGlyphAtlas();
+	QVector<QPainter::PixmapFragment> fragments;
+	fragments.reserve(3 * m_layout.bytesPerLine());
+
+	std::size_t firstPos = m_layout.lineStart(paintFirstIdx);
+	std::size_t rangeLength = m_layout.lineStart(paintLastIdx) - firstPos;
+
+	// Lines which a non-blocking storage has not delivered yet are drawn as placeholders
+	QVector<bool> lineReady(paintLastIdx - paintFirstIdx, true);
+	qint64 fetchStart = pstats ? frameTimer.nsecsElapsed() : 0;
+	DataView data;
+	if(m_pdata->isReady(firstPos, rangeLength))
+		data = m_pdata->view(firstPos, rangeLength);
+	else
+	{
+		std::size_t dataSize = m_pdata->size();
+		QByteArray buffer(firstPos < dataSize ? std::min(rangeLength, dataSize - firstPos) : 0, '\0');
+		for(std::size_t lineIdx = paintFirstIdx; lineIdx < paintLastIdx; lineIdx++)
+		{
+			std::size_t offset = m_layout.lineStart(lineIdx) - firstPos;
+			if(offset >= (std::size_t)buffer.size())
+				break;
+			std::size_t length = std::min<std::size_t>(m_layout.lineStart(lineIdx + 1) - firstPos, buffer.size()) - offset;
+			if(m_pdata->isReady(firstPos + offset, length))
+				m_pdata->read(firstPos + offset, length, buffer.data() + offset);
+			else
+				lineReady[lineIdx - paintFirstIdx] = false;
+		}
+		data = DataView(buffer);
+	}
+
+	if(pstats)
+	{
+		pstats->add("paint.fetch", frameTimer.nsecsElapsed() - fetchStart);
+		pstats->add("paint.bytes", data.size());
+	}
+
+	// The whole painted range is converted to text at once
+	QByteArray hexText(2 * data.size(), Qt::Uninitialized);
+	QByteArray asciiText(data.size(), Qt::Uninitialized);
+	QHexFormatter::toHex(data.data(), data.size(), hexText.data());
+	QHexFormatter::toAscii(data.data(), data.size(), asciiText.data());
+
+	// Highlights and search matches are drawn below the selection. Only the ranges
+	// overlapping the painted lines are looked up, however many there are.
+	int yTopStart = yPosStart - ascent;
+	if(m_pstructure)
+	{
+		QVector<QHexHighlights::Range> fields;
+		m_pstructure->ranges(firstPos, firstPos + rangeLength, fields);
+		for(int i = 0; i < fields.size(); i++)
+			fillRange(painter, paintFirstIdx, paintLastIdx, yTopStart, fields[i].begin, fields[i].end, QColor::fromRgba(fields[i].color));
+	}
+
+	if(!m_highlights.isEmpty())
+	{
+		QList<int> layers = m_highlights.layers();
+		QVector<QHexHighlights::Range> ranges;
+		for(int i = 0; i < layers.size(); i++)
+		{
+			ranges.resize(0);
+			m_highlights.overlapping(layers[i], firstPos, firstPos + rangeLength, ranges);
+			for(int j = 0; j < ranges.size(); j++)
+				fillRange(painter, paintFirstIdx, paintLastIdx, yTopStart, ranges[j].begin, ranges[j].end, QColor::fromRgba(ranges[j].color));
+		}
+	}
+
+	if(m_pdiff)
+	{
+		QColor diffColor = QColor(0xff, 0xa0, 0xa0, 0xff);
+		QVector<QHexDiff::Region> regions = m_pdiff->regions(firstPos, firstPos + rangeLength);
+		for(int i = 0; i < regions.size(); i++)
+			fillRange(painter, paintFirstIdx, paintLastIdx, yTopStart, regions[i].offset, regions[i].offset + regions[i].length, diffColor);
+	}
+
+	if(m_psearch)
+	{
+		QColor matchColor = QColor(0xff, 0xe0, 0x80, 0xff);
+		QVector<QHexSearch::Match> matches = m_psearch->matches(firstPos, firstPos + rangeLength);
+		for(int i = 0; i < matches.size(); i++)
+			fillRange(painter, paintFirstIdx, paintLastIdx, yTopStart, matches[i].offset, matches[i].offset + matches[i].length, matchColor);
+	}
+
+	int yPos = yPosStart;
+	for (std::size_t lineIdx = paintFirstIdx; lineIdx < paintLastIdx; lineIdx += 1, yPos += m_charHeight)
+	{
+		std::size_t lineStart = m_layout.lineStart(lineIdx);
+		std::size_t lineOffset = lineStart - firstPos;
+		// A storage may return less than its size said, e.g. a followed file truncated
+		// before the next refresh or a short read; nothing is painted past its end
+		if(lineOffset >= data.size())
+			break;
+		std::size_t lineLength = std::min<std::size_t>(m_layout.lineStart(lineIdx + 1) - lineStart, data.size() - lineOffset);
+		std::size_t firstColumn = m_layout.column(lineStart);
+		int yTop = yPos - ascent;
+
+		if(!lineReady[lineIdx - paintFirstIdx])
+		{
+			painter.setPen(Qt::gray);
+			for(std::size_t i = 0; i < lineLength; i++)
+				painter.drawText(m_layout.hexX(firstColumn + i), yPos, "??");
+			painter.drawText(m_layout.asciiX(firstColumn), yPos, QString(lineLength, QChar('.')));
+			painter.setPen(Qt::black);
+			continue;
+		}
+
+		for(std::size_t i = 0; i < lineLength; i++)
+		{
+			std::size_t pos = (lineStart + i) * 2;
+			int xPos = m_layout.hexX(firstColumn + i);
+			if(pos >= m_selectBegin && pos < m_selectEnd)
+				painter.fillRect(xPos, yTop, m_charWidth, m_charHeight, selected);
+			if((pos+1) >= m_selectBegin && (pos+1) < m_selectEnd)
+				painter.fillRect(xPos + m_charWidth, yTop, m_charWidth, m_charHeight, selected);
+		}
+
+		// Every glyph of the line is blitted from the atlas in a single call
+		fragments.clear();
+		const uchar *phex = (const uchar *)hexText.constData() + 2 * lineOffset;
+		const uchar *pascii = (const uchar *)asciiText.constData() + lineOffset;
+		for(std::size_t i = 0; i < lineLength; i++)
+		{
+			qreal xPos = m_layout.hexX(firstColumn + i);
+			fragments.append(glyphFragment(phex[2 * i], xPos, yTop));
+			fragments.append(glyphFragment(phex[2 * i + 1], xPos + m_charWidth, yTop));
+			fragments.append(glyphFragment(pascii[i], m_layout.asciiX(firstColumn + i), yTop));
+		}
+		painter.drawPixmapFragments(fragments.constData(), fragments.size(), m_glyphAtlas);
+	}
+
+	// Gaps in sparse data take no lines, a step separates the regions on either side
+	std::size_t dataEnd = firstPos + data.size();
+	painter.setPen(QPen(Qt::darkGray, 1, Qt::DashLine));
+	for(std::size_t boundary = m_pdata->regionEnd(firstPos); boundary > firstPos && boundary < dataEnd; )
+	{
+		std::size_t column = m_layout.column(boundary);
+		int yTop = yTopStart + (m_layout.line(boundary) - paintFirstIdx) * m_charHeight;
+		int yBottom = yTop + m_charHeight;
+
+		int hexLeft = m_layout.hexLeft() - m_charWidth / 2;
+		int hexRight = m_layout.hexRight() + m_charWidth / 2;
+		int hexX = m_layout.hexX(column) - m_charWidth / 2;
+		int asciiX = m_layout.asciiX(column);
+		int asciiRight = m_layout.asciiRight();
+
+		painter.drawLine(hexX, yTop, hexRight, yTop);
+		painter.drawLine(asciiX, yTop, asciiRight, yTop);
+		if(column)
+		{
+			painter.drawLine(hexX, yTop, hexX, yBottom);
+			painter.drawLine(hexLeft, yBottom, hexX, yBottom);
+			painter.drawLine(asciiX, yTop, asciiX, yBottom);
+			painter.drawLine(m_layout.asciiLeft(), yBottom, asciiX, yBottom);
+		}
+
+		std::size_t next = m_pdata->regionEnd(boundary);
+		if(next <= boundary)
+			break;
+		boundary = next;
+	}
+	painter.setPen(Qt::black);
+
+	if (hasFocus())
+	{
+		std::size_t offset = m_cursorPos / 2;
+		qint64 y = m_layout.line(offset);
+		y -= firstLineIdx;
+		if(y >= 0 && (std::size_t)y <= visibleLines())
+		{
+			int cursorX = m_layout.hexX(m_layout.column(offset)) + (m_cursorPos % 2) * m_charWidth;
+			int cursorY = y * m_charHeight + 4;
+			painter.fillRect(cursorX, cursorY, 2, m_charHeight, this->palette().color(QPalette::WindowText));
+		}
+	}
+
+	painter.resetTransform();
+	QColor addressAreaColor = QColor(0xd4, 0xd4, 0xd4, 0xff);
+	painter.fillRect(QRect(m_posAddr, event->rect().top(), m_layout.hexLeft() - GAP_ADR_HEX + 2 , height()), addressAreaColor);
+
+	yPos = yPosStart;
+	for (std::size_t lineIdx = paintFirstIdx; lineIdx < paintLastIdx; lineIdx += 1, yPos += m_charHeight)
+	{
+		QString address = QString("%1").arg(m_pdata->address(m_layout.lineStart(lineIdx)), m_addressLength, 16, QChar('0'));
+		painter.drawText(m_posAddr, yPos, address);
+	}
+
+	if(pstats)
+		pstats->add("paint.frame", frameTimer.nsecsElapsed());
+	if(m_statsOverlay)
+		drawStatsOverlay(painter);
+}
+
+
+void QHexView::keyPressEvent(QKeyEvent *event)
+{
+	std::size_t prevCursor = m_cursorPos;
+	std::size_t prevBegin = m_selectBegin;
+	std::size_t prevEnd = m_selectEnd;
+
+	// Any other key ends a run of typing
+	bool typing = m_cursorPos == m_typingPos;
+	m_typingPos = std::numeric_limits<std::size_t>::max();
+
+	bool setVisible = false;
+	qint64 pageLines = std::max<std::size_t>(visibleLines(), 2) - 1;
+
+/*****************************************************************************/
+/* Cursor movements */
+/*****************************************************************************/
+	if(event->matches(QKeySequence::MoveToNextChar))
+	{
+		setCursorPos(m_cursorPos + 1);
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+	if(event->matches(QKeySequence::MoveToPreviousChar))
+	{
+		setCursorPos(m_cursorPos - 1);
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+	if(event->matches(QKeySequence::MoveToEndOfLine))
+	{
+		setCursorPos(2 * m_layout.lineStart(m_layout.line(m_cursorPos / 2) + 1) - 1);
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+	if(event->matches(QKeySequence::MoveToStartOfLine))
+	{
+		setCursorPos(2 * m_layout.lineStart(m_layout.line(m_cursorPos / 2)));
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+	if(event->matches(QKeySequence::MoveToPreviousLine))
+	{
+		setCursorPos(m_layout.moveLines(m_cursorPos, -1));
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+	if(event->matches(QKeySequence::MoveToNextLine))
+	{
+		setCursorPos(m_layout.moveLines(m_cursorPos, 1));
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+
+	if(event->matches(QKeySequence::MoveToNextPage))
+	{
+		setCursorPos(m_layout.moveLines(m_cursorPos, pageLines));
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+	if(event->matches(QKeySequence::MoveToPreviousPage))
+	{
+		setCursorPos(m_layout.moveLines(m_cursorPos, -pageLines));
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+	if(event->matches(QKeySequence::MoveToEndOfDocument))
+	{
+		if(m_pdata)
+			setCursorPos(m_pdata->size() * 2);
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+	if(event->matches(QKeySequence::MoveToStartOfDocument))
+	{
+		setCursorPos(0);
+		resetSelection(m_cursorPos);
+		setVisible = true;
+	}
+
+/*****************************************************************************/
+/* Select commands */
+/*****************************************************************************/
+	if (event->matches(QKeySequence::SelectAll))
+	{
+		resetSelection(0);
+		if(m_pdata)
+			setSelection(2 * m_pdata->size() + 1);
+		setVisible = true;
+	}
+	if (event->matches(QKeySequence::SelectNextChar))
+	{
+		std::size_t pos = m_cursorPos + 1;
+		setCursorPos(pos);
+		setSelection(pos);
+		setVisible = true;
+	}
+	if (event->matches(QKeySequence::SelectPreviousChar))
+	{
+		std::size_t pos = m_cursorPos - 1;
+		setSelection(pos);
+		setCursorPos(pos);
+		setVisible = true;
+	}
+	if (event->matches(QKeySequence::SelectEndOfLine))
+	{
+		std::size_t pos = 2 * m_layout.lineStart(m_layout.line(m_cursorPos / 2) + 1);
+		setCursorPos(pos);
+		setSelection(pos);
+		setVisible = true;
+	}
+	if (event->matches(QKeySequence::SelectStartOfLine))
+	{
+		std::size_t pos = 2 * m_layout.lineStart(m_layout.line(m_cursorPos / 2));
+		setCursorPos(pos);
+		setSelection(pos);
+		setVisible = true;
+	}
+	if (event->matches(QKeySequence::SelectPreviousLine))
+	{
+		std::size_t pos = m_layout.moveLines(m_cursorPos, -1);
+		setCursorPos(pos);
+		setSelection(pos);
+		setVisible = true;
+	}
+	if (event->matches(QKeySequence::SelectNextLine))
+	{
+		std::size_t pos = m_layout.moveLines(m_cursorPos, 1);
+		setCursorPos(pos);
+		setSelection(pos);
+		setVisible = true;
+	}
+
+	if (event->matches(QKeySequence::SelectNextPage))
+	{
+		std::size_t pos = m_layout.moveLines(m_cursorPos, pageLines);
+		setCursorPos(pos);
+		setSelection(pos);
+		setVisible = true;
+	}
+	if (event->matches(QKeySequence::SelectPreviousPage))
+	{
+		std::size_t pos = m_layout.moveLines(m_cursorPos, -pageLines);
+		setCursorPos(pos);
+		setSelection(pos);
+		setVisible = true;
+	}
+	if (event->matches(QKeySequence::SelectEndOfDocument))
+	{
+		std::size_t pos = 0;
+		if(m_pdata)
+			pos = m_pdata->size() * 2;
+		setCursorPos(pos);
+		setSelection(pos);
+		setVisible = true;
+	}
+	if (event->matches(QKeySequence::SelectStartOfDocument))
+	{
+		std::size_t pos = 0;
 		setCursorPos(pos);
 		setSelection(pos);
 		setVisible = true;
 	}
-	if (event->matches(QKeySequence::SelectPreviousChar))
+
+	bool copyTooLarge = false;
+	if (event->matches(QKeySequence::Copy))
+	{
+		if(m_pdata && selectionLength() > m_copyLimit)
+			copyTooLarge = true;
+		else if(m_pdata)
+		{
+			DataView data = m_pdata->view(m_selectBegin / 2, (m_selectEnd - m_selectBegin) / 2 + 1);
+
+			QByteArray res;
+			char hex[2];
+			std::size_t first = 0;
+			std::size_t nibbles = m_selectEnd - m_selectBegin;
+
+			// A selection starting at the low nibble copies it alone
+			if(m_selectBegin % 2 && nibbles && data.size())
+			{
+				QHexFormatter::toHex(data.data(), 1, hex);
+				res += hex[1];
+				res += ' ';
+				first = 1;
+				nibbles--;
+			}
+
+			std::size_t fullBytes = std::min(nibbles / 2, data.size() - first);
+			std::size_t bytesPerLine = m_layout.bytesPerLine();
+			res.reserve(fullBytes * 3 + fullBytes / bytesPerLine + 4);
+
+			// Lines break after every bytesPerLine bytes counted from the selection start
+			for(std::size_t done = 0; done < fullBytes; )
+			{
+				std::size_t count = std::min(fullBytes - done, bytesPerLine - done % bytesPerLine);
+				std::size_t at = res.size();
+				res.resize(at + 3 * count);
+				QHexFormatter::toHexSpaced(data.data() + first + done, count, res.data() + at);
+				done += count;
+				if(done % bytesPerLine == 0)
+					res += '\n';
+			}
+
+			// and one ending at the high nibble copies only that
+			if(nibbles % 2 && first + fullBytes < data.size())
+			{
+				QHexFormatter::toHex(data.data() + first + fullBytes, 1, hex);
+				res += hex[0];
+				if(fullBytes % bytesPerLine == bytesPerLine - 1)
+					res += '\n';
+			}
+
+			QClipboard *clipboard = QApplication::clipboard();
+			clipboard -> setText(QString::fromLatin1(res));
+		}
+	}
+
+/*****************************************************************************/
+/* Editing */
+/*****************************************************************************/
+	bool edited = false;
+	if(m_pedit && editKey(event, typing))
+	{
+		edited = true;
+		setVisible = true;
+	}
+
+ 	if(setVisible)
+	    ensureVisible();
+	updateChanges(prevCursor, prevBegin, prevEnd);
+
+	if(copyTooLarge)
+		emit copyLimitExceeded(selectionOffset(), selectionLength());
+	if(edited && m_pstructure)
+		m_pstructure->reset();
+	if(edited)
+		emit dataEdited();
+}
+
+bool QHexView::editKey(QKeyEvent *event, bool merge)
+{
+	std::size_t pos = m_cursorPos / 2;
+	std::size_t size = m_pedit->size();
+
+	if(event->matches(QKeySequence::Undo))
+		return revert(false);
+	if(event->matches(QKeySequence::Redo))
+		return revert(true);
+
+	if(event->key() == Qt::Key_Insert && event->modifiers() == Qt::NoModifier)
+	{
+		m_insertMode = !m_insertMode;
+		return false;
+	}
+
+	// Delete removes the selection or the byte at the cursor, Backspace the one before it
+	bool backspace = event->key() == Qt::Key_Backspace;
+	if(event->matches(QKeySequence::Delete) || backspace)
+	{
+		std::size_t length = 1;
+		if(m_selectEnd > m_selectBegin)
+		{
+			pos = selectionOffset();
+			length = selectionLength();
+		}
+		else if(backspace)
+		{
+			if(!pos)
+				return false;
+			pos--;
+		}
+
+		if(pos >= size)
+			return false;
+
+		m_pedit->remove(pos, length);
+		setCursorPos(pos * 2);
+		resetSelection(m_cursorPos);
+		dataResized(pos);
+		return true;
+	}
+
+	// Hex digits replace the nibble under the cursor; in insert mode a digit at
+	// the high nibble inserts a new byte
+	QString text = event->text();
+	int value = text.size() == 1 ? QString("0123456789abcdef").indexOf(text[0].toLower()) : -1;
+	if(value < 0 || (event->modifiers() & (Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier)))
+		return false;
+
+	bool high = m_cursorPos % 2 == 0;
+	if(high && m_insertMode)
+	{
+		m_pedit->insert(pos, QByteArray(1, (char)(value << 4)), merge);
+		dataResized(pos);
+	}
+	else
+	{
+		char byte = 0;
+		if(pos < size)
+			m_pedit->read(pos, 1, &byte);
+		byte = high ? (char)((value << 4) | (byte & 0x0F)) : (char)((byte & 0xF0) | value);
+		m_pedit->overwrite(pos, QByteArray(1, byte), merge);
+
+		if(pos < size)
+			updateNibbles(2 * pos, 2 * pos + 1);
+		else
+			dataResized(pos);
+	}
+
+	setCursorPos(m_cursorPos + 1);
+	resetSelection(m_cursorPos);
+	m_typingPos = m_cursorPos;
+	return true;
+}
+
+void QHexView::dataResized(std::size_t position)
+{
+	// Everything from position on has moved, and the scrollbar range may change
+	std::size_t prevLine = m_firstLine;
+	updateScrollBar();
+	if(prevLine != m_firstLine)
+		viewport()->update();
+	else
+		viewport()->update(linesRect(m_layout.line(position), std::numeric_limits<std::size_t>::max()));
+}
+
+bool QHexView::revert(bool redo)
+{
+	std::size_t position = 0;
+	if(!m_pedit || !(redo ? m_pedit->redo(&position) : m_pedit->undo(&position)))
+		return false;
+
+	setCursorPos(position * 2);
+	resetSelection(m_cursorPos);
+	updateScrollBar();
+	ensureVisible();
+	viewport()->update();
+	return true;
+}
+
+void QHexView::undo()
+{
+	if(!revert(false))
+		return;
+	if(m_pstructure)
+		m_pstructure->reset();
+	emit dataEdited();
+}
+
+void QHexView::redo()
+{
+	if(!revert(true))
+		return;
+	if(m_pstructure)
+		m_pstructure->reset();
+	emit dataEdited();
+}
+
+bool QHexView::isEditable() const
+{
+	return m_pedit != NULL;
+}
+
+void QHexView::setInsertMode(bool insert)
+{
+	m_insertMode = insert;
+}
+
+bool QHexView::insertMode() const
+{
+	return m_insertMode;
+}
+
+bool QHexView::isModified()
+{
+	return m_pedit && m_pedit->isModified();
+}
+
+bool QHexView::canSaveInPlace()
+{
+	return m_pedit && m_pedit->canSaveInPlace();
+}
+
+bool QHexView::saveInPlace(QIODevice *pdevice)
+{
+	return m_pedit && m_pedit->saveInPlace(pdevice);
+}
+
+bool QHexView::saveTo(QIODevice *pdevice)
+{
+	return m_pedit && m_pedit->saveTo(pdevice);
+}
+
+void QHexView::mouseMoveEvent(QMouseEvent * event)
+{
+	std::size_t actPos = cursorPos(event->pos());
+	if (actPos != std::numeric_limits<std::size_t>::max())
+	{
+		std::size_t prevCursor = m_cursorPos;
+		std::size_t prevBegin = m_selectBegin;
+		std::size_t prevEnd = m_selectEnd;
+
+		setCursorPos(actPos);
+		setSelection(actPos);
+		updateChanges(prevCursor, prevBegin, prevEnd);
+	}
+}
+
+void QHexView::mousePressEvent(QMouseEvent * event)
+{
+	std::size_t cPos = cursorPos(event->pos());
+
+	std::size_t prevCursor = m_cursorPos;
+	std::size_t prevBegin = m_selectBegin;
+	std::size_t prevEnd = m_selectEnd;
+
+	if((QApplication::keyboardModifiers() & Qt::ShiftModifier) && event -> button() == Qt::LeftButton)
+		setSelection(cPos);
+	else
+		resetSelection(cPos);
+
+	if (cPos != std::numeric_limits<std::size_t>::max())
+	{
+		setCursorPos(cPos);
+	}
+
+	updateChanges(prevCursor, prevBegin, prevEnd);
+}
+
+
+std::size_t QHexView::cursorPos(const QPoint &position)
+{
+	std::size_t pos = std::numeric_limits<std::size_t>::max();
+
+	std::size_t column;
+	bool low;
+	if (m_layout.hexColumnAt(position.x() + m_scrollX, column, low))
+	{
+		qint64 row = position.y() / (int)m_charHeight;
+		std::size_t line = (row < 0 && (std::size_t)-row > m_firstLine) ? 0 : m_firstLine + row;
+		pos = 2 * m_layout.offsetAt(line, column) + (low ? 1 : 0);
+	}
+	return pos;
+}
+
+
+void QHexView::resetSelection()
+{
+    m_selectBegin = m_selectInit;
+    m_selectEnd = m_selectInit;
+}
+
+void QHexView::resetSelection(std::size_t pos)
+{
+    if (pos == std::numeric_limits<std::size_t>::max())
+        pos = 0;
+
+    m_selectInit = pos;
+    m_selectBegin = pos;
+    m_selectEnd = pos;
+}
+
+void QHexView::setSelection(std::size_t pos)
+{
+    if (pos == std::numeric_limits<std::size_t>::max())
+        pos = 0;
+
+    if ((std::size_t)pos >= m_selectInit)
+    {
+        m_selectEnd = pos;
+        m_selectBegin = m_selectInit;
+    }
+    else
+    {
+        m_selectBegin = pos;
+        m_selectEnd = m_selectInit;
+    }
+}
+
+void QHexView::setSelected(std::size_t offset, std::size_t length)
+{
+	std::size_t prevBegin = m_selectBegin;
+	std::size_t prevEnd = m_selectEnd;
+
+	m_selectInit = m_selectBegin = offset * 2;
+	m_selectEnd = m_selectBegin + length * 2;
+	updateChanges(m_cursorPos, prevBegin, prevEnd);
+}
+
+void QHexView::setCursorPos(std::size_t position)
+{
+	if(position == std::numeric_limits<std::size_t>::max())
+		position = 0;
+
+	std::size_t maxPos = 0;
+	if(m_pdata)
+	{
+		maxPos = m_pdata->size() * 2;
+		if(m_layout.column(m_pdata->size()))
+			maxPos++;
+	}
+
+	if(position > maxPos)
+		position = maxPos;
+
+	m_cursorPos = position;
+}
+
+void QHexView::ensureVisible()
+{
+	std::size_t visible = visibleLines();
+
+	std::size_t firstLineIdx = m_firstLine;
+	std::size_t lastLineIdx = firstLineIdx + visible;
+
+	std::size_t cursorY = m_layout.line(m_cursorPos / 2);
+
+	if(cursorY < firstLineIdx)
+		setFirstLine(cursorY);
+	else if(cursorY >= lastLineIdx)
+		setFirstLine(cursorY + 1 > visible ? cursorY + 1 - visible : 0);
+
+	// Wide lines scroll sideways to the cursor
+	int cursorX = m_layout.hexX(m_layout.column(m_cursorPos / 2)) + (m_cursorPos % 2) * m_charWidth;
+	int dataLeft = m_layout.hexLeft() + m_scrollX;
+	int dataRight = viewport()->width() + m_scrollX - m_charWidth;
+	if(cursorX < dataLeft)
+		horizontalScrollBar()->setValue(horizontalScrollBar()->value() - (dataLeft - cursorX));
+	else if(cursorX > dataRight)
+		horizontalScrollBar()->setValue(horizontalScrollBar()->value() + (cursorX - dataRight));
+}
+
+
+
+std::size_t QHexView::DataStorage::read(std::size_t position, std::size_t length, char *dst)
+{
+	QByteArray data = getData(position, length);
+	memcpy(dst, data.constData(), data.size());
+	return data.size();
+}
+
+QHexView::DataView QHexView::DataStorage::view(std::size_t position, std::size_t length)
+{
+	return DataView(getData(position, length));
+}
+
+bool QHexView::DataStorage::isReady(std::size_t, std::size_t)
+{
+	return true;
+}
+
+bool QHexView::DataStorage::refresh()
+{
+	return false;
+}
+
+QString QHexView::DataStorage::fileName()
+{
+	return QString();
+}
+
+quint64 QHexView::DataStorage::address(std::size_t position)
+{
+	return position;
+}
+
+std::size_t QHexView::DataStorage::regionEnd(std::size_t)
+{
+	return size();
+}
+
+void QHexView::DataStorage::setListener(Listener *pListener)
+{
+	m_plistener.storeRelease(pListener);
+}
+
+void QHexView::DataStorage::setStats(QHexStats *pstats)
+{
+	m_pstats.storeRelease(pstats);
+}
+
+QHexStats *QHexView::DataStorage::stats()
+{
+	return m_pstats.loadAcquire();
+}
+
+void QHexView::DataStorage::notifyReady(std::size_t position, std::size_t length)
+{
+	Listener *plistener = m_plistener.loadAcquire();
+	if(plistener)
+		plistener->dataReady(position, length);
+}
+
+void QHexView::DataStorage::notifyChanged(std::size_t position, std::size_t length)
+{
+	Listener *plistener = m_plistener.loadAcquire();
+	if(plistener)
+		plistener->dataChanged(position, length);
+}
+
+
+QHexView::DataStorageArray::DataStorageArray(const QByteArray &arr)
+{
+	m_data = arr;
+}
+
+QByteArray QHexView::DataStorageArray::getData(std::size_t position, std::size_t length)
+{
+	QHexStats::Timer timer(stats(), "read.array");
+	return m_data.mid(position, length);
+}
+
+std::size_t QHexView::DataStorageArray::read(std::size_t position, std::size_t length, char *dst)
+{
+	QHexStats::Timer timer(stats(), "read.array");
+	if(position >= (std::size_t)m_data.size())
+		return 0;
+
+	length = std::min(length, m_data.size() - position);
+	memcpy(dst, m_data.constData() + position, length);
+	return length;
+}
+
+QHexView::DataView QHexView::DataStorageArray::view(std::size_t position, std::size_t length)
+{
+	if(position >= (std::size_t)m_data.size())
+		return DataView();
+
+	// m_data is implicitly shared, holding a copy of it keeps the bytes alive without copying them
+	length = std::min(length, m_data.size() - position);
+	return DataView(m_data, m_data.constData() + position, length);
+}
+
+
+std::size_t QHexView::DataStorageArray::size()
+{
+	return m_data.count();
+}
+
+
+#ifdef Q_OS_UNIX
+// Whether the name now stands for another file than the open one, as after log rotation
+static bool isReplaced(QFile &file)
+{
+	struct stat opened, named;
+	if(::fstat(file.handle(), &opened) != 0 || ::stat(QFile::encodeName(file.fileName()).constData(), &named) != 0)
+		return false;
+	return opened.st_dev != named.st_dev || opened.st_ino != named.st_ino;
+}
+
+// Points the descriptor of the file at what its name stands for now. The descriptor
+// itself stays the same, so readers on other threads never see it closed.
+static bool reopen(QFile &file)
+{
+	int fd = ::open(QFile::encodeName(file.fileName()).constData(), O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	bool res = ::dup2(fd, file.handle()) >= 0;
+	::close(fd);
+	file.seek(0);
+	return res;
+}
+#endif
+
+
+QHexView::DataStorageFile::DataStorageFile(const QString &fileName): m_file(fileName)
+{
+	m_file.open(QIODevice::ReadOnly);
+	if(!m_file.isOpen())
+		throw std::runtime_error(std::string("Failed to open file `") + fileName.toStdString() + "`");
+
+	// The size is only updated by refresh, so the view never sees it change behind its back
+	m_size = m_file.size();
+	m_modified = QFileInfo(m_file).lastModified();
+}
+
+QByteArray QHexView::DataStorageFile::getData(std::size_t position, std::size_t length)
+{
+	std::size_t fileSize = size();
+	if(position >= fileSize)
+		return QByteArray();
+
+	QByteArray data(std::min(length, fileSize - position), Qt::Uninitialized);
+	data.resize(read(position, data.size(), data.data()));
+	return data;
+}
+
+std::size_t QHexView::DataStorageFile::read(std::size_t position, std::size_t length, char *dst)
+{
+	QHexStats::Timer timer(stats(), "read.file");
+#ifdef Q_OS_UNIX
+	// pread leaves the file position alone, so readers on other threads do not wait for each other
+	int fd = m_file.handle();
+	std::size_t done = 0;
+	while(done < length)
+	{
+		ssize_t res = ::pread(fd, dst + done, length - done, position + done);
+		if(res < 0 && errno == EINTR)
+			continue;
+		if(res <= 0)
+			break;
+		done += res;
+	}
+	return done;
+#else
+	QMutexLocker lock(&m_mtx);
+	m_file.seek(position);
+	qint64 res = m_file.read(dst, length);
+	return res > 0 ? res : 0;
+#endif
+}
+
+QHexView::DataView QHexView::DataStorageFile::view(std::size_t position, std::size_t length)
+{
+	std::size_t fileSize = size();
+	if(position >= fileSize)
+		return DataView();
+
+	QByteArray data(std::min(length, fileSize - position), Qt::Uninitialized);
+	data.resize(read(position, data.size(), data.data()));
+	return DataView(data);
+}
+
+
+std::size_t QHexView::DataStorageFile::size()
+{
+	QMutexLocker lock(&m_mtx);
+	return m_size;
+}
+
+bool QHexView::DataStorageFile::refresh()
+{
+	QMutexLocker lock(&m_mtx);
+	bool replaced = false;
+#ifdef Q_OS_UNIX
+	replaced = isReplaced(m_file) && reopen(m_file);
+#endif
+	std::size_t size = m_file.size();
+	QDateTime modified = QFileInfo(m_file.fileName()).lastModified();
+	if(!replaced && size == m_size && modified == m_modified)
+		return false;
+
+	// Growth is taken for an append, anything else may have changed every byte
+	std::size_t prevSize = m_size;
+	m_size = size;
+	m_modified = modified;
+	lock.unlock();
+
+	if(size > prevSize && !replaced)
+		notifyChanged(prevSize, size - prevSize);
+	else
+		notifyChanged(0, 0);
+	return true;
+}
+
+QString QHexView::DataStorageFile::fileName()
+{
+	return m_file.fileName();
+}
+
+
+QHexView::DataStorageMapped::DataStorageMapped(const QString &fileName, std::size_t windowSize):
+m_file(fileName),
+m_size(0),
+m_pwhole(NULL),
+m_pwindow(NULL),
+m_windowPos(0),
+m_windowLength(0),
+m_windowSize(windowSize)
+{
+	m_file.open(QIODevice::ReadOnly);
+	if(!m_file.isOpen())
+		throw std::runtime_error(std::string("Failed to open file `") + fileName.toStdString() + "`");
+
+	m_size = m_file.size();
+	m_modified = QFileInfo(m_file).lastModified();
+	map();
+}
+
+QHexView::DataStorageMapped::~DataStorageMapped()
+{
+	unmap();
+}
+
+void QHexView::DataStorageMapped::map()
+{
+	// On 64-bit systems the whole file is mapped at once, the kernel pages it in on demand.
+	// Otherwise (or if the mapping fails) fall back to windows of m_windowSize bytes.
+	if(m_size && (sizeof(void *) >= 8 || m_size <= m_windowSize))
+		m_pwhole = m_file.map(0, m_size);
+}
+
+void QHexView::DataStorageMapped::unmap()
+{
+	if(m_pwhole)
+		m_file.unmap(m_pwhole);
+	if(m_pwindow)
+		m_file.unmap(m_pwindow);
+
+	m_pwhole = NULL;
+	m_pwindow = NULL;
+	m_windowPos = 0;
+	m_windowLength = 0;
+}
+
+const uchar *QHexView::DataStorageMapped::mapWindow(std::size_t position, std::size_t length)
+{
+	QHexStats *pstats = stats();
+	if(m_pwindow && position >= m_windowPos && position + length <= m_windowPos + m_windowLength)
+	{
+		if(pstats)
+			pstats->addLookup("mapped", true);
+		return m_pwindow + (position - m_windowPos);
+	}
+
+	if(length > m_windowSize / 2)
+		return NULL;
+	if(pstats)
+		pstats->addLookup("mapped", false);
+
+	if(m_pwindow)
+	{
+		m_file.unmap(m_pwindow);
+		m_pwindow = NULL;
+	}
+
+	// Windows start on half-window boundaries so that any range up to
+	// m_windowSize / 2 bytes always fits into a single window
+	m_windowPos = position - position % (m_windowSize / 2);
+	m_windowLength = std::min(m_windowSize, m_size - m_windowPos);
+	m_pwindow = m_file.map(m_windowPos, m_windowLength);
+
+	if(!m_pwindow)
+		return NULL;
+
+	return m_pwindow + (position - m_windowPos);
+}
+
+QByteArray QHexView::DataStorageMapped::getData(std::size_t position, std::size_t length)
+{
+	QHexStats::Timer timer(stats(), "read.mapped");
+	QReadLocker lock(&m_mapLock);
+	if(position >= m_size)
+		return QByteArray();
+
+	// A QByteArray holds at most INT_MAX bytes
+	length = std::min(std::min(length, m_size - position), (std::size_t)std::numeric_limits<int>::max());
+
+	if(m_pwhole)
+		return QByteArray::fromRawData((const char *)m_pwhole + position, length);
+
+	QMutexLocker windowLock(&m_windowMtx);
+	const uchar *pdata = mapWindow(position, length);
+	if(pdata)
+		return QByteArray((const char *)pdata, length);
+
+	m_file.seek(position);
+	return m_file.read(length);
+}
+
+std::size_t QHexView::DataStorageMapped::read(std::size_t position, std::size_t length, char *dst)
+{
+	QHexStats::Timer timer(stats(), "read.mapped");
+	QReadLocker lock(&m_mapLock);
+	if(position >= m_size)
+		return 0;
+
+	length = std::min(length, m_size - position);
+
+	if(m_pwhole)
+	{
+		memcpy(dst, m_pwhole + position, length);
+		return length;
+	}
+
+	QMutexLocker windowLock(&m_windowMtx);
+	const uchar *pdata = mapWindow(position, length);
+	if(pdata)
+	{
+		memcpy(dst, pdata, length);
+		return length;
+	}
+
+	m_file.seek(position);
+	qint64 res = m_file.read(dst, length);
+	return res > 0 ? res : 0;
+}
+
+QHexView::DataView QHexView::DataStorageMapped::view(std::size_t position, std::size_t length)
+{
+	{
+		QReadLocker lock(&m_mapLock);
+		if(position >= m_size)
+			return DataView();
+
+		length = std::min(length, m_size - position);
+
+		if(m_pwhole)
+			return DataView(QByteArray(), (const char *)m_pwhole + position, length);
+	}
+
+	// The window may be remapped by the next call, so the bytes have to be copied out
+	return DataView(getData(position, length));
+}
+
+
+std::size_t QHexView::DataStorageMapped::size()
+{
+	QReadLocker lock(&m_mapLock);
+	return m_size;
+}
+
+bool QHexView::DataStorageMapped::refresh()
+{
+	QWriteLocker lock(&m_mapLock);
+	bool replaced = false;
+#ifdef Q_OS_UNIX
+	// The mappings are of the old file, they go with it
+	if(isReplaced(m_file))
+	{
+		unmap();
+		replaced = reopen(m_file);
+		if(!replaced)
+			map();
+	}
+#endif
+	std::size_t size = m_file.size();
+	QDateTime modified = QFileInfo(m_file.fileName()).lastModified();
+	if(!replaced && size == m_size && modified == m_modified)
+		return false;
+
+	// Shared mappings show changes of the bytes they cover, only the length has to follow
+	std::size_t prevSize = m_size;
+	if(size != m_size || replaced)
+	{
+		unmap();
+		m_size = size;
+		map();
+	}
+	m_modified = modified;
+	lock.unlock();
+
+	if(size > prevSize && !replaced)
+		notifyChanged(prevSize, size - prevSize);
+	else
+		notifyChanged(0, 0);
+	return true;
+}
+
+QString QHexView::DataStorageMapped::fileName()
+{
+	return m_file.fileName();
+}
+
+
+QHexView::DataStorageCached::DataStorageCached(DataStorage *pSource, std::size_t budget, std::size_t pageSize, std::size_t readAhead):
+m_psource(pSource),
+m_pageSize(pageSize),
+m_readAhead(readAhead),
+m_lastPage(std::numeric_limits<std::size_t>::max()),
+m_generation(0),
+m_hits(0),
+m_misses(0)
+{
+	// Cost is counted in pages, so budgets over 2 GB do not overflow QCache's int cost
+	std::size_t maxPages = std::max<std::size_t>(budget / m_pageSize, 1);
+	m_pages.setMaxCost(std::min<std::size_t>(maxPages, std::numeric_limits<int>::max()));
+
+	// Read-ahead must not evict the page it was issued for
+	m_readAhead = std::min(m_readAhead, maxPages - 1);
+
+	m_psource->setListener(this);
+}
+
+QHexView::DataStorageCached::~DataStorageCached()
+{
+	delete m_psource;
+}
+
+QByteArray QHexView::DataStorageCached::page(std::size_t idx)
+{
+	QHexStats *pstats = stats();
+	QMutexLocker lock(&m_cacheMtx);
+	std::size_t prevPage = m_lastPage;
+	m_lastPage = idx;
+
+	if(QByteArray *pcached = m_pages.object(idx))
+	{
+		m_hits++;
+		if(pstats)
+			pstats->addLookup("cached", true);
+		return *pcached;
+	}
+
+	std::size_t sourceSize = m_psource->size();
+	if(idx * m_pageSize >= sourceSize)
+		return QByteArray();
+
+	m_misses++;
+	if(pstats)
+		pstats->addLookup("cached", false);
+
+	std::size_t first = idx;
+	std::size_t last = idx;
+	if(idx == prevPage + 1)
+		last = idx + m_readAhead;
+	else if(prevPage != std::numeric_limits<std::size_t>::max() && idx + 1 == prevPage)
+		first = idx > m_readAhead ? idx - m_readAhead : 0;
+
+	last = std::min(last, (sourceSize - 1) / m_pageSize);
+
+	// Do not read again pages which are still cached at the edges of the range
+	while(first < idx && m_pages.contains(first))
+		first++;
+	while(last > idx && m_pages.contains(last))
+		last--;
+
+	// The source is read unlocked so that other readers are served from the cache meanwhile
+	quint64 generation = m_generation;
+	lock.unlock();
+
+	QByteArray block((last - first + 1) * m_pageSize, Qt::Uninitialized);
+	block.resize(m_psource->read(first * m_pageSize, block.size(), block.data()));
+
+	lock.relock();
+	// Pages read before a change arrived may be stale, they are returned but not cached
+	bool keep = generation == m_generation;
+
+	QByteArray res;
+	for(std::size_t pageIdx = first; pageIdx <= last; pageIdx++)
+	{
+		std::size_t offset = (pageIdx - first) * m_pageSize;
+		if(offset >= (std::size_t)block.size())
+			break;
+
+		QByteArray data = block.mid(offset, m_pageSize);
+		if(pageIdx == idx)
+			res = data;
+		if(keep && !m_pages.contains(pageIdx))
+			m_pages.insert(pageIdx, new QByteArray(data), 1);
+	}
+
+	return res;
+}
+
+QByteArray QHexView::DataStorageCached::getData(std::size_t position, std::size_t length)
+{
+	DataView data = view(position, length);
+	return QByteArray(data.data(), data.size());
+}
+
+std::size_t QHexView::DataStorageCached::read(std::size_t position, std::size_t length, char *dst)
+{
+	std::size_t copied = 0;
+	while(copied < length)
+	{
+		std::size_t pos = position + copied;
+		QByteArray data = page(pos / m_pageSize);
+		std::size_t offset = pos % m_pageSize;
+		if(offset >= (std::size_t)data.size())
+			break;
+
+		std::size_t chunk = std::min(length - copied, data.size() - offset);
+		memcpy(dst + copied, data.constData() + offset, chunk);
+		copied += chunk;
+	}
+
+	return copied;
+}
+
+QHexView::DataView QHexView::DataStorageCached::view(std::size_t position, std::size_t length)
+{
+	std::size_t offset = position % m_pageSize;
+
+	// Ranges inside one page are returned straight from the cache
+	if(offset + length <= m_pageSize)
+	{
+		QByteArray data = page(position / m_pageSize);
+		if(offset >= (std::size_t)data.size())
+			return DataView();
+		return DataView(data, data.constData() + offset, std::min(length, data.size() - offset));
+	}
+
+	std::size_t sourceSize = size();
+	if(position >= sourceSize)
+		return DataView();
+
+	QByteArray data(std::min(length, sourceSize - position), Qt::Uninitialized);
+	data.resize(read(position, data.size(), data.data()));
+	return DataView(data);
+}
+
+
+std::size_t QHexView::DataStorageCached::size()
+{
+	return m_psource->size();
+}
+
+quint64 QHexView::DataStorageCached::hits() const
+{
+	QMutexLocker lock(&m_cacheMtx);
+	return m_hits;
+}
+
+quint64 QHexView::DataStorageCached::misses() const
+{
+	QMutexLocker lock(&m_cacheMtx);
+	return m_misses;
+}
+
+void QHexView::DataStorageCached::resetStats()
+{
+	QMutexLocker lock(&m_cacheMtx);
+	m_hits = 0;
+	m_misses = 0;
+}
+
+void QHexView::DataStorageCached::setStats(QHexStats *pstats)
+{
+	DataStorage::setStats(pstats);
+	m_psource->setStats(pstats);
+}
+
+bool QHexView::DataStorageCached::refresh()
+{
+	return m_psource->refresh();
+}
+
+QString QHexView::DataStorageCached::fileName()
+{
+	return m_psource->fileName();
+}
+
+quint64 QHexView::DataStorageCached::address(std::size_t position)
+{
+	return m_psource->address(position);
+}
+
+std::size_t QHexView::DataStorageCached::regionEnd(std::size_t position)
+{
+	return m_psource->regionEnd(position);
+}
+
+void QHexView::DataStorageCached::dataReady(std::size_t position, std::size_t length)
+{
+	notifyReady(position, length);
+}
+
+void QHexView::DataStorageCached::dataChanged(std::size_t position, std::size_t length)
+{
+	// Only the pages holding changed bytes are dropped, the partial last page among them on growth
+	std::size_t first = position / m_pageSize;
+	std::size_t last = length ? (position + length - 1) / m_pageSize : std::numeric_limits<std::size_t>::max();
+
+	QMutexLocker lock(&m_cacheMtx);
+	QList<std::size_t> cached = m_pages.keys();
+	for(int i = 0; i < cached.size(); i++)
+	{
+		if(cached[i] >= first && cached[i] <= last)
+			m_pages.remove(cached[i]);
+	}
+	m_lastPage = std::numeric_limits<std::size_t>::max();
+	m_generation++;
+	lock.unlock();
+
+	notifyChanged(position, length);
+}
+
+
+class QHexView::DataStorageAsync::FetchTask: public QRunnable
+{
+	public:
+		FetchTask(DataStorageAsync *pstorage, std::size_t idx): m_pstorage(pstorage), m_idx(idx) {}
+
+		virtual void run()
+		{
+			m_pstorage->fetchPage(m_idx);
+		}
+	private:
+		DataStorageAsync   *m_pstorage;
+		std::size_t         m_idx;
+};
+
+
+QHexView::DataStorageAsync::DataStorageAsync(DataStorage *pSource, std::size_t pageSize, int threads, std::size_t maxPages):
+m_psource(pSource),
+m_pageSize(pageSize),
+m_generation(0),
+m_prefreshThread(0)
+{
+	m_pages.setMaxCost(std::min<std::size_t>(maxPages, std::numeric_limits<int>::max()));
+	m_pool.setMaxThreadCount(threads);
+
+	// The size is queried once so that size() never waits for a slow source
+	m_size = m_psource->size();
+	m_psource->setListener(this);
+}
+
+QHexView::DataStorageAsync::~DataStorageAsync()
+{
+	m_pool.clear();
+	m_pool.waitForDone();
+	delete m_psource;
+}
+
+QByteArray QHexView::DataStorageAsync::loadPage(std::size_t idx)
+{
+	// Copied into a buffer of its own: getData of a mapped source points into a
+	// mapping which refresh may replace while the page is still cached
+	QByteArray data(m_pageSize, Qt::Uninitialized);
+	QReadLocker lock(&m_sourceLock);
+	data.resize(m_psource->read(idx * m_pageSize, m_pageSize, data.data()));
+	return data;
+}
+
+void QHexView::DataStorageAsync::fetchPage(std::size_t idx)
+{
+	int generation;
+	{
+		QMutexLocker lock(&m_pagesMtx);
+		generation = m_generation;
+	}
+
+	QByteArray data = loadPage(idx);
+
 	{
-		std::size_t pos = m_cursorPos - 1;
-		setSelection(pos);
-		setCursorPos(pos);
-		setVisible = true;
+		QMutexLocker lock(&m_pagesMtx);
+		if(generation == m_generation)
+			m_pages.insert(idx, new QByteArray(data), 1);
+		m_pending.remove(idx);
 	}
-	if (event->matches(QKeySequence::SelectEndOfLine))
+
+	notifyReady(idx * m_pageSize, data.size());
+}
+
+bool QHexView::DataStorageAsync::isReady(std::size_t position, std::size_t length)
+{
+	QHexStats *pstats = stats();
+	QMutexLocker lock(&m_pagesMtx);
+
+	if(!length || position >= m_size)
+		return true;
+
+	std::size_t lastPos = std::min(position + length, m_size) - 1;
+
+	bool ready = true;
+	for(std::size_t idx = position / m_pageSize; idx <= lastPos / m_pageSize; idx++)
 	{
-		std::size_t pos = m_cursorPos - (m_cursorPos % (2 * m_bytesPerLine)) + (2 * m_bytesPerLine);
-		setCursorPos(pos);
-		setSelection(pos);
-		setVisible = true;
+		bool cached = m_pages.contains(idx);
+		if(pstats)
+			pstats->addLookup("async", cached);
+		if(cached)
+			continue;
+
+		ready = false;
+		if(!m_pending.contains(idx))
+		{
+			m_pending.insert(idx);
+			m_pool.start(new FetchTask(this, idx));
+		}
 	}
-	if (event->matches(QKeySequence::SelectStartOfLine))
+
+	return ready;
+}
+
+QByteArray QHexView::DataStorageAsync::getData(std::size_t position, std::size_t length)
+{
+	std::size_t size = DataStorageAsync::size();
+	if(position >= size)
+		return QByteArray();
+
+	length = std::min(length, size - position);
+
+	QByteArray res;
+	res.reserve(length);
+
+	while((std::size_t)res.size() < length)
 	{
-		std::size_t pos = m_cursorPos - (m_cursorPos % (2 * m_bytesPerLine));
-		setCursorPos(pos);
-		setSelection(pos);
-		setVisible = true;
+		std::size_t pos = position + res.size();
+		std::size_t idx = pos / m_pageSize;
+
+		QByteArray data;
+		int generation;
+		{
+			QMutexLocker lock(&m_pagesMtx);
+			if(QByteArray *pcached = m_pages.object(idx))
+				data = *pcached;
+			generation = m_generation;
+		}
+
+		if(data.isNull())
+		{
+			data = loadPage(idx);
+
+			QMutexLocker lock(&m_pagesMtx);
+			if(generation == m_generation)
+				m_pages.insert(idx, new QByteArray(data), 1);
+		}
+
+		std::size_t offset = pos % m_pageSize;
+		if(offset >= (std::size_t)data.size())
+			break;
+
+		res.append(data.constData() + offset, std::min(length - res.size(), data.size() - offset));
 	}
-	if (event->matches(QKeySequence::SelectPreviousLine))
+
+	return res;
+}
+
+
+std::size_t QHexView::DataStorageAsync::size()
+{
+	QMutexLocker lock(&m_pagesMtx);
+	return m_size;
+}
+
+bool QHexView::DataStorageAsync::refresh()
+{
+	bool res;
+	QList<QPair<std::size_t, std::size_t> > changes;
 	{
-		std::size_t pos = m_cursorPos - (2 * m_bytesPerLine);
-		setCursorPos(pos);
-		setSelection(pos);
-		setVisible = true;
+		QWriteLocker lock(&m_sourceLock);
+		{
+			QMutexLocker pagesLock(&m_pagesMtx);
+			m_prefreshThread = QThread::currentThread();
+		}
+		res = m_psource->refresh();
+
+		QMutexLocker pagesLock(&m_pagesMtx);
+		m_prefreshThread = 0;
+		changes.swap(m_changes);
 	}
-	if (event->matches(QKeySequence::SelectNextLine))
+
+	// The listeners may read back, which waits for m_sourceLock in loadPage
+	for(int i = 0; i < changes.size(); i++)
+		notifyChanged(changes[i].first, changes[i].second);
+	return res;
+}
+
+QString QHexView::DataStorageAsync::fileName()
+{
+	QReadLocker lock(&m_sourceLock);
+	return m_psource->fileName();
+}
+
+// The layout of the source only changes in refresh, which runs on the caller's
+// thread as well, so these do not wait for pages being fetched
+quint64 QHexView::DataStorageAsync::address(std::size_t position)
+{
+	return m_psource->address(position);
+}
+
+std::size_t QHexView::DataStorageAsync::regionEnd(std::size_t position)
+{
+	return m_psource->regionEnd(position);
+}
+
+void QHexView::DataStorageAsync::setStats(QHexStats *pstats)
+{
+	DataStorage::setStats(pstats);
+	m_psource->setStats(pstats);
+}
+
+void QHexView::DataStorageAsync::dataReady(std::size_t position, std::size_t length)
+{
+	notifyReady(position, length);
+}
+
+void QHexView::DataStorageAsync::dataChanged(std::size_t position, std::size_t length)
+{
+	// Pages being loaded right now are dropped through the generation
+	std::size_t size = m_psource->size();
+
+	std::size_t first = position / m_pageSize;
+	std::size_t last = length ? (position + length - 1) / m_pageSize : std::numeric_limits<std::size_t>::max();
+	{
+		QMutexLocker lock(&m_pagesMtx);
+		m_size = size;
+		m_generation++;
+
+		QList<std::size_t> cached = m_pages.keys();
+		for(int i = 0; i < cached.size(); i++)
+		{
+			if(cached[i] >= first && cached[i] <= last)
+				m_pages.remove(cached[i]);
+		}
+
+		// Inside refresh m_sourceLock is held, the listeners hear about it once refresh let go
+		if(m_prefreshThread == QThread::currentThread())
+		{
+			m_changes.append(qMakePair(position, length));
+			return;
+		}
+	}
+
+	notifyChanged(position, length);
+}
+
+
+
+#ifdef Q_OS_LINUX
+QHexView::DataStorageProcess::DataStorageProcess(qint64 pid):
+m_pid(pid),
+m_fd(-1),
+m_size(0)
+{
+	QByteArray path = "/proc/" + QByteArray::number(pid) + "/mem";
+	m_fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+	if(m_fd < 0 || !loadMaps(m_regions))
+	{
+		if(m_fd >= 0)
+			::close(m_fd);
+		throw std::runtime_error(std::string("Failed to open memory of process ") + QByteArray::number(pid).constData());
+	}
+
+	m_size = m_regions.isEmpty() ? 0 : m_regions.last().position + m_regions.last().length;
+}
+
+QHexView::DataStorageProcess::~DataStorageProcess()
+{
+	::close(m_fd);
+}
+
+bool QHexView::DataStorageProcess::loadMaps(QVector<Region> &regions) const
+{
+	QFile maps("/proc/" + QString::number(m_pid) + "/maps");
+	if(!maps.open(QIODevice::ReadOnly))
+		return false;
+
+	// Lines read "start-end perms offset dev inode path", addresses in hex
+	regions.clear();
+	quint64 position = 0;
+	QByteArray line;
+	while(!(line = maps.readLine()).isEmpty())
+	{
+		QList<QByteArray> fields = line.simplified().split(' ');
+		if(fields.size() < 5 || !fields[1].startsWith('r'))
+			continue;
+
+		// The kernel refuses reads of these through /proc/<pid>/mem
+		if(fields.size() > 5 && (fields[5] == "[vvar]" || fields[5] == "[vsyscall]"))
+			continue;
+
+		QList<QByteArray> bounds = fields[0].split('-');
+		bool okStart = false;
+		bool okEnd = false;
+		quint64 start = bounds.value(0).toULongLong(&okStart, 16);
+		quint64 end = bounds.value(1).toULongLong(&okEnd, 16);
+		if(!okStart || !okEnd || end <= start)
+			continue;
+
+		Region region = {start, position, end - start};
+		regions.append(region);
+		position += region.length;
+	}
+
+	return true;
+}
+
+int QHexView::DataStorageProcess::regionAt(std::size_t position) const
+{
+	int low = 0;
+	int high = m_regions.size();
+	while(low < high)
+	{
+		int mid = (low + high) / 2;
+		if(m_regions[mid].position <= position)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low - 1;
+}
+
+std::size_t QHexView::DataStorageProcess::readPages(quint64 address, std::size_t length, char *dst)
+{
+	// A read fails as a whole at its first unreadable page, so the range is read page by page
+	const quint64 pageSize = sysconf(_SC_PAGESIZE);
+	std::size_t done = 0;
+	while(done < length)
+	{
+		std::size_t count = std::min<std::size_t>(length - done, pageSize - (address + done) % pageSize);
+		ssize_t res = pread(m_fd, dst + done, count, address + done);
+		if(res <= 0)
+		{
+			memset(dst + done, 0, count);
+			res = count;
+		}
+		done += res;
+	}
+	return done;
+}
+
+std::size_t QHexView::DataStorageProcess::read(std::size_t position, std::size_t length, char *dst)
+{
+	QHexStats::Timer timer(stats(), "read.process");
+	QReadLocker lock(&m_regionsLock);
+	if(position >= m_size)
+		return 0;
+	length = std::min(length, m_size - position);
+
+	// The parts of up to maxParts regions the range covers are read in a single call
+	const int maxParts = 64;
+	iovec local[maxParts];
+	iovec remote[maxParts];
+	std::size_t done = 0;
+	int idx = regionAt(position);
+	while(done < length)
+	{
+		int parts = 0;
+		std::size_t batch = 0;
+		for(; done + batch < length && parts < maxParts; idx++, parts++)
+		{
+			const Region &region = m_regions[idx];
+			std::size_t skip = position + done + batch - region.position;
+			std::size_t count = std::min<std::size_t>(region.length - skip, length - done - batch);
+
+			local[parts].iov_base = dst + done + batch;
+			local[parts].iov_len = count;
+			remote[parts].iov_base = (void *)(quintptr)(region.address + skip);
+			remote[parts].iov_len = count;
+			batch += count;
+		}
+
+		// Unreadable pages (or no process_vm_readv): the parts are read again one by one
+		if(process_vm_readv(m_pid, local, parts, remote, parts, 0) != (ssize_t)batch)
+		{
+			for(int i = 0; i < parts; i++)
+				readPages((quintptr)remote[i].iov_base, remote[i].iov_len, (char *)local[i].iov_base);
+		}
+		done += batch;
+	}
+
+	return done;
+}
+
+QByteArray QHexView::DataStorageProcess::getData(std::size_t position, std::size_t length)
+{
+	std::size_t memSize = size();
+	if(position >= memSize)
+		return QByteArray();
+
+	QByteArray res(std::min(length, memSize - position), Qt::Uninitialized);
+	res.resize(read(position, res.size(), res.data()));
+	return res;
+}
+
+std::size_t QHexView::DataStorageProcess::size()
+{
+	QReadLocker lock(&m_regionsLock);
+	return m_size;
+}
+
+bool QHexView::DataStorageProcess::refresh()
+{
+	QVector<Region> regions;
+	if(!loadMaps(regions))
+		return false;
+
+	QWriteLocker lock(&m_regionsLock);
+	bool same = regions.size() == m_regions.size();
+	for(int i = 0; same && i < regions.size(); i++)
+		same = regions[i].address == m_regions[i].address && regions[i].length == m_regions[i].length;
+
+	// Memory contents change all the time, only a changed layout is reported
+	if(same)
+		return false;
+
+	m_regions = regions;
+	m_size = m_regions.isEmpty() ? 0 : m_regions.last().position + m_regions.last().length;
+	lock.unlock();
+
+	notifyChanged(0, 0);
+	return true;
+}
+
+quint64 QHexView::DataStorageProcess::address(std::size_t position)
+{
+	QReadLocker lock(&m_regionsLock);
+	int idx = regionAt(position);
+	if(idx < 0)
+		return position;
+
+	return m_regions[idx].address + (position - m_regions[idx].position);
+}
+
+std::size_t QHexView::DataStorageProcess::regionEnd(std::size_t position)
+{
+	QReadLocker lock(&m_regionsLock);
+	int idx = regionAt(position);
+	if(idx < 0)
+		return m_size;
+
+	return m_regions[idx].position + m_regions[idx].length;
+}
+
+bool QHexView::DataStorageProcess::position(quint64 address, std::size_t &position) const
+{
+	QReadLocker lock(&m_regionsLock);
+	for(int i = 0; i < m_regions.size(); i++)
+	{
+		if(address >= m_regions[i].address && address - m_regions[i].address < m_regions[i].length)
+		{
+			position = m_regions[i].position + (address - m_regions[i].address);
+			return true;
+		}
+	}
+	return false;
+}
+#endif
+
+
+struct GzipIndexHeader
+{
+	quint64   size;
+	quint64   span;
+	quint64   points;
+};
+
+struct GzipIndexPoint
+{
+	quint64   out;
+	quint64   in;
+	qint32    bits;
+	quint32   header;
+	quint64   windowLength;
+};
+
+
+struct QHexView::DataStorageGzip::Reader
+{
+	Reader(): active(false), out(0), input(GZIP_CHUNK, Qt::Uninitialized) {}
+
+	void stop()
+	{
+		if(active)
+			inflateEnd(&stream);
+		active = false;
+	}
+
+	z_stream     stream;
+	bool         active;
+	quint64      out;       // decompressed offset of the next byte inflate produces
+	QByteArray   input;
+};
+
+class QHexView::DataStorageGzip::IndexTask: public QRunnable
+{
+	public:
+		IndexTask(DataStorageGzip *pstorage): m_pstorage(pstorage) {}
+
+		virtual void run()
+		{
+			m_pstorage->buildIndex();
+		}
+	private:
+		DataStorageGzip   *m_pstorage;
+};
+
+
+QHexView::DataStorageGzip::DataStorageGzip(const QString &fileName, std::size_t span):
+m_file(fileName),
+m_span(std::max(span, GZIP_WINDOW)),
+m_preader(new Reader),
+m_size(0),
+m_indexed(false)
+{
+	m_file.open(QIODevice::ReadOnly);
+	QByteArray magic = m_file.peek(2);
+	if(!m_file.isOpen() || magic != QByteArray("\x1f\x8b", 2))
+	{
+		delete m_preader;
+		throw std::runtime_error(std::string("Failed to open gzip file `") + fileName.toStdString() + "`");
+	}
+
+	m_pages.setMaxCost(GZIP_CACHED_PAGES);
+
+	if(!loadIndex())
+	{
+		m_pool.setMaxThreadCount(1);
+		m_pool.start(new IndexTask(this));
+	}
+}
+
+QHexView::DataStorageGzip::~DataStorageGzip()
+{
+	m_canceled.storeRelease(1);
+	m_pool.waitForDone();
+	m_preader->stop();
+	delete m_preader;
+}
+
+void QHexView::DataStorageGzip::buildIndex()
+{
+	QFile file(m_file.fileName());
+	if(!file.open(QIODevice::ReadOnly))
+		return;
+
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	if(inflateInit2(&stream, 47) != Z_OK)
+		return;
+
+	// Output goes round a window of the last 32 KB, which is what a point has to restore
+	QByteArray input(GZIP_CHUNK, Qt::Uninitialized);
+	QByteArray window(GZIP_WINDOW, Qt::Uninitialized);
+	quint64 totalIn = 0;
+	quint64 totalOut = 0;
+	quint64 lastPoint = 0;
+	quint64 notified = 0;
+	bool complete = false;
+
+	while(!m_canceled.loadAcquire())
+	{
+		if(!stream.avail_in)
+		{
+			qint64 count = file.read(input.data(), input.size());
+			if(count <= 0)
+				break;
+			stream.next_in = (Bytef *)input.data();
+			stream.avail_in = count;
+		}
+		if(!stream.avail_out)
+		{
+			stream.next_out = (Bytef *)window.data();
+			stream.avail_out = window.size();
+		}
+
+		// Z_BLOCK stops at every deflate block boundary, where points can be set
+		totalIn += stream.avail_in;
+		totalOut += stream.avail_out;
+		int ret = inflate(&stream, Z_BLOCK);
+		totalIn -= stream.avail_in;
+		totalOut -= stream.avail_out;
+
+		if(ret == Z_STREAM_END)
+		{
+			complete = !stream.avail_in && file.atEnd();
+			if(complete)
+				break;
+
+			// Another gzip member follows, readers start it afresh
+			inflateReset(&stream);
+			Point point = {totalOut, totalIn, 0, true, QByteArray()};
+			QMutexLocker lock(&m_indexMtx);
+			m_points.append(point);
+			continue;
+		}
+		if(ret != Z_OK && ret != Z_BUF_ERROR)
+			break;
+
+		if((stream.data_type & 128) && !(stream.data_type & 64) && totalOut - lastPoint > m_span)
+		{
+			QByteArray dictionary(GZIP_WINDOW, Qt::Uninitialized);
+			std::size_t left = stream.avail_out;
+			memcpy(dictionary.data(), window.constData() + GZIP_WINDOW - left, left);
+			memcpy(dictionary.data() + left, window.constData(), GZIP_WINDOW - left);
+
+			// Windows are kept deflated, most data compresses well enough to make it worth it
+			uLongf length = compressBound(GZIP_WINDOW);
+			QByteArray packed(length, Qt::Uninitialized);
+			if(compress2((Bytef *)packed.data(), &length, (const Bytef *)dictionary.constData(), GZIP_WINDOW, Z_BEST_SPEED) != Z_OK)
+				break;
+			packed.resize(length);
+
+			Point point = {totalOut, totalIn, stream.data_type & 7, false, packed};
+			QMutexLocker lock(&m_indexMtx);
+			m_points.append(point);
+			lastPoint = totalOut;
+		}
+
+		if(totalOut - notified >= GZIP_NOTIFY_STEP)
+		{
+			{
+				QMutexLocker lock(&m_indexMtx);
+				m_size = totalOut;
+			}
+			notifyChanged(notified, totalOut - notified);
+			notified = totalOut;
+		}
+	}
+
+	inflateEnd(&stream);
+
+	{
+		QMutexLocker lock(&m_indexMtx);
+		m_size = totalOut;
+		m_indexed = complete;
+	}
+	if(totalOut > notified)
+		notifyChanged(notified, totalOut - notified);
+
+	if(complete)
+		saveIndex();
+}
+
+bool QHexView::DataStorageGzip::loadIndex()
+{
+	QHexSidecar sidecar(QHexSidecar::defaultPath(m_file.fileName(), "gzip"));
+	if(!sidecar.open(m_file.fileName()))
+		return false;
+
+	QByteArray data = sidecar.section(QHexSidecar::GzipIndex);
+	if((std::size_t)data.size() < sizeof(GzipIndexHeader))
+		return false;
+
+	GzipIndexHeader header;
+	memcpy(&header, data.constData(), sizeof(header));
+
+	QVector<Point> points;
+	std::size_t offset = sizeof(header);
+	for(quint64 i = 0; i < header.points; i++)
+	{
+		GzipIndexPoint stored;
+		if(data.size() - offset < sizeof(stored))
+			return false;
+		memcpy(&stored, data.constData() + offset, sizeof(stored));
+		offset += sizeof(stored);
+
+		if(data.size() - offset < stored.windowLength)
+			return false;
+		Point point = {stored.out, stored.in, stored.bits, stored.header != 0, QByteArray(data.constData() + offset, stored.windowLength)};
+		points.append(point);
+		offset += stored.windowLength;
+	}
+
+	QMutexLocker lock(&m_indexMtx);
+	m_points = points;
+	m_size = header.size;
+	m_indexed = true;
+	return true;
+}
+
+void QHexView::DataStorageGzip::saveIndex()
+{
+	QByteArray data;
+	{
+		QMutexLocker lock(&m_indexMtx);
+
+		GzipIndexHeader header = {m_size, m_span, (quint64)m_points.size()};
+		data.append((const char *)&header, sizeof(header));
+		for(int i = 0; i < m_points.size(); i++)
+		{
+			const Point &point = m_points[i];
+			GzipIndexPoint stored = {point.out, point.in, point.bits, point.header, (quint64)point.window.size()};
+			data.append((const char *)&stored, sizeof(stored));
+			data.append(point.window);
+		}
+	}
+
+	QMap<quint32, QByteArray> sections;
+	sections.insert(QHexSidecar::GzipIndex, data);
+	QHexSidecar::write(QHexSidecar::defaultPath(m_file.fileName(), "gzip"), m_file.fileName(), sections);
+}
+
+QHexView::DataStorageGzip::Point QHexView::DataStorageGzip::pointBefore(std::size_t position)
+{
+	QMutexLocker lock(&m_indexMtx);
+
+	// Last point at or before position, the start of the file if there is none yet
+	int low = 0;
+	int high = m_points.size();
+	while(low < high)
 	{
-		std::size_t pos = m_cursorPos + (2 * m_bytesPerLine);
-		setCursorPos(pos);
-		setSelection(pos);
-		setVisible = true;
+		int mid = (low + high) / 2;
+		if(m_points[mid].out <= position)
+			low = mid + 1;
+		else
+			high = mid;
 	}
 
-	if (event->matches(QKeySequence::SelectNextPage))
+	if(!low)
 	{
-		std::size_t pos = m_cursorPos + (((viewport()->height() / m_charHeight) - 1) * 2 * m_bytesPerLine);
-		setCursorPos(pos);
-		setSelection(pos);
-		setVisible = true;
+		Point start = {0, 0, 0, true, QByteArray()};
+		return start;
 	}
-	if (event->matches(QKeySequence::SelectPreviousPage))
+	return m_points[low - 1];
+}
+
+bool QHexView::DataStorageGzip::startAt(const Point &point)
+{
+	Reader &reader = *m_preader;
+	reader.stop();
+
+	memset(&reader.stream, 0, sizeof(reader.stream));
+	if(inflateInit2(&reader.stream, point.header ? 47 : -15) != Z_OK)
+		return false;
+	reader.active = true;
+	reader.out = point.out;
+
+	if(!m_file.seek(point.in - (point.bits ? 1 : 0)))
 	{
-		std::size_t pos = m_cursorPos - (((viewport()->height() / m_charHeight) - 1) * 2 * m_bytesPerLine);
-		setCursorPos(pos);
-		setSelection(pos);
-		setVisible = true;
+		reader.stop();
+		return false;
 	}
-	if (event->matches(QKeySequence::SelectEndOfDocument))
+
+	// A point inside a deflate stream needs the bits left of its byte and the window before it
+	if(point.bits)
 	{
-		std::size_t pos = 0;
-		if(m_pdata)
-			pos = m_pdata->size() * 2;
-		setCursorPos(pos);
-		setSelection(pos);
-		setVisible = true;
+		char byte;
+		if(!m_file.getChar(&byte))
+		{
+			reader.stop();
+			return false;
+		}
+		inflatePrime(&reader.stream, point.bits, (uchar)byte >> (8 - point.bits));
 	}
-	if (event->matches(QKeySequence::SelectStartOfDocument))
+
+	if(!point.header)
 	{
-		std::size_t pos = 0;
-		setCursorPos(pos);
-		setSelection(pos);
-		setVisible = true;
+		QByteArray dictionary(GZIP_WINDOW, Qt::Uninitialized);
+		uLongf length = GZIP_WINDOW;
+		if(uncompress((Bytef *)dictionary.data(), &length, (const Bytef *)point.window.constData(), point.window.size()) != Z_OK ||
+			inflateSetDictionary(&reader.stream, (const Bytef *)dictionary.constData(), length) != Z_OK)
+		{
+			reader.stop();
+			return false;
+		}
 	}
 
-	if (event->matches(QKeySequence::Copy))
+	return true;
+}
+
+std::size_t QHexView::DataStorageGzip::inflateTo(char *dst, std::size_t length)
+{
+	Reader &reader = *m_preader;
+
+	// Without dst the output is skipped
+	QByteArray scratch;
+	if(!dst)
+		scratch.resize(std::min(length, GZIP_PAGE));
+
+	std::size_t done = 0;
+	while(done < length && reader.active)
 	{
-		if(m_pdata)
+		if(!reader.stream.avail_in)
 		{
-			QString res;
-			int idx = 0;
-			int copyOffset = 0;
+			qint64 count = m_file.read(reader.input.data(), reader.input.size());
+			if(count <= 0)
+				break;
+			reader.stream.next_in = (Bytef *)reader.input.data();
+			reader.stream.avail_in = count;
+		}
 
-			QByteArray data = m_pdata->getData(m_selectBegin / 2, (m_selectEnd - m_selectBegin) / 2 + 1);
-			if(m_selectBegin % 2)
-			{
-				res += QString::number((data.at((idx+1) / 2) & 0xF), 16);
-				res += " ";
-				idx++;
-				copyOffset = 1;
-			}
+		std::size_t count = dst ? length - done : std::min<std::size_t>(length - done, scratch.size());
+		count = std::min<std::size_t>(count, std::numeric_limits<uInt>::max());
+		reader.stream.next_out = (Bytef *)(dst ? dst + done : scratch.data());
+		reader.stream.avail_out = count;
 
-			int selectedSize = m_selectEnd - m_selectBegin;
-			for (;idx < selectedSize; idx+= 2)
-			{
-				if (data.size() > (copyOffset + idx) / 2)
-				{
-					QString val = QString::number((data.at((copyOffset + idx) / 2) & 0xF0) >> 4, 16);
-					if (idx + 1 < selectedSize)
-					{
-						val += QString::number((data.at((copyOffset + idx) / 2) & 0xF), 16);
-						val += " ";
-					}
-					res += val;
-
-					if ((idx / 2) % m_bytesPerLine == (m_bytesPerLine - 1))
-						res += "\n";
-				}
-			}
-			QClipboard *clipboard = QApplication::clipboard();
-			clipboard -> setText(res);
+		int ret = inflate(&reader.stream, Z_NO_FLUSH);
+		std::size_t produced = count - reader.stream.avail_out;
+		done += produced;
+		reader.out += produced;
+
+		if(ret == Z_STREAM_END)
+		{
+			// The next gzip member is started from the point the index set there
+			Point point = pointBefore(reader.out);
+			if(!point.header || point.out != reader.out || !startAt(point))
+				reader.stop();
 		}
+		else if(ret != Z_OK && ret != Z_BUF_ERROR)
+			reader.stop();
 	}
 
- 	if(setVisible)
-	    ensureVisible();
-	viewport() -> update();
+	return done;
 }
 
-void QHexView::mouseMoveEvent(QMouseEvent * event)
+QByteArray QHexView::DataStorageGzip::page(std::size_t idx)
 {
-	std::size_t actPos = cursorPos(event->pos());
-	if (actPos != std::numeric_limits<std::size_t>::max())
+	QHexStats *pstats = stats();
+	QMutexLocker lock(&m_readerMtx);
+	if(QByteArray *pcached = m_pages.object(idx))
 	{
-		QMutexLocker lock(&m_dataMtx);
-
-		setCursorPos(actPos);
-		setSelection(actPos);
+		if(pstats)
+			pstats->addLookup("gzip", true);
+		return *pcached;
 	}
+	if(pstats)
+		pstats->addLookup("gzip", false);
+
+	std::size_t position = idx * GZIP_PAGE;
+	std::size_t available = size();
+	if(position >= available)
+		return QByteArray();
+
+	// Reading on from the last position is cheaper than starting over, unless a point is closer
+	Point point = pointBefore(position);
+	Reader &reader = *m_preader;
+	if(!reader.active || position < reader.out || point.out > reader.out)
+	{
+		if(!startAt(point))
+			return QByteArray();
+	}
+
+	std::size_t skip = position - reader.out;
+	if(inflateTo(NULL, skip) != skip)
+		return QByteArray();
+
+	QByteArray data(std::min(GZIP_PAGE, available - position), Qt::Uninitialized);
+	data.resize(inflateTo(data.data(), data.size()));
 
-	viewport() -> update();
+	// The last page may still grow while the file is being indexed
+	if((std::size_t)data.size() == GZIP_PAGE || isIndexed())
+		m_pages.insert(idx, new QByteArray(data), 1);
+	return data;
 }
 
-void QHexView::mousePressEvent(QMouseEvent * event)
+std::size_t QHexView::DataStorageGzip::read(std::size_t position, std::size_t length, char *dst)
 {
-	std::size_t cPos = cursorPos(event->pos());
+	QHexStats::Timer timer(stats(), "read.gzip");
+	std::size_t copied = 0;
+	while(copied < length)
+	{
+		std::size_t pos = position + copied;
+		QByteArray data = page(pos / GZIP_PAGE);
+		std::size_t offset = pos % GZIP_PAGE;
+		if(offset >= (std::size_t)data.size())
+			break;
+
+		std::size_t chunk = std::min(length - copied, data.size() - offset);
+		memcpy(dst + copied, data.constData() + offset, chunk);
+		copied += chunk;
+	}
 
-	if((QApplication::keyboardModifiers() & Qt::ShiftModifier) && event -> button() == Qt::LeftButton)
-		setSelection(cPos);
-	else
-		resetSelection(cPos);
+	return copied;
+}
 
-	if (cPos != std::numeric_limits<std::size_t>::max())
-	{
-		QMutexLocker lock(&m_dataMtx);
+QByteArray QHexView::DataStorageGzip::getData(std::size_t position, std::size_t length)
+{
+	std::size_t available = size();
+	if(position >= available)
+		return QByteArray();
 
-		setCursorPos(cPos);
-	}
+	QByteArray res(std::min(length, available - position), Qt::Uninitialized);
+	res.resize(read(position, res.size(), res.data()));
+	return res;
+}
 
-	viewport() -> update();
+std::size_t QHexView::DataStorageGzip::size()
+{
+	QMutexLocker lock(&m_indexMtx);
+	return m_size;
 }
 
+QString QHexView::DataStorageGzip::fileName()
+{
+	return m_file.fileName();
+}
 
-std::size_t QHexView::cursorPos(const QPoint &position)
+bool QHexView::DataStorageGzip::isIndexed()
 {
-	std::size_t pos = std::numeric_limits<std::size_t>::max();
+	QMutexLocker lock(&m_indexMtx);
+	return m_indexed;
+}
+
 
-	if (((std::size_t)position.x() >= m_posHex) && ((std::size_t)position.x() < (m_posHex + (m_bytesPerLine * 3 - 1) * m_charWidth)))
+QHexView::DataStorageEditable::DataStorageEditable(DataStorage *pSource):
+m_psource(pSource),
+m_lock(QReadWriteLock::Recursive),
+m_sourceSize(pSource->size()),
+m_size(m_sourceSize),
+m_group(0),
+m_savedGroup(0)
+{
+	if(m_size)
 	{
-		int x = (position.x() - m_posHex) / m_charWidth;
-		if ((x % 3) == 0)
-			x = (x / 3) * 2;
-        else
-			x = ((x / 3) * 2) + 1;
+		Piece piece = {0, 0, m_size, false};
+		m_pieces.append(piece);
+	}
+	m_psource->setListener(this);
+}
+
+QHexView::DataStorageEditable::~DataStorageEditable()
+{
+	delete m_psource;
+}
 
-		int firstLineIdx = verticalScrollBar() -> value();
-		int y = (position.y() / m_charHeight) * 2 * m_bytesPerLine;
-		pos = x + y + firstLineIdx * m_bytesPerLine * 2;
+int QHexView::DataStorageEditable::pieceAt(std::size_t position) const
+{
+	// Last piece starting at or before position
+	int low = 0;
+	int high = m_pieces.size();
+	while(low < high)
+	{
+		int mid = (low + high) / 2;
+		if(m_pieces[mid].position <= position)
+			low = mid + 1;
+		else
+			high = mid;
 	}
-	return pos;
+	return low - 1;
 }
 
+std::size_t QHexView::DataStorageEditable::read(std::size_t position, std::size_t length, char *dst)
+{
+	QReadLocker lock(&m_lock);
+	if(position >= m_size)
+		return 0;
+	length = std::min(length, m_size - position);
+
+	std::size_t done = 0;
+	for(int i = pieceAt(position); done < length; i++)
+	{
+		const Piece &piece = m_pieces[i];
+		std::size_t skip = position + done - piece.position;
+		std::size_t count = std::min<std::size_t>(piece.length - skip, length - done);
+		if(piece.added)
+			memcpy(dst + done, m_added.constData() + piece.offset + skip, count);
+		else if(m_psource->read(piece.offset + skip, count, dst + done) != count)
+			return done;
+		done += count;
+	}
 
-void QHexView::resetSelection()
+	return done;
+}
+
+QByteArray QHexView::DataStorageEditable::getData(std::size_t position, std::size_t length)
 {
-    m_selectBegin = m_selectInit;
-    m_selectEnd = m_selectInit;
+	QReadLocker lock(&m_lock);
+	if(position >= m_size)
+		return QByteArray();
+
+	QByteArray res(std::min(length, m_size - position), Qt::Uninitialized);
+	res.resize(read(position, res.size(), res.data()));
+	return res;
 }
 
-void QHexView::resetSelection(std::size_t pos)
+QHexView::DataView QHexView::DataStorageEditable::view(std::size_t position, std::size_t length)
 {
-    if (pos == std::numeric_limits<std::size_t>::max())
-        pos = 0;
+	QReadLocker lock(&m_lock);
+	if(position >= m_size)
+		return DataView();
+	length = std::min(length, m_size - position);
+
+	// Ranges inside a single piece are served without copying
+	const Piece &piece = m_pieces[pieceAt(position)];
+	std::size_t skip = position - piece.position;
+	if(skip + length <= piece.length)
+	{
+		if(!piece.added)
+			return m_psource->view(piece.offset + skip, length);
+		return DataView(m_added, m_added.constData() + piece.offset + skip, length);
+	}
 
-    m_selectInit = pos;
-    m_selectBegin = pos;
-    m_selectEnd = pos;
+	return DataView(getData(position, length));
 }
 
-void QHexView::setSelection(std::size_t pos)
+bool QHexView::DataStorageEditable::isReady(std::size_t position, std::size_t length)
 {
-    if (pos == std::numeric_limits<std::size_t>::max())
-        pos = 0;
+	QReadLocker lock(&m_lock);
+	if(position >= m_size || !length)
+		return true;
+	length = std::min(length, m_size - position);
 
-    if ((std::size_t)pos >= m_selectInit)
-    {
-        m_selectEnd = pos;
-        m_selectBegin = m_selectInit;
-    }
-    else
-    {
-        m_selectBegin = pos;
-        m_selectEnd = m_selectInit;
-    }
+	for(int i = pieceAt(position); i < m_pieces.size() && m_pieces[i].position < position + length; i++)
+	{
+		const Piece &piece = m_pieces[i];
+		if(piece.added)
+			continue;
+
+		std::size_t begin = std::max<std::size_t>(position, piece.position);
+		std::size_t end = std::min<std::size_t>(position + length, piece.position + piece.length);
+		if(!m_psource->isReady(piece.offset + begin - piece.position, end - begin))
+			return false;
+	}
+
+	return true;
 }
 
-void QHexView::setSelected(std::size_t offset, std::size_t length)
+std::size_t QHexView::DataStorageEditable::size()
 {
-	m_selectInit = m_selectBegin = offset * 2;
-	m_selectEnd = m_selectBegin + length * 2;
-	viewport() -> update();
+	QReadLocker lock(&m_lock);
+	return m_size;
 }
 
-void QHexView::setCursorPos(std::size_t position)
+void QHexView::DataStorageEditable::dataReady(std::size_t, std::size_t)
 {
-	if(position == std::numeric_limits<std::size_t>::max())
-		position = 0;
+	// Called on worker threads while the pieces may change, so the source range is
+	// not mapped; the view repaints only the visible lines anyway
+	notifyReady(0, size());
+}
 
-	std::size_t maxPos = 0;
-	if(m_pdata)
+void QHexView::DataStorageEditable::dataChanged(std::size_t position, std::size_t length)
+{
+	QWriteLocker lock(&m_lock);
+	std::size_t sourceSize = m_psource->size();
+	std::size_t prevSize = m_size;
+
+	if(sourceSize < m_sourceSize && !isModified())
 	{
-		maxPos = m_pdata->size() * 2;
-		if(m_pdata->size() % m_bytesPerLine)
-			maxPos++;
+		// Nothing to keep, the pieces start over from the shrunk source
+		m_pieces.clear();
+		if(sourceSize)
+		{
+			Piece piece = {0, 0, sourceSize, false};
+			m_pieces.append(piece);
+		}
+		m_added.clear();
+		m_undo.clear();
+		m_redo.clear();
+		m_savedGroup = 0;
+		m_size = sourceSize;
 	}
+	else if(sourceSize > m_sourceSize)
+	{
+		// Appended bytes get a piece of their own, the recorded changes keep their piece indices
+		Piece piece = {m_size, m_sourceSize, sourceSize - m_sourceSize, false};
+		m_pieces.append(piece);
+		m_size += piece.length;
+	}
+	bool appended = sourceSize > m_sourceSize && position >= m_sourceSize;
+	m_sourceSize = sourceSize;
+	std::size_t newSize = m_size;
+	bool edited = !m_undo.isEmpty() || !m_redo.isEmpty();
+	lock.unlock();
+
+	// Positions only map one to one while nothing has been edited
+	if(appended)
+		notifyChanged(prevSize, newSize - prevSize);
+	else if(!edited)
+		notifyChanged(position, length);
+	else
+		notifyChanged(0, 0);
+}
 
-	if(position > maxPos)
-		position = maxPos;
+bool QHexView::DataStorageEditable::refresh()
+{
+	return m_psource->refresh();
+}
 
-	m_cursorPos = position;
+QString QHexView::DataStorageEditable::fileName()
+{
+	return m_psource->fileName();
 }
 
-void QHexView::ensureVisible()
+quint64 QHexView::DataStorageEditable::address(std::size_t position)
 {
-	QSize areaSize = viewport()->size();
+	QReadLocker lock(&m_lock);
+	if(m_pieces.isEmpty())
+		return m_psource->address(position);
 
-	int firstLineIdx = verticalScrollBar() -> value();
-	int lastLineIdx = firstLineIdx + areaSize.height() / m_charHeight;
+	for(int idx = pieceAt(std::min(position, m_size - 1)); idx >= 0; idx--)
+	{
+		const Piece &piece = m_pieces[idx];
+		if(piece.added)
+			continue;
+
+		// Past the piece, over added bytes, addresses go on from its last byte
+		std::size_t skip = position - piece.position;
+		if(skip < piece.length)
+			return m_psource->address(piece.offset + skip);
+		return m_psource->address(piece.offset + piece.length - 1) + (skip - piece.length + 1);
+	}
+	return position;
+}
 
-	int cursorY = m_cursorPos / (2 * m_bytesPerLine);
+std::size_t QHexView::DataStorageEditable::regionEnd(std::size_t position)
+{
+	QReadLocker lock(&m_lock);
+	// Regions of the source show through, edits do not split them
+	for(int i = std::max(pieceAt(position), 0); i < m_pieces.size(); i++)
+	{
+		const Piece &piece = m_pieces[i];
+		if(piece.added)
+			continue;
+
+		std::size_t skip = position > piece.position ? position - piece.position : 0;
+		std::size_t end = m_psource->regionEnd(piece.offset + skip) - piece.offset;
+		if(end < piece.length)
+			return piece.position + end;
+	}
+	return m_size;
+}
 
-	if(cursorY < firstLineIdx)
-		verticalScrollBar() -> setValue(cursorY);
-	else if(cursorY >= lastLineIdx)
-		verticalScrollBar() -> setValue(cursorY - areaSize.height() / m_charHeight + 1);
+void QHexView::DataStorageEditable::setStats(QHexStats *pstats)
+{
+	DataStorage::setStats(pstats);
+	m_psource->setStats(pstats);
 }
 
+void QHexView::DataStorageEditable::overwrite(std::size_t position, const QByteArray &data, bool merge)
+{
+	QWriteLocker lock(&m_lock);
+	position = std::min(position, m_size);
+	replace(position, std::min<std::size_t>(data.size(), m_size - position), data, merge);
+}
 
+void QHexView::DataStorageEditable::insert(std::size_t position, const QByteArray &data, bool merge)
+{
+	QWriteLocker lock(&m_lock);
+	replace(std::min(position, m_size), 0, data, merge);
+}
 
-QHexView::DataStorageArray::DataStorageArray(const QByteArray &arr)
+void QHexView::DataStorageEditable::remove(std::size_t position, std::size_t length, bool merge)
 {
-	m_data = arr;
+	QWriteLocker lock(&m_lock);
+	position = std::min(position, m_size);
+	replace(position, std::min(length, m_size - position), QByteArray(), merge);
 }
 
-QByteArray QHexView::DataStorageArray::getData(std::size_t position, std::size_t length)
+void QHexView::DataStorageEditable::replace(std::size_t position, std::size_t length, const QByteArray &data, bool merge)
 {
-	return m_data.mid(position, length);
+	QWriteLocker lock(&m_lock);
+	if(!length && data.isEmpty())
+		return;
+
+	bool merged = merge && m_redo.isEmpty() && !m_undo.isEmpty() && m_undo.last().group != m_savedGroup;
+
+	// The low nibble of a typed byte lands on the byte its high nibble just added,
+	// which no earlier change refers to, so it is rewritten in place
+	if(merged && length == (std::size_t)data.size())
+	{
+		const Piece &piece = m_pieces[pieceAt(position)];
+		std::size_t offset = piece.offset + (position - piece.position);
+		if(piece.added && position + length <= piece.position + piece.length && offset >= m_undo.last().addedSize)
+		{
+			memcpy(m_added.data() + offset, data.constData(), length);
+			return;
+		}
+	}
+	std::size_t addedSize = m_added.size();
+
+	// Pieces [first, last) overlap the replaced range or contain the insertion point
+	std::size_t end = position + length;
+	int first = position < m_size ? pieceAt(position) : m_pieces.size();
+	int last = m_pieces.size();
+	if(end < m_size)
+	{
+		last = pieceAt(end);
+		if(m_pieces[last].position < end)
+			last++;
+	}
+
+	QVector<Piece> pieces;
+	if(first < last && m_pieces[first].position < position)
+	{
+		Piece left = m_pieces[first];
+		left.length = position - left.position;
+		pieces.append(left);
+	}
+
+	Piece right = {0, 0, 0, false};
+	if(first < last)
+	{
+		const Piece &lastPiece = m_pieces[last - 1];
+		if(lastPiece.position + lastPiece.length > end)
+		{
+			right = lastPiece;
+			right.offset += end - lastPiece.position;
+			right.length = lastPiece.position + lastPiece.length - end;
+		}
+	}
+
+	if(!data.isEmpty())
+	{
+		Piece piece = {position, (quint64)m_added.size(), (quint64)data.size(), true};
+		m_added.append(data);
+
+		// Typing continues the piece of the previous keystroke, which simply grows
+		if(pieces.isEmpty() && first > 0)
+		{
+			const Piece &prev = m_pieces[first - 1];
+			if(prev.added && prev.offset + prev.length == piece.offset)
+			{
+				first--;
+				piece.offset = prev.offset;
+				piece.length += prev.length;
+			}
+		}
+		pieces.append(piece);
+	}
+
+	if(right.length)
+		pieces.append(right);
+
+	Change change;
+	change.group = merged ? m_undo.last().group : ++m_group;
+	change.position = position;
+	change.addedSize = addedSize;
+	change.first = first;
+	change.removed = m_pieces.mid(first, last - first);
+	change.inserted = pieces;
+
+	apply(first, last - first, pieces);
+	m_undo.append(change);
+	m_redo.clear();
 }
 
+void QHexView::DataStorageEditable::apply(int first, int count, const QVector<Piece> &pieces)
+{
+	QVector<Piece> res;
+	res.reserve(m_pieces.size() - count + pieces.size());
+	res += m_pieces.mid(0, first);
+	res += pieces;
+	res += m_pieces.mid(first + count);
+	m_pieces.swap(res);
+
+	// Pieces after the change move
+	quint64 position = first > 0 ? m_pieces[first - 1].position + m_pieces[first - 1].length : 0;
+	for(int i = first; i < m_pieces.size(); i++)
+	{
+		m_pieces[i].position = position;
+		position += m_pieces[i].length;
+	}
+	m_size = position;
+}
 
-std::size_t QHexView::DataStorageArray::size()
+bool QHexView::DataStorageEditable::canUndo() const
 {
-	return m_data.count();
+	return !m_undo.isEmpty();
 }
 
+bool QHexView::DataStorageEditable::canRedo() const
+{
+	return !m_redo.isEmpty();
+}
 
-QHexView::DataStorageFile::DataStorageFile(const QString &fileName): m_file(fileName)
+bool QHexView::DataStorageEditable::undo(std::size_t *pposition)
 {
-	m_file.open(QIODevice::ReadOnly);
-	if(!m_file.isOpen())
-		throw std::runtime_error(std::string("Failed to open file `") + fileName.toStdString() + "`");
+	QWriteLocker lock(&m_lock);
+	if(m_undo.isEmpty())
+		return false;
+
+	int group = m_undo.last().group;
+	while(!m_undo.isEmpty() && m_undo.last().group == group)
+	{
+		Change change = m_undo.takeLast();
+		apply(change.first, change.inserted.size(), change.removed);
+		if(pposition)
+			*pposition = change.position;
+		m_redo.append(change);
+	}
+
+	return true;
 }
 
-QByteArray QHexView::DataStorageFile::getData(std::size_t position, std::size_t length)
+bool QHexView::DataStorageEditable::redo(std::size_t *pposition)
 {
-	m_file.seek(position);
-	return m_file.read(length);
+	QWriteLocker lock(&m_lock);
+	if(m_redo.isEmpty())
+		return false;
+
+	int group = m_redo.last().group;
+	while(!m_redo.isEmpty() && m_redo.last().group == group)
+	{
+		Change change = m_redo.takeLast();
+		apply(change.first, change.removed.size(), change.inserted);
+		if(pposition)
+			*pposition = change.position;
+		m_undo.append(change);
+	}
+
+	return true;
 }
 
+bool QHexView::DataStorageEditable::isModified() const
+{
+	return (m_undo.isEmpty() ? 0 : m_undo.last().group) != m_savedGroup;
+}
 
-std::size_t QHexView::DataStorageFile::size()
+bool QHexView::DataStorageEditable::canSaveInPlace() const
+{
+	QReadLocker lock(&m_lock);
+	return onlyOverwritten();
+}
+
+bool QHexView::DataStorageEditable::onlyOverwritten() const
+{
+	if(m_size != m_psource->size())
+		return false;
+
+	for(int i = 0; i < m_pieces.size(); i++)
+	{
+		if(!m_pieces[i].added && m_pieces[i].offset != m_pieces[i].position)
+			return false;
+	}
+	return true;
+}
+
+bool QHexView::DataStorageEditable::saveInPlace(QIODevice *pdevice)
+{
+	QWriteLocker lock(&m_lock);
+	if(!onlyOverwritten() || !pdevice || !pdevice->isWritable())
+		return false;
+
+	// Source pieces are unchanged, only the typed bytes are written
+	for(int i = 0; i < m_pieces.size(); i++)
+	{
+		const Piece &piece = m_pieces[i];
+		if(!piece.added)
+			continue;
+
+		if(!pdevice->seek(piece.position) || pdevice->write(m_added.constData() + piece.offset, piece.length) != (qint64)piece.length)
+			return false;
+	}
+
+	// The source now holds the edits, older states can no longer be restored from it
+	m_pieces.clear();
+	if(m_size)
+	{
+		Piece piece = {0, 0, m_size, false};
+		m_pieces.append(piece);
+	}
+	m_added.clear();
+	m_undo.clear();
+	m_redo.clear();
+	m_savedGroup = 0;
+	lock.unlock();
+
+	// Caching sources still hold the bytes from before, they learn of the write from the file
+	if(QFileDevice *pfile = qobject_cast<QFileDevice *>(pdevice))
+		pfile->flush();
+	m_psource->refresh();
+	return true;
+}
+
+bool QHexView::DataStorageEditable::saveTo(QIODevice *pdevice)
 {
-	return m_file.size();
+	if(!pdevice || !pdevice->isWritable())
+		return false;
+
+	QReadLocker lock(&m_lock);
+	const std::size_t chunkSize = 1024 * 1024;
+	QByteArray buffer;
+	for(int i = 0; i < m_pieces.size(); i++)
+	{
+		const Piece &piece = m_pieces[i];
+		if(piece.added)
+		{
+			if(pdevice->write(m_added.constData() + piece.offset, piece.length) != (qint64)piece.length)
+				return false;
+			continue;
+		}
+
+		buffer.resize(std::min<std::size_t>(chunkSize, piece.length));
+		for(std::size_t done = 0; done < piece.length; )
+		{
+			std::size_t count = std::min<std::size_t>(chunkSize, piece.length - done);
+			if(m_psource->read(piece.offset + done, count, buffer.data()) != count)
+				return false;
+			if(pdevice->write(buffer.constData(), count) != (qint64)count)
+				return false;
+			done += count;
+		}
+	}
+
+	m_savedGroup = m_undo.isEmpty() ? 0 : m_undo.last().group;
+	return true;
 }
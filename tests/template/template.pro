@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = tst_template
+INCLUDEPATH += . ../../include
+
+QT += testlib
+CONFIG += console testcase
+
+HEADERS = ../../include/QHexTemplate.h
+
+SOURCES = tst_template.cpp             \
+          ../../src/QHexTemplate.cpp
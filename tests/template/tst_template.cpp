@@ -0,0 +1,56 @@
+#include <QtTest>
+#include <QByteArray>
+
+#include "QHexTemplate.h"
+
+// Checks of the descriptions QHexTemplate accepts and rejects
+class TestTemplate: public QObject
+{
+	Q_OBJECT
+	private slots:
+		void placedFields();
+
+		void emptyRecords_data();
+		void emptyRecords();
+};
+
+
+void TestTemplate::placedFields()
+{
+	// Fields placed with "at" take no room in their struct
+	QHexTemplate tmpl;
+	QVERIFY2(tmpl.load("{\"structs\": {"
+		"\"Ref\": [{\"name\": \"value\", \"type\": \"u8\", \"at\": 0}],"
+		"\"Table\": [{\"name\": \"n\", \"type\": \"u32\"}, {\"name\": \"ref\", \"type\": \"Ref\"}]"
+		"}, \"root\": \"Table\"}"), qPrintable(tmpl.errorString()));
+	QCOMPARE(tmpl.itemSize(tmpl.root()), Q_INT64_C(4));
+}
+
+void TestTemplate::emptyRecords_data()
+{
+	QTest::addColumn<QByteArray>("count");
+
+	QTest::newRow("constant") << QByteArray("4000000000");
+	QTest::newRow("field") << QByteArray("\"n\"");
+	QTest::newRow("to end") << QByteArray("\"*\"");
+}
+
+void TestTemplate::emptyRecords()
+{
+	QFETCH(QByteArray, count);
+
+	// An array of records taking no room would stack all its elements on one offset
+	QByteArray json = "{\"structs\": {"
+		"\"Ref\": [{\"name\": \"value\", \"type\": \"u8\", \"at\": 0}],"
+		"\"Table\": [{\"name\": \"n\", \"type\": \"u32\"}, {\"name\": \"refs\", \"type\": \"Ref\", \"count\": " + count + "}]"
+		"}, \"root\": \"Table\"}";
+
+	QHexTemplate tmpl;
+	QVERIFY(!tmpl.load(json));
+	QVERIFY(tmpl.errorString().contains("Table.refs"));
+}
+
+
+QTEST_APPLESS_MAIN(TestTemplate)
+
+#include "tst_template.moc"